@@ -0,0 +1,288 @@
+#include "AssetLoader.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+void AssetLoader::create() {
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+    graphicsFamily = queueFamilyIndices.graphicsFamily.value();
+    transferFamily = queueFamilyIndices.transferFamily.value_or(graphicsFamily);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = transferFamily;
+
+    if (vkCreateCommandPool(device, &poolInfo, hostAllocationCallbacks, &transferCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create transfer command pool!");
+    }
+
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+
+    if (vkCreateSemaphore(device, &semaphoreInfo, hostAllocationCallbacks, &timeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload timeline semaphore!");
+    }
+}
+
+void AssetLoader::destroy() {
+    jobSystem.wait(decodeJobs);
+
+    if (timelineNext > 0) {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &timeline;
+        waitInfo.pValues = &timelineNext;
+        vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+    }
+
+    for (std::unique_ptr<PendingUpload>& upload : uploads) {
+        release(*upload);
+        if (upload->state != UploadState::Taken) destroyGpuMesh(upload->mesh);
+    }
+    uploads.clear();
+
+    vkDestroySemaphore(device, timeline, hostAllocationCallbacks);
+    vkDestroyCommandPool(device, transferCommandPool, hostAllocationCallbacks);
+}
+
+MeshHandle AssetLoader::loadMesh(const std::string& path) {
+    MeshHandle handle = static_cast<MeshHandle>(uploads.size());
+    uploads.push_back(std::make_unique<PendingUpload>());
+
+    PendingUpload* upload = uploads.back().get();
+    upload->path = path;
+
+    jobSystem.run([upload] { decode(*upload); }, &decodeJobs);
+    return handle;
+}
+
+// Everything up to the copy commands, on a worker thread
+void AssetLoader::decode(PendingUpload& upload) {
+    PROFILE_SCOPE("AssetLoader::decode");
+
+    try {
+        upload.data = loadObjMesh(upload.path);
+        generateMeshLods(upload.data);
+        optimizeMesh(upload.data);
+
+        VertexQuantization quantization;
+        std::vector<GpuVertex> gpuVertices = packMeshVertices(upload.data, quantization);
+        upload.mesh = createGpuMesh(upload.data, quantization);
+
+        upload.vertexBytes = sizeof(GpuVertex) * gpuVertices.size();
+        upload.indexBytes = sizeof(uint32_t) * upload.data.indices.size();
+
+        createBuffer(upload.vertexBytes + upload.indexBytes,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            upload.stagingBuffer,
+            upload.stagingBufferMemory,
+            MemoryCategory::Staging);
+
+        void* mapped;
+        vkMapMemory(device, upload.stagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        memcpy(mapped, gpuVertices.data(), static_cast<size_t>(upload.vertexBytes));
+        memcpy(static_cast<char*>(mapped) + upload.vertexBytes, upload.data.indices.data(), static_cast<size_t>(upload.indexBytes));
+        vkUnmapMemory(device, upload.stagingBufferMemory);
+
+        // The geometry now lives in the staging buffer
+        upload.data.vertices = {};
+        upload.data.indices = {};
+
+        upload.state.store(UploadState::Staged, std::memory_order_release);
+    }
+    catch (const std::exception& e) {
+        upload.error = e.what();
+        upload.state.store(UploadState::Failed, std::memory_order_release);
+    }
+}
+
+void AssetLoader::submit(PendingUpload& upload) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = transferCommandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(device, &allocInfo, &upload.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(upload.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording upload command buffer!");
+    }
+
+    VkBufferCopy vertexCopy{ 0, 0, upload.vertexBytes };
+    VkBufferCopy indexCopy{ upload.vertexBytes, 0, upload.indexBytes };
+    vkCmdCopyBuffer(upload.commandBuffer, upload.stagingBuffer, upload.mesh.vertexBuffer, 1, &vertexCopy);
+    vkCmdCopyBuffer(upload.commandBuffer, upload.stagingBuffer, upload.mesh.indexBuffer, 1, &indexCopy);
+
+    // On a separate family this is the release half of the ownership transfer, completed by the acquire in update().
+    // On the graphics family it is an ordinary barrier and the buffers are ready once the semaphore signals.
+    VkBufferMemoryBarrier2 barriers[2]{};
+    for (VkBufferMemoryBarrier2& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+        barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        if (transferFamily != graphicsFamily) {
+            barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+            barrier.dstAccessMask = VK_ACCESS_2_NONE;
+            barrier.srcQueueFamilyIndex = transferFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+        }
+        else {
+            barrier.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT;
+            barrier.dstAccessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        }
+        barrier.size = VK_WHOLE_SIZE;
+    }
+    barriers[0].buffer = upload.mesh.vertexBuffer;
+    barriers[1].buffer = upload.mesh.indexBuffer;
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.bufferMemoryBarrierCount = 2;
+    depInfo.pBufferMemoryBarriers = barriers;
+
+    vkCmdPipelineBarrier2(upload.commandBuffer, &depInfo);
+
+    if (vkEndCommandBuffer(upload.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    upload.timelineValue = ++timelineNext;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &upload.timelineValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &upload.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timeline;
+
+    if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload command buffer!");
+    }
+    upload.state.store(UploadState::Submitted, std::memory_order_relaxed);
+}
+
+// Frees what was only needed to get the mesh onto the GPU
+void AssetLoader::release(PendingUpload& upload) {
+    if (upload.commandBuffer != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(device, transferCommandPool, 1, &upload.commandBuffer);
+        upload.commandBuffer = VK_NULL_HANDLE;
+    }
+    vkDestroyBuffer(device, upload.stagingBuffer, hostAllocationCallbacks);
+    memoryBudget.free(upload.stagingBufferMemory);
+    upload.stagingBuffer = VK_NULL_HANDLE;
+    upload.stagingBufferMemory = VK_NULL_HANDLE;
+}
+
+bool AssetLoader::update(VkCommandBuffer commandBuffer, MaterialTable& materialTable) {
+    waitValue = 0;
+
+    uint64_t completed = 0;
+    if (timelineNext > 0) {
+        vkGetSemaphoreCounterValue(device, timeline, &completed);
+    }
+
+    std::vector<VkBufferMemoryBarrier2> acquires;
+    bool anyReady = false;
+
+    for (std::unique_ptr<PendingUpload>& pointer : uploads) {
+        PendingUpload& upload = *pointer;
+
+        switch (upload.state.load(std::memory_order_acquire)) {
+        case UploadState::Staged:
+            submit(upload);
+            break;
+
+        case UploadState::Submitted:
+            if (upload.timelineValue > completed) break;
+
+            if (transferFamily != graphicsFamily) {
+                for (VkBuffer buffer : { upload.mesh.vertexBuffer, upload.mesh.indexBuffer }) {
+                    VkBufferMemoryBarrier2 barrier{};
+                    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+                    barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+                    barrier.srcAccessMask = VK_ACCESS_2_NONE;
+                    barrier.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT;
+                    barrier.dstAccessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT;
+                    barrier.srcQueueFamilyIndex = transferFamily;
+                    barrier.dstQueueFamilyIndex = graphicsFamily;
+                    barrier.buffer = buffer;
+                    barrier.size = VK_WHOLE_SIZE;
+                    acquires.push_back(barrier);
+                }
+            }
+            waitValue = std::max(waitValue, upload.timelineValue);
+
+            release(upload);
+            assignMeshMaterials(upload.mesh, upload.data, materialTable);
+            upload.data = {};
+
+            upload.state.store(UploadState::Ready, std::memory_order_relaxed);
+            anyReady = true;
+            std::cout << "Loaded " << upload.path << " in the background (" << upload.mesh.lods[0].indexCount / 3 << " triangles)\n";
+            break;
+
+        case UploadState::Failed:
+            std::cerr << "failed to load " << upload.path << ": " << upload.error << "\n";
+            release(upload);
+            destroyGpuMesh(upload.mesh);
+            upload.state.store(UploadState::Taken, std::memory_order_relaxed);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (!acquires.empty()) {
+        VkDependencyInfo depInfo{};
+        depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        depInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(acquires.size());
+        depInfo.pBufferMemoryBarriers = acquires.data();
+
+        vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+    }
+
+    return anyReady;
+}
+
+bool AssetLoader::loading(MeshHandle handle) const {
+    UploadState state = uploads[handle]->state.load(std::memory_order_acquire);
+    return state == UploadState::Decoding || state == UploadState::Staged || state == UploadState::Submitted;
+}
+
+bool AssetLoader::takeMesh(MeshHandle handle, GpuMesh& mesh) {
+    PendingUpload& upload = *uploads[handle];
+    if (upload.state.load(std::memory_order_relaxed) != UploadState::Ready) return false;
+
+    mesh = std::move(upload.mesh);
+    upload.mesh = {};
+    upload.state.store(UploadState::Taken, std::memory_order_relaxed);
+    return true;
+}
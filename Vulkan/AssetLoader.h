@@ -0,0 +1,82 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "Material.h"
+#include "Mesh.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Index of a mesh requested from an AssetLoader
+using MeshHandle = uint32_t;
+
+// Loads meshes in the background so that bringing in new assets never stalls a frame:
+//  1. A job reads and decodes the OBJ, builds its LODs, optimizes it, creates the device-local buffers
+//     and fills a host-visible staging buffer.
+//  2. update() records the copies for transferQueue, which is a transfer-only queue family when the device has
+//     one, and submits them, signalling the next value of a timeline semaphore. With a separate family the copies
+//     end in a queue family ownership release.
+//  3. A later update() that finds the semaphore past that value records the matching acquire into the frame's
+//     command buffer, adds the mesh's materials to the material table and hands the mesh out through takeMesh().
+//     That frame's graphics submission has to wait on the semaphore for frameWaitValue().
+class AssetLoader {
+public:
+    void create();
+
+    // Waits for outstanding jobs and uploads, then frees everything that was never taken
+    void destroy();
+
+    MeshHandle loadMesh(const std::string& path);
+
+    // Main thread, once per frame, with the frame's command buffer recording and outside rendering.
+    // Returns true if a mesh became ready.
+    bool update(VkCommandBuffer commandBuffer, MaterialTable& materialTable);
+
+    // Moves a ready mesh out of the loader; the caller destroys it. False while it is still loading or if it failed.
+    bool takeMesh(MeshHandle handle, GpuMesh& mesh);
+
+    // True until the mesh is ready to take or has failed
+    bool loading(MeshHandle handle) const;
+
+    VkSemaphore timelineSemaphore() const { return timeline; }
+
+    // Value the submission of the command buffer last passed to update() must wait for, 0 if none
+    uint64_t frameWaitValue() const { return waitValue; }
+
+private:
+    enum class UploadState { Decoding, Staged, Submitted, Ready, Taken, Failed };
+
+    struct PendingUpload {
+        std::string path;
+        std::atomic<UploadState> state{ UploadState::Decoding };
+        std::string error;
+
+        MeshData data;   // only the materials survive staging
+        GpuMesh mesh;
+
+        VkBuffer stagingBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+        VkDeviceSize vertexBytes = 0;
+        VkDeviceSize indexBytes = 0;
+
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint64_t timelineValue = 0;
+    };
+
+    static void decode(PendingUpload& upload);
+    void submit(PendingUpload& upload);
+    void release(PendingUpload& upload);
+
+    std::vector<std::unique_ptr<PendingUpload>> uploads;   // indexed by MeshHandle
+    JobCounter decodeJobs;
+
+    uint32_t graphicsFamily = 0;
+    uint32_t transferFamily = 0;
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+
+    VkSemaphore timeline = VK_NULL_HANDLE;
+    uint64_t timelineNext = 0;   // last value handed to a submission
+    uint64_t waitValue = 0;
+};
@@ -0,0 +1,98 @@
+#include "BatchManifest.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+std::vector<BatchJob> loadBatchManifest(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("failed to open batch manifest!");
+    }
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    for (uint32_t lineNumber = 1; std::getline(file, line); lineNumber++) {
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream tokens(line);
+        BatchJob job;
+        if (!(tokens >> job.meshPath)) continue;   // blank or comment
+
+        bool valid = bool(tokens >> job.outputPath);
+        std::string keyword;
+        while (valid && tokens >> keyword) {
+            if (keyword == "size") {
+                valid = bool(tokens >> job.width >> job.height) && job.width > 0 && job.height > 0;
+            }
+            else if (keyword == "eye") {
+                valid = bool(tokens >> job.eye.x >> job.eye.y >> job.eye.z);
+                job.autoCamera = false;
+            }
+            else if (keyword == "target") {
+                valid = bool(tokens >> job.target.x >> job.target.y >> job.target.z);
+            }
+            else if (keyword == "fov") {
+                valid = bool(tokens >> job.fovDegrees) && job.fovDegrees > 0.0f && job.fovDegrees < 180.0f;
+            }
+            else {
+                valid = false;
+            }
+        }
+
+        if (!valid) {
+            std::cerr << path << ":" << lineNumber << ": expected 'mesh output [size w h] [eye x y z] [target x y z] [fov degrees]'\n";
+            throw std::runtime_error("failed to parse batch manifest!");
+        }
+        jobs.push_back(job);
+    }
+
+    return jobs;
+}
+
+void writeBatchReport(const std::string& path, const std::vector<BatchJob>& jobs, const std::vector<BatchJobTiming>& timings,
+    double totalSeconds) {
+    // Without a report file the summary is still printed
+    std::ofstream file(path);
+    bool written = static_cast<bool>(file);
+    if (!written) {
+        std::cerr << "failed to write batch report " << path << "\n";
+    }
+    else {
+        file << "mesh,output,width,height,triangles,status,load_ms,queue_ms,gpu_ms,latency_ms\n";
+    }
+
+    std::vector<double> latencies;
+    uint32_t failed = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const BatchJob& job = jobs[i];
+        const BatchJobTiming& timing = timings[i];
+        if (timing.failed) failed++;
+        else latencies.push_back(timing.completed - timing.requested);
+
+        // Load: decode and upload; queue: waiting for a frame slot; GPU: render, copy and fence
+        char row[160];
+        snprintf(row, sizeof(row), ",%u,%u,%u,%s,%.3f,%.3f,%.3f,%.3f\n", job.width, job.height, timing.triangles,
+            timing.failed ? "failed" : "ok",
+            (timing.loaded - timing.requested) * 1000.0, (timing.submitted - timing.loaded) * 1000.0,
+            (timing.completed - timing.submitted) * 1000.0, (timing.completed - timing.requested) * 1000.0);
+        if (written) file << job.meshPath << "," << job.outputPath << row;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    char line[200];
+    snprintf(line, sizeof(line), "Batch: %zu images in %.3f s, %.1f images/s (%u failed)\n",
+        latencies.size(), totalSeconds, totalSeconds > 0.0 ? latencies.size() / totalSeconds : 0.0, failed);
+    std::cout << line;
+    if (!latencies.empty()) {
+        snprintf(line, sizeof(line), "  job latency ms: median %.3f, p95 %.3f, max %.3f",
+            latencies[latencies.size() / 2] * 1000.0, latencies[std::min(latencies.size() - 1, latencies.size() * 95 / 100)] * 1000.0,
+            latencies.back() * 1000.0);
+        std::cout << line;
+        if (written) std::cout << "; report written to " << path;
+        std::cout << "\n";
+    }
+}
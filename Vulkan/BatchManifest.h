@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Image size of jobs that give none
+#define BATCH_DEFAULT_SIZE 256
+
+// One image to render. Manifest lines are
+//   mesh.obj output.png [size width height] [eye x y z] [target x y z] [fov degrees]
+// with '#' starting a comment. Without an eye the camera frames the mesh's bounding sphere.
+struct BatchJob {
+    std::string meshPath;
+    std::string outputPath;   // ".ppm" for PPM, anything else PNG
+    uint32_t width = BATCH_DEFAULT_SIZE;
+    uint32_t height = BATCH_DEFAULT_SIZE;
+    bool autoCamera = true;
+    glm::vec3 eye = glm::vec3(0.0f);
+    glm::vec3 target = glm::vec3(0.0f);
+    float fovDegrees = 45.0f;
+};
+
+// Seconds since the batch started at which each stage of a job finished
+struct BatchJobTiming {
+    double requested = 0.0;   // load queued
+    double loaded = 0.0;      // mesh taken from the asset loader
+    double submitted = 0.0;   // render and readback copy submitted
+    double completed = 0.0;   // fence signalled and pixels handed to the encoder
+    uint32_t triangles = 0;
+    bool failed = false;
+};
+
+// Throws if the manifest cannot be read or a line does not parse
+std::vector<BatchJob> loadBatchManifest(const std::string& path);
+
+// Writes one CSV row per job to path and prints the throughput and latency summary
+void writeBatchReport(const std::string& path, const std::vector<BatchJob>& jobs, const std::vector<BatchJobTiming>& timings,
+    double totalSeconds);
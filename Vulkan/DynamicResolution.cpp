@@ -0,0 +1,71 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+void DynamicResolution::create(double budgetMilliseconds) {
+    budget = std::max(budgetMilliseconds, 0.0);
+    minLevel = static_cast<uint32_t>(std::lround(DYNAMIC_RESOLUTION_MIN_SCALE / DYNAMIC_RESOLUTION_STEP));
+    maxLevel = static_cast<uint32_t>(std::lround(DYNAMIC_RESOLUTION_MAX_SCALE / DYNAMIC_RESOLUTION_STEP));
+    level = maxLevel;
+    averageValid = false;
+    settleFrames = 0;
+
+    if (enabled()) {
+        std::cout << "Dynamic resolution created successfully! (" << budget << " ms GPU budget)\n";
+    }
+}
+
+void DynamicResolution::destroy() {
+    if (frames == 0) return;
+
+    char line[200];
+    snprintf(line, sizeof(line), "Dynamic resolution: average scale %.2f, lowest %.2f, %u changes over %llu frames\n",
+        scaleTotal / frames, lowestScale, changes, static_cast<unsigned long long>(frames));
+    std::cout << line;
+}
+
+void DynamicResolution::update(double gpuMilliseconds) {
+    if (!enabled() || gpuMilliseconds <= 0.0) return;
+
+    frames++;
+    scaleTotal += scale();
+    lowestScale = std::min(lowestScale, scale());
+
+    if (settleFrames > 0) {
+        settleFrames--;
+        return;
+    }
+
+    averageMilliseconds = averageValid ? averageMilliseconds + (gpuMilliseconds - averageMilliseconds) * DYNAMIC_RESOLUTION_SMOOTHING
+        : gpuMilliseconds;
+    averageValid = true;
+
+    uint32_t newLevel = level;
+    if (averageMilliseconds > budget * DYNAMIC_RESOLUTION_HIGH && level > minLevel) {
+        // GPU time goes roughly with the pixel count, the square of the scale: aim for the middle of the band
+        double fit = scale() * std::sqrt(budget * 0.5 * (DYNAMIC_RESOLUTION_HIGH + DYNAMIC_RESOLUTION_LOW) / averageMilliseconds);
+        uint32_t fitLevel = static_cast<uint32_t>(fit / DYNAMIC_RESOLUTION_STEP);
+        newLevel = std::clamp(fitLevel, minLevel, level - 1);
+    }
+    else if (averageMilliseconds < budget * DYNAMIC_RESOLUTION_LOW && level < maxLevel) {
+        newLevel = level + 1;
+    }
+
+    if (newLevel != level) {
+        level = newLevel;
+        changes++;
+        averageValid = false;
+        settleFrames = DYNAMIC_RESOLUTION_SETTLE_FRAMES;
+    }
+}
+
+VkExtent2D DynamicResolution::renderExtent(VkExtent2D maxExtent) const {
+    float factor = scale() / DYNAMIC_RESOLUTION_MAX_SCALE;
+    return {
+        std::max(1u, static_cast<uint32_t>(maxExtent.width * factor + 0.5f)),
+        std::max(1u, static_cast<uint32_t>(maxExtent.height * factor + 0.5f))
+    };
+}
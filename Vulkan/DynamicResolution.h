@@ -0,0 +1,58 @@
+#pragma once
+
+#include "VulkanCore.h"
+
+#include <cstdint>
+
+// Render scale bounds per axis, as a fraction of the swapchain extent, and the step the scale moves in
+#define DYNAMIC_RESOLUTION_MIN_SCALE 0.5f
+#define DYNAMIC_RESOLUTION_MAX_SCALE 1.0f
+#define DYNAMIC_RESOLUTION_STEP 0.05f
+
+// Fractions of the budget bounding the band in which the scale holds: above the high one it drops, below the low one it rises
+#define DYNAMIC_RESOLUTION_HIGH 0.95
+#define DYNAMIC_RESOLUTION_LOW 0.75
+
+// Weight of each new GPU time in the running average
+#define DYNAMIC_RESOLUTION_SMOOTHING 0.1
+
+// Frames ignored after a change, whose GPU times may still come from frames rendered at the old scale
+#define DYNAMIC_RESOLUTION_SETTLE_FRAMES 8
+
+// Picks the scale the scene renders at from the measured GPU time of recent frames against a budget. The
+// scale drops as soon as the average leaves the top of the band, straight to where the time should fit, but
+// rises one step at a time from below it, and holds after each change until new timings come in, so it
+// settles instead of oscillating around the budget.
+class DynamicResolution {
+public:
+    // budgetMilliseconds of GPU time per frame; 0 disables scaling and keeps the scale at the maximum
+    void create(double budgetMilliseconds);
+
+    // Prints the scale the frames were rendered at
+    void destroy();
+
+    // Once per frame, with the GPU time of the latest frame whose timings have come back; 0 is ignored
+    void update(double gpuMilliseconds);
+
+    bool enabled() const { return budget > 0.0; }
+    float scale() const { return level * DYNAMIC_RESOLUTION_STEP; }
+
+    // The scaled extent, at least 1x1, for a full-resolution extent of maxExtent
+    VkExtent2D renderExtent(VkExtent2D maxExtent) const;
+
+private:
+    double budget = 0.0;
+    uint32_t level = 0;   // scale in steps
+    uint32_t minLevel = 0;
+    uint32_t maxLevel = 0;
+
+    double averageMilliseconds = 0.0;
+    bool averageValid = false;
+    uint32_t settleFrames = 0;
+
+    // Running totals for the report
+    uint64_t frames = 0;
+    double scaleTotal = 0.0;
+    float lowestScale = DYNAMIC_RESOLUTION_MAX_SCALE;
+    uint32_t changes = 0;
+};
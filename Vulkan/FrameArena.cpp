@@ -0,0 +1,44 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// Partitions start on their own cache lines so two frames never share one
+#define FRAME_ARENA_ALIGNMENT 64
+
+FrameArena::FrameArena(size_t size, uint32_t frames) {
+    partitionSize = (size + FRAME_ARENA_ALIGNMENT - 1) & ~size_t(FRAME_ARENA_ALIGNMENT - 1);
+    frameCount = frames;
+
+    memory = static_cast<char*>(::operator new(partitionSize * frameCount, std::align_val_t(FRAME_ARENA_ALIGNMENT)));
+
+    beginFrame(0);
+}
+
+FrameArena::~FrameArena() {
+    ::operator delete(memory, std::align_val_t(FRAME_ARENA_ALIGNMENT));
+}
+
+void FrameArena::beginFrame(uint32_t frame) {
+    // Fold the finished frame into the statistics before rewinding
+    peakUsage = std::max(peakUsage, used());
+    allocatedBytes += frameAllocatedBytes.exchange(0, std::memory_order_relaxed);
+
+    partitionBegin = (frame % frameCount) * partitionSize;
+    head.store(partitionBegin, std::memory_order_relaxed);
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    size_t offset = head.load(std::memory_order_relaxed);
+    size_t aligned;
+
+    do {
+        aligned = (offset + alignment - 1) & ~(alignment - 1);
+        if (aligned + size > partitionBegin + partitionSize) {
+            throw std::runtime_error("frame arena partition is full!");
+        }
+    } while (!head.compare_exchange_weak(offset, aligned + size, std::memory_order_relaxed));
+
+    frameAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    return memory + aligned;
+}
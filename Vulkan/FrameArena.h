@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// Scratch memory for data that only lives for one frame: draw lists, cull results, sort keys, barriers.
+// The arena is split into one partition per frame in flight. Allocation is a lock-free pointer bump inside
+// the current frame's partition and nothing is freed individually; beginFrame() rewinds a partition once that
+// frame's fence has signalled. In steady state a frame therefore never reaches malloc, from any thread.
+class FrameArena {
+public:
+    FrameArena(size_t partitionSize, uint32_t frameCount);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Rewinds the partition of frame. Must only be called once the fence of that frame's last submission
+    // has been waited on, and while no other thread is allocating.
+    void beginFrame(uint32_t frame);
+
+    // Safe to call from several threads at once. Throws if the partition is full.
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    size_t used() const { return head.load(std::memory_order_relaxed) - partitionBegin; }
+    size_t capacity() const { return partitionSize; }
+
+    // Most bytes any single frame has used, for sizing the partitions
+    size_t highWaterMark() const { return peakUsage; }
+
+    // Bytes requested through allocate() since the start of the run, including what was freed by rewinding
+    uint64_t totalAllocated() const { return allocatedBytes; }
+
+private:
+    char* memory = nullptr;
+    size_t partitionSize = 0;
+    uint32_t frameCount = 0;
+
+    size_t partitionBegin = 0;
+    std::atomic<size_t> head{ 0 };   // absolute offset of the next allocation
+
+    size_t peakUsage = 0;
+    uint64_t allocatedBytes = 0;
+    std::atomic<uint64_t> frameAllocatedBytes{ 0 };
+};
+
+// STL allocator over a FrameArena. deallocate() is a no-op, so containers should reserve() up front:
+// every reallocation leaves the old block behind until the frame is rewound.
+template <typename T>
+class FrameAllocator {
+public:
+    using value_type = T;
+
+    explicit FrameAllocator(FrameArena& arena) : arena(&arena) {}
+
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return arena->allocateArray<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const FrameAllocator<U>& other) const { return arena == other.arena; }
+
+private:
+    template <typename U>
+    friend class FrameAllocator;
+
+    FrameArena* arena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
@@ -0,0 +1,210 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+// Counters in the order the query returns them, which follows the bit order
+static const VkQueryPipelineStatisticFlags statisticFlags =
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+void GpuProfiler::create(uint32_t frameCount, bool pipelineStatistics) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    uint32_t validBits = queueFamilies[findQueueFamilies(physicalDevice).graphicsFamily.value()].timestampValidBits;
+    timestamps = validBits > 0;
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    timestampPeriod = properties.limits.timestampPeriod;
+    statistics = pipelineStatistics;
+
+    // Null unless the instance was created with VK_EXT_debug_utils
+    cmdBeginLabel = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT");
+    cmdEndLabel = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT");
+
+    frames.resize(frameCount);
+    for (FrameQueries& queries : frames) {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+
+        if (timestamps) {
+            poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            poolInfo.queryCount = GPU_PROFILER_MAX_PASSES * 2;
+            if (vkCreateQueryPool(device, &poolInfo, hostAllocationCallbacks, &queries.timestamps) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create timestamp query pool!");
+            }
+        }
+
+        if (statistics) {
+            poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            poolInfo.queryCount = GPU_PROFILER_MAX_PASSES;
+            poolInfo.pipelineStatistics = statisticFlags;
+            if (vkCreateQueryPool(device, &poolInfo, hostAllocationCallbacks, &queries.statistics) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline statistics query pool!");
+            }
+        }
+    }
+    openPasses.reserve(GPU_PROFILER_MAX_PASSES);
+    resolved.reserve(GPU_PROFILER_MAX_PASSES);
+
+    std::cout << "GPU profiler created (timestamps " << (timestamps ? "on" : "unsupported")
+        << ", pipeline statistics " << (statistics ? "on" : "off")
+        << ", labels " << (cmdBeginLabel ? "on" : "off") << ")\n";
+}
+
+void GpuProfiler::destroy() {
+    if (totalFrames > 0) {
+        std::cout << "GPU pass averages over the last " << totalFrames << " resolved frames:\n";
+        for (const GpuPassTiming& total : totals) {
+            std::cout << "  " << total.name << ": " << total.milliseconds / totalFrames << " ms";
+            if (statistics) {
+                std::cout << ", " << total.vertexInvocations / totalFrames << " vertex / "
+                    << total.fragmentInvocations / totalFrames << " fragment invocations, "
+                    << total.clippingPrimitives / totalFrames << " of "
+                    << total.clippingInvocations / totalFrames << " primitives past clipping";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    for (FrameQueries& queries : frames) {
+        vkDestroyQueryPool(device, queries.timestamps, hostAllocationCallbacks);
+        vkDestroyQueryPool(device, queries.statistics, hostAllocationCallbacks);
+    }
+    frames.clear();
+    current = nullptr;
+    totals.clear();
+    totalFrames = 0;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frame) {
+    current = &frames[frame];
+    if (current->recorded) {
+        resolve(*current);
+    }
+
+    if (timestamps) vkCmdResetQueryPool(commandBuffer, current->timestamps, 0, GPU_PROFILER_MAX_PASSES * 2);
+    if (statistics) vkCmdResetQueryPool(commandBuffer, current->statistics, 0, GPU_PROFILER_MAX_PASSES);
+
+    current->passCount = 0;
+    current->recorded = true;
+    openPasses.clear();
+    statisticsOpen = false;
+}
+
+void GpuProfiler::beginPass(VkCommandBuffer commandBuffer, const char* name) {
+    if (cmdBeginLabel) {
+        VkDebugUtilsLabelEXT label{};
+        label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+        label.pLabelName = name;
+        cmdBeginLabel(commandBuffer, &label);
+    }
+
+    if (current->passCount == GPU_PROFILER_MAX_PASSES) {
+        openPasses.push_back(UINT32_MAX);
+        return;
+    }
+
+    uint32_t pass = current->passCount++;
+    current->names[pass] = name;
+    openPasses.push_back(pass);
+
+    if (timestamps) {
+        vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, current->timestamps, pass * 2);
+    }
+
+    // Only one statistics query can be active at a time, so nested passes go without
+    current->hasStatistics[pass] = statistics && !statisticsOpen;
+    if (current->hasStatistics[pass]) {
+        vkCmdBeginQuery(commandBuffer, current->statistics, pass, 0);
+        statisticsOpen = true;
+    }
+}
+
+void GpuProfiler::endPass(VkCommandBuffer commandBuffer) {
+    uint32_t pass = openPasses.back();
+    openPasses.pop_back();
+
+    if (pass != UINT32_MAX) {
+        if (current->hasStatistics[pass]) {
+            vkCmdEndQuery(commandBuffer, current->statistics, pass);
+            statisticsOpen = false;
+        }
+        if (timestamps) {
+            vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, current->timestamps, pass * 2 + 1);
+        }
+    }
+
+    if (cmdEndLabel) cmdEndLabel(commandBuffer);
+}
+
+// The frame's fence has signalled, so its queries are available; no wait flag, nothing blocks
+void GpuProfiler::resolve(FrameQueries& queries) {
+    resolved.clear();
+    resolvedFrameMilliseconds = 0.0;
+    if (queries.passCount == 0) return;
+
+    uint64_t ticks[GPU_PROFILER_MAX_PASSES * 2] = {};
+    uint64_t counters[GPU_PROFILER_MAX_PASSES][4] = {};
+
+    if (timestamps && vkGetQueryPoolResults(device, queries.timestamps, 0, queries.passCount * 2,
+        sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+    // One at a time: nested passes never began theirs, so those queries are unavailable
+    for (uint32_t pass = 0; pass < queries.passCount; pass++) {
+        if (queries.hasStatistics[pass] && vkGetQueryPoolResults(device, queries.statistics, pass, 1,
+            sizeof(counters[pass]), counters[pass], sizeof(counters[pass]), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            memset(counters[pass], 0, sizeof(counters[pass]));
+        }
+    }
+
+    uint64_t frameBegin = UINT64_MAX;
+    uint64_t frameEnd = 0;
+    for (uint32_t pass = 0; pass < queries.passCount; pass++) {
+        uint64_t begin = ticks[pass * 2] & timestampMask;
+        uint64_t end = ticks[pass * 2 + 1] & timestampMask;
+        frameBegin = std::min(frameBegin, begin);
+        frameEnd = std::max(frameEnd, end);
+
+        GpuPassTiming timing{};
+        timing.name = queries.names[pass];
+        timing.milliseconds = end > begin ? (end - begin) * timestampPeriod / 1e6 : 0.0;
+        if (queries.hasStatistics[pass]) {
+            timing.vertexInvocations = counters[pass][0];
+            timing.clippingInvocations = counters[pass][1];
+            timing.clippingPrimitives = counters[pass][2];
+            timing.fragmentInvocations = counters[pass][3];
+        }
+        resolved.push_back(timing);
+    }
+    resolvedFrameMilliseconds = frameEnd > frameBegin ? (frameEnd - frameBegin) * timestampPeriod / 1e6 : 0.0;
+
+    // Accumulate by name for the report, restarting every GPU_PROFILER_REPORT_FRAMES frames
+    if (totalFrames == GPU_PROFILER_REPORT_FRAMES) {
+        totals.clear();
+        totalFrames = 0;
+    }
+    for (const GpuPassTiming& timing : resolved) {
+        auto total = std::find_if(totals.begin(), totals.end(),
+            [&timing](const GpuPassTiming& entry) { return strcmp(entry.name, timing.name) == 0; });
+        if (total == totals.end()) {
+            total = totals.insert(totals.end(), { timing.name, 0.0, 0, 0, 0, 0 });
+        }
+        total->milliseconds += timing.milliseconds;
+        total->vertexInvocations += timing.vertexInvocations;
+        total->clippingInvocations += timing.clippingInvocations;
+        total->clippingPrimitives += timing.clippingPrimitives;
+        total->fragmentInvocations += timing.fragmentInvocations;
+    }
+    totalFrames++;
+}
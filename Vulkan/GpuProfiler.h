@@ -0,0 +1,81 @@
+#pragma once
+
+#include "VulkanCore.h"
+
+#include <vector>
+
+// Passes each frame can time; later ones in the frame are only labelled
+#define GPU_PROFILER_MAX_PASSES 16
+
+// Frames whose timings are averaged into the report printed on destroy()
+#define GPU_PROFILER_REPORT_FRAMES 256
+
+struct GpuPassTiming {
+    const char* name;
+    double milliseconds;
+
+    // Pipeline statistics; zero when the device has no pipelineStatisticsQuery or the pass was nested
+    uint64_t vertexInvocations;
+    uint64_t clippingInvocations;
+    uint64_t clippingPrimitives;
+    uint64_t fragmentInvocations;
+};
+
+// Per-pass GPU instrumentation. Every pass is a debug-utils label region (for RenderDoc, Nsight and
+// validation messages) bracketed by timestamp queries, and top-level passes also collect pipeline statistics.
+// Each frame in flight has its own query pools, which beginFrame() reads back once the frame's fence has
+// signalled, so results arrive a frame-in-flight count later and nothing ever waits on the GPU.
+// Without debug utils the labels are skipped; on a queue without timestamps only the labels remain.
+class GpuProfiler {
+public:
+    void create(uint32_t frameCount, bool pipelineStatistics);
+    void destroy();
+
+    // First thing recorded into the frame's command buffer, after its fence wait: collects the results
+    // this frame's queries produced last time round and resets them
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    // name must outlive the frame's results (a string literal)
+    void beginPass(VkCommandBuffer commandBuffer, const char* name);
+    void endPass(VkCommandBuffer commandBuffer);
+
+    // Passes of the most recently resolved frame, in recording order
+    const std::vector<GpuPassTiming>& results() const { return resolved; }
+
+    // From the first pass starting to the last one ending in the most recently resolved frame, 0 if none
+    double frameMilliseconds() const { return resolvedFrameMilliseconds; }
+
+private:
+    struct FrameQueries {
+        VkQueryPool timestamps = VK_NULL_HANDLE;   // begin and end of each pass
+        VkQueryPool statistics = VK_NULL_HANDLE;   // one per pass
+        const char* names[GPU_PROFILER_MAX_PASSES];
+        bool hasStatistics[GPU_PROFILER_MAX_PASSES];
+        uint32_t passCount = 0;
+        bool recorded = false;
+    };
+
+    void resolve(FrameQueries& queries);
+
+    std::vector<FrameQueries> frames;
+    FrameQueries* current = nullptr;
+
+    // Passes open in the current frame, innermost last; UINT32_MAX marks one past GPU_PROFILER_MAX_PASSES
+    std::vector<uint32_t> openPasses;
+    bool statisticsOpen = false;
+
+    bool timestamps = false;
+    bool statistics = false;
+    double timestampPeriod = 1.0;   // ns per tick
+    uint64_t timestampMask = ~0ull;
+
+    PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginLabel = nullptr;
+    PFN_vkCmdEndDebugUtilsLabelEXT cmdEndLabel = nullptr;
+
+    std::vector<GpuPassTiming> resolved;
+    double resolvedFrameMilliseconds = 0.0;
+
+    // Running totals for the report
+    std::vector<GpuPassTiming> totals;
+    uint32_t totalFrames = 0;
+};
@@ -0,0 +1,510 @@
+#include "HiZCuller.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+// Workgroup sizes of the shaders
+#define HIZ_REDUCE_GROUP_SIZE 8
+#define HIZ_CULL_GROUP_SIZE 64
+
+// std430 head of the object buffer in hiz_cull.comp, followed by the CullObjects
+struct CullHeader {
+    glm::mat4 modelViewProj;
+    uint32_t objectCount;
+    uint32_t levelCount;
+    uint32_t padding[2];
+    glm::vec2 extent;            // of the depth rendered to, in pixels
+    glm::vec2 levelZeroExtent;   // of pyramid level 0, in texels
+};
+
+// Push constants of hiz_reduce.comp
+struct ReduceConstants {
+    uint32_t sourceExtent[2];
+    uint32_t extent[2];
+};
+
+static VkPipeline createComputePipeline(VkShaderModule shader, VkPipelineLayout layout) {
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = layout;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocationCallbacks, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z compute pipeline!");
+    }
+    return pipeline;
+}
+
+static void memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+    VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+    VkMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = srcStage;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStage;
+    barrier.dstAccessMask = dstAccess;
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.memoryBarrierCount = 1;
+    depInfo.pMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+}
+
+void HiZCuller::create(uint32_t frameCount, VkShaderModule reduceShader, VkShaderModule cullShader) {
+    // Cull: objects, commands, visibility, pyramid
+    VkDescriptorSetLayoutBinding cullBindings[4]{};
+    for (uint32_t i = 0; i < 4; i++) {
+        cullBindings[i].binding = i;
+        cullBindings[i].descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        cullBindings[i].descriptorCount = 1;
+        cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    // Reduce: the level below (or the depth image), the level written
+    VkDescriptorSetLayoutBinding reduceBindings[2]{};
+    for (uint32_t i = 0; i < 2; i++) {
+        reduceBindings[i].binding = i;
+        reduceBindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        reduceBindings[i].descriptorCount = 1;
+        reduceBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 4;
+    layoutInfo.pBindings = cullBindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocationCallbacks, &cullSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z descriptor set layout!");
+    }
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = reduceBindings;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocationCallbacks, &reduceSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z descriptor set layout!");
+    }
+
+    // The cull takes the phase, the reduction the extents of both levels
+    VkPushConstantRange pushConstants{};
+    pushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstants.size = sizeof(uint32_t);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocationCallbacks, &cullLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z pipeline layout!");
+    }
+    pushConstants.size = sizeof(ReduceConstants);
+    pipelineLayoutInfo.pSetLayouts = &reduceSetLayout;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocationCallbacks, &reduceLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z pipeline layout!");
+    }
+
+    cullPipeline = createComputePipeline(cullShader, cullLayout);
+    reducePipeline = createComputePipeline(reduceShader, reduceLayout);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    if (vkCreateSampler(device, &samplerInfo, hostAllocationCallbacks, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z sampler!");
+    }
+
+    // One cull set and one reduce set per level for each frame, allocated once and rewritten on resize
+    VkDescriptorPoolSize poolSizes[3]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = 3 * frameCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = (1 + HIZ_MAX_LEVELS) * frameCount;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[2].descriptorCount = HIZ_MAX_LEVELS * frameCount;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = (1 + HIZ_MAX_LEVELS) * frameCount;
+    poolInfo.poolSizeCount = 3;
+    poolInfo.pPoolSizes = poolSizes;
+    if (vkCreateDescriptorPool(device, &poolInfo, hostAllocationCallbacks, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Hi-Z descriptor pool!");
+    }
+
+    frames.resize(frameCount);
+    for (FrameResources& frame : frames) {
+        VkDescriptorSetLayout setLayouts[1 + HIZ_MAX_LEVELS];
+        setLayouts[0] = cullSetLayout;
+        std::fill(setLayouts + 1, setLayouts + 1 + HIZ_MAX_LEVELS, reduceSetLayout);
+
+        VkDescriptorSet sets[1 + HIZ_MAX_LEVELS];
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1 + HIZ_MAX_LEVELS;
+        allocInfo.pSetLayouts = setLayouts;
+        if (vkAllocateDescriptorSets(device, &allocInfo, sets) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate Hi-Z descriptor sets!");
+        }
+        frame.cullSet = sets[0];
+        std::copy(sets + 1, sets + 1 + HIZ_MAX_LEVELS, frame.reduceSets);
+
+        createFrameBuffers(frame, HIZ_INITIAL_OBJECTS);
+    }
+    createVisibility(HIZ_INITIAL_OBJECTS);
+
+    std::cout << "Hi-Z culler created successfully!\n";
+}
+
+void HiZCuller::destroy() {
+    for (FrameResources& frame : frames) {
+        destroyPyramid(frame);
+        destroyFrameBuffers(frame);
+    }
+    frames.clear();
+
+    if (visibility != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, visibility, hostAllocationCallbacks);
+        memoryBudget.free(visibilityMemory);
+        visibility = VK_NULL_HANDLE;
+    }
+
+    vkDestroyDescriptorPool(device, descriptorPool, hostAllocationCallbacks);
+    vkDestroySampler(device, sampler, hostAllocationCallbacks);
+    vkDestroyPipeline(device, cullPipeline, hostAllocationCallbacks);
+    vkDestroyPipeline(device, reducePipeline, hostAllocationCallbacks);
+    vkDestroyPipelineLayout(device, cullLayout, hostAllocationCallbacks);
+    vkDestroyPipelineLayout(device, reduceLayout, hostAllocationCallbacks);
+    vkDestroyDescriptorSetLayout(device, cullSetLayout, hostAllocationCallbacks);
+    vkDestroyDescriptorSetLayout(device, reduceSetLayout, hostAllocationCallbacks);
+}
+
+void HiZCuller::createFrameBuffers(FrameResources& frame, uint32_t capacity) {
+    createBuffer(sizeof(CullHeader) + sizeof(CullObject) * VkDeviceSize(capacity),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        frame.objects,
+        frame.objectsMemory,
+        MemoryCategory::Other);
+    vkMapMemory(device, frame.objectsMemory, 0, VK_WHOLE_SIZE, 0, &frame.objectsMapped);
+
+    // Both phases
+    createBuffer(2 * sizeof(VkDrawIndexedIndirectCommand) * VkDeviceSize(capacity),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        frame.commands,
+        frame.commandsMemory,
+        MemoryCategory::Other);
+
+    frame.capacity = capacity;
+}
+
+void HiZCuller::destroyFrameBuffers(FrameResources& frame) {
+    if (frame.objects == VK_NULL_HANDLE) return;
+
+    vkUnmapMemory(device, frame.objectsMemory);
+    vkDestroyBuffer(device, frame.objects, hostAllocationCallbacks);
+    memoryBudget.free(frame.objectsMemory);
+    vkDestroyBuffer(device, frame.commands, hostAllocationCallbacks);
+    memoryBudget.free(frame.commandsMemory);
+    frame.objects = VK_NULL_HANDLE;
+    frame.commands = VK_NULL_HANDLE;
+    frame.capacity = 0;
+}
+
+void HiZCuller::destroyPyramid(FrameResources& frame) {
+    if (frame.pyramid == VK_NULL_HANDLE) return;
+
+    for (uint32_t level = 0; level < pyramidLevels; level++) {
+        vkDestroyImageView(device, frame.levelViews[level], hostAllocationCallbacks);
+        frame.levelViews[level] = VK_NULL_HANDLE;
+    }
+    vkDestroyImageView(device, frame.pyramidView, hostAllocationCallbacks);
+    vkDestroyImage(device, frame.pyramid, hostAllocationCallbacks);
+    memoryBudget.free(frame.pyramidMemory);
+    frame.pyramid = VK_NULL_HANDLE;
+}
+
+void HiZCuller::createVisibility(uint32_t count) {
+    if (visibility != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, visibility, hostAllocationCallbacks);
+        memoryBudget.free(visibilityMemory);
+    }
+
+    createBuffer(sizeof(uint32_t) * VkDeviceSize(count),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        visibility,
+        visibilityMemory,
+        MemoryCategory::Other);
+
+    visibilityCapacity = count;
+    visibilityReset = true;
+}
+
+void HiZCuller::resize(VkExtent2D depthExtent, const VkImageView* depthViews) {
+    PROFILE_FUNCTION();
+
+    for (FrameResources& frame : frames) destroyPyramid(frame);
+
+    // Level 0 is half the depth image, and each level halves it again down to 1x1
+    pyramidExtent = { std::max(depthExtent.width / 2, 1u), std::max(depthExtent.height / 2, 1u) };
+    pyramidLevels = 1;
+    while (pyramidLevels < HIZ_MAX_LEVELS && (pyramidExtent.width >> pyramidLevels || pyramidExtent.height >> pyramidLevels)) {
+        pyramidLevels++;
+    }
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        FrameResources& frame = frames[i];
+        frame.depthView = depthViews[i];
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { pyramidExtent.width, pyramidExtent.height, 1 };
+        imageInfo.mipLevels = pyramidLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(device, &imageInfo, hostAllocationCallbacks, &frame.pyramid) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create Hi-Z pyramid!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, frame.pyramid, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        frame.pyramidMemory = memoryBudget.allocate(allocInfo, MemoryCategory::Attachment);
+        vkBindImageMemory(device, frame.pyramid, frame.pyramidMemory, 0);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = frame.pyramid;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1 };
+        if (vkCreateImageView(device, &viewInfo, hostAllocationCallbacks, &frame.pyramidView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create Hi-Z pyramid view!");
+        }
+
+        // Written as a storage image by one reduction, read through the sampler by the next
+        viewInfo.subresourceRange.levelCount = 1;
+        for (uint32_t level = 0; level < pyramidLevels; level++) {
+            viewInfo.subresourceRange.baseMipLevel = level;
+            if (vkCreateImageView(device, &viewInfo, hostAllocationCallbacks, &frame.levelViews[level]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create Hi-Z pyramid view!");
+            }
+        }
+
+        writeCullSet(frame);
+        writeReduceSets(frame);
+    }
+}
+
+void HiZCuller::writeCullSet(FrameResources& frame) {
+    VkDescriptorBufferInfo bufferInfos[3]{};
+    bufferInfos[0] = { frame.objects, 0, VK_WHOLE_SIZE };
+    bufferInfos[1] = { frame.commands, 0, VK_WHOLE_SIZE };
+    bufferInfos[2] = { visibility, 0, VK_WHOLE_SIZE };
+
+    VkDescriptorImageInfo imageInfo{ sampler, frame.pyramidView, VK_IMAGE_LAYOUT_GENERAL };
+
+    VkWriteDescriptorSet writes[4]{};
+    for (uint32_t i = 0; i < 4; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = frame.cullSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        if (i < 3) writes[i].pBufferInfo = &bufferInfos[i];
+        else writes[i].pImageInfo = &imageInfo;
+    }
+
+    // Before resize() there is no pyramid to point at yet
+    uint32_t writeCount = frame.pyramidView != VK_NULL_HANDLE ? 4 : 3;
+    vkUpdateDescriptorSets(device, writeCount, writes, 0, nullptr);
+}
+
+void HiZCuller::writeReduceSets(FrameResources& frame) {
+    for (uint32_t level = 0; level < pyramidLevels; level++) {
+        VkDescriptorImageInfo imageInfos[2]{};
+        imageInfos[0] = level == 0
+            ? VkDescriptorImageInfo{ sampler, frame.depthView, VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL }
+            : VkDescriptorImageInfo{ sampler, frame.levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+        imageInfos[1] = { VK_NULL_HANDLE, frame.levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+
+        VkWriteDescriptorSet writes[2]{};
+        for (uint32_t i = 0; i < 2; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = frame.reduceSets[level];
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[i].pImageInfo = &imageInfos[i];
+        }
+        vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    }
+}
+
+void HiZCuller::cullEarly(VkCommandBuffer commandBuffer, uint32_t frameIndex, const glm::mat4& modelViewProj, VkExtent2D extent,
+    const CullObject* objects, uint32_t count, uint32_t visibilityCount) {
+    PROFILE_FUNCTION();
+
+    current = frameIndex;
+    FrameResources& frame = frames[frameIndex];
+
+    // Growing the shared visibility buffer is the one step that stalls, and happens only for a bigger scene
+    if (visibilityCount > visibilityCapacity) {
+        vkDeviceWaitIdle(device);
+        createVisibility(std::max(visibilityCount, visibilityCapacity * 2));
+        for (FrameResources& other : frames) writeCullSet(other);
+    }
+    // This frame's fence has been waited on, so its own buffers can be replaced right away
+    if (count > frame.capacity) {
+        uint32_t capacity = std::max(count, frame.capacity * 2);
+        destroyFrameBuffers(frame);
+        createFrameBuffers(frame, capacity);
+        writeCullSet(frame);
+    }
+
+    // Level extents of the part of the depth image rendered to, which the reductions and the cull stay inside
+    renderExtent = extent;
+    levelCount = 0;
+    VkExtent2D levelExtent = { std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u) };
+    while (levelCount < pyramidLevels) {
+        levelExtents[levelCount++] = levelExtent;
+        if (levelExtent.width == 1 && levelExtent.height == 1) break;
+        levelExtent = { std::max(levelExtent.width / 2, 1u), std::max(levelExtent.height / 2, 1u) };
+    }
+
+    CullHeader header{};
+    header.modelViewProj = modelViewProj;
+    header.objectCount = count;
+    header.levelCount = levelCount;
+    header.extent = glm::vec2(extent.width, extent.height);
+    header.levelZeroExtent = glm::vec2(levelExtents[0].width, levelExtents[0].height);
+
+    char* mapped = static_cast<char*>(frame.objectsMapped);
+    memcpy(mapped, &header, sizeof(header));
+    memcpy(mapped + sizeof(header), objects, sizeof(CullObject) * count);
+    objectCount = count;
+
+    if (visibilityReset) {
+        // An earlier frame's second phase may still be writing the visibility being cleared
+        memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+        vkCmdFillBuffer(commandBuffer, visibility, 0, VK_WHOLE_SIZE, 0);
+        memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+        visibilityReset = false;
+    }
+    else {
+        // The previous frame's second phase wrote the visibility this phase reads
+        memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    }
+
+    uint32_t phase = 0;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullLayout, 0, 1, &frame.cullSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phase), &phase);
+    vkCmdDispatch(commandBuffer, (count + HIZ_CULL_GROUP_SIZE - 1) / HIZ_CULL_GROUP_SIZE, 1, 1);
+
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+}
+
+void HiZCuller::cullLate(VkCommandBuffer commandBuffer, VkImage depthImage) {
+    PROFILE_FUNCTION();
+
+    FrameResources& frame = frames[current];
+
+    VkImageMemoryBarrier2 barriers[2]{};
+    barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barriers[0].srcStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    barriers[0].srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[0].dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].image = depthImage;
+    barriers[0].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+    // Last built IMAGES_IN_FLIGHT frames ago, behind that frame's fence
+    barriers[1] = barriers[0];
+    barriers[1].srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+    barriers[1].srcAccessMask = VK_ACCESS_2_NONE;
+    barriers[1].dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barriers[1].image = frame.pyramid;
+    barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1 };
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.imageMemoryBarrierCount = 2;
+    depInfo.pImageMemoryBarriers = barriers;
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+
+    // Each level from the one below it; the depth image is level -1
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipeline);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        ReduceConstants constants{};
+        constants.sourceExtent[0] = level == 0 ? renderExtent.width : levelExtents[level - 1].width;
+        constants.sourceExtent[1] = level == 0 ? renderExtent.height : levelExtents[level - 1].height;
+        constants.extent[0] = levelExtents[level].width;
+        constants.extent[1] = levelExtents[level].height;
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reduceLayout, 0, 1, &frame.reduceSets[level], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, reduceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+        vkCmdDispatch(commandBuffer, (constants.extent[0] + HIZ_REDUCE_GROUP_SIZE - 1) / HIZ_REDUCE_GROUP_SIZE,
+            (constants.extent[1] + HIZ_REDUCE_GROUP_SIZE - 1) / HIZ_REDUCE_GROUP_SIZE, 1);
+
+        memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+    }
+
+    // The depth goes back to being an attachment for the second phase
+    barriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barriers[0].srcAccessMask = VK_ACCESS_2_NONE;
+    barriers[0].dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+    depInfo.imageMemoryBarrierCount = 1;
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+
+    uint32_t phase = 1;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullLayout, 0, 1, &frame.cullSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(phase), &phase);
+    vkCmdDispatch(commandBuffer, (objectCount + HIZ_CULL_GROUP_SIZE - 1) / HIZ_CULL_GROUP_SIZE, 1, 1);
+
+    memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+}
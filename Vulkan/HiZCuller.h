@@ -0,0 +1,129 @@
+#pragma once
+
+#include "VulkanCore.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// 0 draws every subset in the frustum of the LOD it needs, as before
+#define HIZ_CULLING_ENABLED 1
+
+// Mip levels of the depth pyramid, enough for a 64K x 64K depth image
+#define HIZ_MAX_LEVELS 16
+
+// Objects the buffers of each frame hold at first; they grow to the largest draw list seen
+#define HIZ_INITIAL_OBJECTS 1024
+
+// CullObject::flags
+#define CULL_OBJECT_OPAQUE 0x1   // writes depth, and so may be drawn in the first phase
+
+// std430 element of the object buffer, shared with hiz_cull.comp
+struct CullObject {
+    glm::vec3 boundsMin;        // object space
+    uint32_t visibilityIndex;   // stable across frames: the subset's index in its GpuMesh
+    glm::vec3 boundsMax;
+    uint32_t flags;
+    uint32_t indexCount;        // the draw, as in VkDrawIndexedIndirectCommand
+    uint32_t firstIndex;
+    uint32_t materialIndex;     // firstInstance
+    uint32_t padding;
+};
+
+// Two-phase GPU occlusion culling against a hierarchical depth buffer.
+//
+// Every object gets one VkDrawIndexedIndirectCommand per phase, at the same index as in the caller's draw
+// list, so the caller can keep drawing runs of one pipeline with vkCmdDrawIndexedIndirect. An object that is
+// culled keeps its command with an instance count of 0.
+// - First phase (cullEarly): the opaque objects that were visible last frame and are in the frustum. The
+//   caller draws them.
+// - cullLate: the resulting depth, which is last frame's visible set seen from this frame's camera, is
+//   reduced into a pyramid whose texels hold the farthest depth under them. Every object in the frustum is
+//   tested against the level where its screen rectangle covers at most 2x2 texels.
+// - Second phase: draws the objects that pass and were not drawn in the first phase, and records which objects
+//   are visible for the next frame.
+// Depth is not reversed here (cleared to 1, LESS), so the reduction keeps the maximum.
+//
+// Each frame in flight has its own pyramid, object and command buffers. The visibility buffer is shared and
+// ordered between frames by a barrier, so nothing ever waits on the GPU.
+class HiZCuller {
+public:
+    // The shaders are hiz_reduce.comp and hiz_cull.comp; the caller may destroy them afterwards
+    void create(uint32_t frameCount, VkShaderModule reduceShader, VkShaderModule cullShader);
+    void destroy();
+
+    // Whenever the depth images are created: one per frame, in DEPTH_ATTACHMENT_OPTIMAL outside the cull
+    // calls, created with VK_IMAGE_USAGE_SAMPLED_BIT. The device must be idle.
+    void resize(VkExtent2D depthExtent, const VkImageView* depthViews);
+
+    // The next cull starts from nothing visible, for a new scene
+    void resetVisibility() { visibilityReset = true; }
+
+    // Outside rendering, before the first phase is drawn. objects[i] becomes command i of both phases, and
+    // visibilityCount bounds their visibility indices. extent is the part of the depth image rendered to.
+    void cullEarly(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4& modelViewProj, VkExtent2D extent,
+        const CullObject* objects, uint32_t objectCount, uint32_t visibilityCount);
+
+    // Outside rendering, after the first phase has been drawn into depthImage, which it leaves in
+    // DEPTH_ATTACHMENT_OPTIMAL: builds the pyramid and culls the second phase
+    void cullLate(VkCommandBuffer commandBuffer, VkImage depthImage);
+
+    // Indirect commands of the current frame: phase 0 or 1, object index
+    VkBuffer drawCommands() const { return frames[current].commands; }
+    VkDeviceSize drawCommandOffset(uint32_t phase, uint32_t index) const {
+        return (VkDeviceSize(phase) * objectCount + index) * sizeof(VkDrawIndexedIndirectCommand);
+    }
+
+private:
+    struct FrameResources {
+        VkBuffer objects = VK_NULL_HANDLE;   // header and CullObjects, host-visible
+        VkDeviceMemory objectsMemory = VK_NULL_HANDLE;
+        void* objectsMapped = nullptr;
+        VkBuffer commands = VK_NULL_HANDLE;
+        VkDeviceMemory commandsMemory = VK_NULL_HANDLE;
+        uint32_t capacity = 0;   // objects
+
+        VkImage pyramid = VK_NULL_HANDLE;
+        VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+        VkImageView pyramidView = VK_NULL_HANDLE;   // every level, for the cull
+        VkImageView levelViews[HIZ_MAX_LEVELS] = {};
+        VkImageView depthView = VK_NULL_HANDLE;
+
+        VkDescriptorSet cullSet = VK_NULL_HANDLE;
+        VkDescriptorSet reduceSets[HIZ_MAX_LEVELS] = {};
+    };
+
+    void createFrameBuffers(FrameResources& frame, uint32_t capacity);
+    void destroyFrameBuffers(FrameResources& frame);
+    void destroyPyramid(FrameResources& frame);
+    void createVisibility(uint32_t count);
+    void writeCullSet(FrameResources& frame);
+    void writeReduceSets(FrameResources& frame);
+
+    std::vector<FrameResources> frames;
+    uint32_t current = 0;
+
+    VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout reduceSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout cullLayout = VK_NULL_HANDLE;
+    VkPipelineLayout reduceLayout = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    VkPipeline reducePipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;   // nearest; the shaders only use texelFetch
+
+    VkBuffer visibility = VK_NULL_HANDLE;
+    VkDeviceMemory visibilityMemory = VK_NULL_HANDLE;
+    uint32_t visibilityCapacity = 0;
+    bool visibilityReset = true;
+
+    VkExtent2D pyramidExtent = { 0, 0 };   // level 0, half the depth image
+    uint32_t pyramidLevels = 0;
+
+    // Of the current frame
+    uint32_t objectCount = 0;
+    VkExtent2D renderExtent = { 0, 0 };
+    VkExtent2D levelExtents[HIZ_MAX_LEVELS] = {};
+    uint32_t levelCount = 0;
+};
@@ -0,0 +1,221 @@
+#include "HostAllocator.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+static_assert(HOST_ALLOCATOR_MIN_BLOCK << (HOST_ALLOCATOR_SIZE_CLASSES - 1) == HOST_ALLOCATOR_MAX_BLOCK, "size classes must reach HOST_ALLOCATOR_MAX_BLOCK");
+
+const char* allocationScopeName(VkSystemAllocationScope scope) {
+    switch (scope) {
+    case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "command";
+    case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "object";
+    case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "cache";
+    case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "device";
+    case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "instance";
+    default: return "unknown";
+    }
+}
+
+// Smallest size class that holds size bytes, or UINT32_MAX if none does
+static uint32_t sizeClassOf(size_t size) {
+    uint32_t sizeClass = 0;
+    for (size_t blockSize = HOST_ALLOCATOR_MIN_BLOCK; blockSize < size; blockSize <<= 1) {
+        if (++sizeClass == HOST_ALLOCATOR_SIZE_CLASSES) return UINT32_MAX;
+    }
+    return sizeClass;
+}
+
+HostAllocator::HostAllocator() {
+    static_assert(sizeof(BlockHeader) == HOST_ALLOCATOR_MIN_BLOCK, "block header must fill one minimum block");
+
+    allocationCallbacks.pUserData = this;
+    allocationCallbacks.pfnAllocation = allocation;
+    allocationCallbacks.pfnReallocation = reallocation;
+    allocationCallbacks.pfnFree = free;
+    allocationCallbacks.pfnInternalAllocation = internalAllocation;
+    allocationCallbacks.pfnInternalFree = internalFree;
+}
+
+HostAllocator::~HostAllocator() {
+    for (SizeClass& sizeClass : sizeClasses) {
+        while (sizeClass.chunks) {
+            void* next = *static_cast<void**>(sizeClass.chunks);
+            ::operator delete(sizeClass.chunks, std::align_val_t(HOST_ALLOCATOR_MIN_BLOCK));
+            sizeClass.chunks = next;
+        }
+    }
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    if (size == 0) return nullptr;
+
+    uint32_t scopeIndex = static_cast<uint32_t>(scope) < HOST_ALLOCATION_SCOPE_COUNT ? static_cast<uint32_t>(scope) : 0;
+    uint32_t sizeClassIndex = alignment <= HOST_ALLOCATOR_MIN_BLOCK ? sizeClassOf(size) : UINT32_MAX;
+
+    BlockHeader* header;
+    if (sizeClassIndex != UINT32_MAX) {
+        SizeClass& sizeClass = sizeClasses[sizeClassIndex];
+        size_t slotSize = sizeof(BlockHeader) + (size_t(HOST_ALLOCATOR_MIN_BLOCK) << sizeClassIndex);
+
+        std::lock_guard<std::mutex> lock(sizeClass.mutex);
+        if (!sizeClass.freeList) {
+            // Carve a new chunk into slots; its first slot holds the link to the previous chunk
+            char* chunk = static_cast<char*>(::operator new(HOST_ALLOCATOR_CHUNK_SIZE, std::align_val_t(HOST_ALLOCATOR_MIN_BLOCK), std::nothrow));
+            if (!chunk) return nullptr;
+            *reinterpret_cast<void**>(chunk) = sizeClass.chunks;
+            sizeClass.chunks = chunk;
+            sizeClass.chunkCount++;
+
+            for (size_t offset = HOST_ALLOCATOR_MIN_BLOCK; offset + slotSize <= HOST_ALLOCATOR_CHUNK_SIZE; offset += slotSize) {
+                FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + offset);
+                block->next = sizeClass.freeList;
+                sizeClass.freeList = block;
+            }
+        }
+
+        FreeBlock* block = sizeClass.freeList;
+        sizeClass.freeList = block->next;
+        header = reinterpret_cast<BlockHeader*>(block);
+        header->base = nullptr;
+    }
+    else {
+        // The header goes in the alignment-sized slot in front of the block, so the block stays aligned
+        size_t headerSlot = alignment > sizeof(BlockHeader) ? alignment : sizeof(BlockHeader);
+        char* base = static_cast<char*>(::operator new(headerSlot + size, std::align_val_t(headerSlot), std::nothrow));
+        if (!base) return nullptr;
+        header = reinterpret_cast<BlockHeader*>(base + headerSlot) - 1;
+        header->base = base;
+    }
+
+    header->size = size;
+    header->sizeClass = sizeClassIndex;
+    header->scope = scopeIndex;
+    count(scopeIndex, size);
+    return header + 1;
+}
+
+void HostAllocator::release(void* memory) {
+    if (!memory) return;
+
+    BlockHeader* header = static_cast<BlockHeader*>(memory) - 1;
+    uncount(header->scope, header->size);
+
+    if (header->sizeClass == UINT32_MAX) {
+        size_t headerSlot = static_cast<char*>(memory) - static_cast<char*>(header->base);
+        ::operator delete(header->base, std::align_val_t(headerSlot));
+        return;
+    }
+
+    SizeClass& sizeClass = sizeClasses[header->sizeClass];
+    FreeBlock* block = reinterpret_cast<FreeBlock*>(header);
+
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    block->next = sizeClass.freeList;
+    sizeClass.freeList = block;
+}
+
+void HostAllocator::count(uint32_t scope, size_t size) {
+    ScopeCounters& counters = scopes[scope];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+    counters.totalBytes.fetch_add(size, std::memory_order_relaxed);
+    uint64_t bytes = counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+
+    uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while (bytes > peak && !counters.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {}
+
+    frameCount.fetch_add(1, std::memory_order_relaxed);
+    frameByteCount.fetch_add(size, std::memory_order_relaxed);
+}
+
+void HostAllocator::uncount(uint32_t scope, size_t size) {
+    scopes[scope].liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+    scopes[scope].liveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::allocation(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    return static_cast<HostAllocator*>(userData)->allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::reallocation(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    HostAllocator* self = static_cast<HostAllocator*>(userData);
+    if (!original) return self->allocate(size, alignment, scope);
+    if (size == 0) {
+        self->release(original);
+        return nullptr;
+    }
+
+    // Stay in place while the block's size class still fits; the scope is the one it was allocated with
+    BlockHeader* header = static_cast<BlockHeader*>(original) - 1;
+    if (header->sizeClass != UINT32_MAX && size <= (size_t(HOST_ALLOCATOR_MIN_BLOCK) << header->sizeClass)) {
+        self->uncount(header->scope, header->size);
+        self->count(header->scope, size);
+        header->size = size;
+        return original;
+    }
+
+    void* memory = self->allocate(size, alignment, scope);
+    if (!memory) return nullptr;   // the original must survive a failed reallocation
+    memcpy(memory, original, header->size < size ? header->size : size);
+    self->release(original);
+    return memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::free(void* userData, void* memory) {
+    static_cast<HostAllocator*>(userData)->release(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalAllocation(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+    static_cast<HostAllocator*>(userData)->internalByteCount.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalFree(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+    static_cast<HostAllocator*>(userData)->internalByteCount.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void HostAllocator::beginFrame() {
+    lastFrameCount = frameCount.exchange(0, std::memory_order_relaxed);
+    lastFrameByteCount = frameByteCount.exchange(0, std::memory_order_relaxed);
+
+    // The first call only closes off initialization, which is no frame
+    if (frames++ > 0) framedAllocations += lastFrameCount;
+}
+
+HostAllocationStats HostAllocator::scopeStats(VkSystemAllocationScope scope) const {
+    const ScopeCounters& counters = scopes[static_cast<uint32_t>(scope) < HOST_ALLOCATION_SCOPE_COUNT ? static_cast<uint32_t>(scope) : 0];
+    return {
+        counters.allocations.load(std::memory_order_relaxed),
+        counters.liveAllocations.load(std::memory_order_relaxed),
+        counters.liveBytes.load(std::memory_order_relaxed),
+        counters.peakBytes.load(std::memory_order_relaxed),
+        counters.totalBytes.load(std::memory_order_relaxed),
+    };
+}
+
+void HostAllocator::report() const {
+    char line[160];
+
+    std::cout << "Driver host allocations:\n";
+    for (uint32_t scope = 0; scope < HOST_ALLOCATION_SCOPE_COUNT; scope++) {
+        HostAllocationStats stats = scopeStats(static_cast<VkSystemAllocationScope>(scope));
+        snprintf(line, sizeof(line), "  %-8s %8llu allocations, %6llu live (%8.1f KiB, peak %8.1f KiB), %10.1f KiB in total\n",
+            allocationScopeName(static_cast<VkSystemAllocationScope>(scope)),
+            static_cast<unsigned long long>(stats.allocations), static_cast<unsigned long long>(stats.liveAllocations),
+            stats.liveBytes / 1024.0, stats.peakBytes / 1024.0, stats.totalBytes / 1024.0);
+        std::cout << line;
+    }
+
+    uint64_t chunks = 0;
+    for (const SizeClass& sizeClass : sizeClasses) chunks += sizeClass.chunkCount;
+    snprintf(line, sizeof(line), "  pools    %8.1f KiB in %llu chunks; driver-internal %.1f KiB\n",
+        chunks * HOST_ALLOCATOR_CHUNK_SIZE / 1024.0, static_cast<unsigned long long>(chunks), internalBytes() / 1024.0);
+    std::cout << line;
+
+    if (frames > 1) {
+        snprintf(line, sizeof(line), "  %.1f allocations per frame on average, %llu in the last frame\n",
+            double(framedAllocations) / double(frames - 1), static_cast<unsigned long long>(lastFrameCount));
+        std::cout << line;
+    }
+}
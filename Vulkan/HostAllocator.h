@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// 0 passes no allocation callbacks, leaving host allocations to the driver's own allocator
+#ifndef HOST_ALLOCATOR_ENABLED
+#define HOST_ALLOCATOR_ENABLED 1
+#endif
+
+// Pooled size classes are powers of two from HOST_ALLOCATOR_MIN_BLOCK up to HOST_ALLOCATOR_MAX_BLOCK bytes;
+// anything larger, or aligned to more than a block header, goes straight to operator new
+#define HOST_ALLOCATOR_MIN_BLOCK 32
+#define HOST_ALLOCATOR_MAX_BLOCK 4096
+#define HOST_ALLOCATOR_SIZE_CLASSES 8
+
+// Bytes each size class takes from operator new whenever its free list runs dry
+#define HOST_ALLOCATOR_CHUNK_SIZE (64 * 1024)
+
+// Scopes from VK_SYSTEM_ALLOCATION_SCOPE_COMMAND to VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE
+#define HOST_ALLOCATION_SCOPE_COUNT 5
+
+const char* allocationScopeName(VkSystemAllocationScope scope);
+
+struct HostAllocationStats {
+    uint64_t allocations;   // since the start of the run, reallocations included
+    uint64_t liveAllocations;
+    uint64_t liveBytes;
+    uint64_t peakBytes;
+    uint64_t totalBytes;    // requested since the start of the run
+};
+
+// VkAllocationCallbacks for the driver's host allocations. Small blocks come from per-size-class free lists,
+// so the command-scope churn of recording and submitting rarely reaches malloc; each size class has its own
+// lock, as drivers call in from whichever thread is using the object. Everything is counted by
+// VkSystemAllocationScope, and the allocations made during the current frame are counted separately so that
+// a frame that should be allocation-free can be checked.
+//
+// The callbacks must stay valid until the last object created with them is destroyed, so the allocator is
+// a global that is only torn down at exit.
+class HostAllocator {
+public:
+    HostAllocator();
+    ~HostAllocator();
+
+    HostAllocator(const HostAllocator&) = delete;
+    HostAllocator& operator=(const HostAllocator&) = delete;
+
+    const VkAllocationCallbacks* callbacks() const { return &allocationCallbacks; }
+
+    // Main thread, once per frame: the current frame's counters become the last frame's and start over
+    void beginFrame();
+
+    HostAllocationStats scopeStats(VkSystemAllocationScope scope) const;
+
+    // Allocations made through the callbacks during the last complete frame, and their bytes
+    uint64_t lastFrameAllocations() const { return lastFrameCount; }
+    uint64_t lastFrameBytes() const { return lastFrameByteCount; }
+
+    // Bytes the driver reported allocating itself through vkInternalAllocationNotification
+    uint64_t internalBytes() const { return internalByteCount.load(std::memory_order_relaxed); }
+
+    // Prints the counters of every scope, the pools' footprint and the per-frame averages
+    void report() const;
+
+private:
+    // Sits right in front of every block handed to the driver
+    struct alignas(HOST_ALLOCATOR_MIN_BLOCK) BlockHeader {
+        void* base;            // what to give back to operator new, for blocks outside the pools
+        size_t size;           // requested size
+        uint32_t sizeClass;    // UINT32_MAX outside the pools
+        uint32_t scope;
+    };
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct SizeClass {
+        std::mutex mutex;
+        FreeBlock* freeList = nullptr;
+        void* chunks = nullptr;   // chunks are linked through their first bytes
+        uint64_t chunkCount = 0;
+    };
+
+    struct ScopeCounters {
+        std::atomic<uint64_t> allocations{ 0 };
+        std::atomic<uint64_t> liveAllocations{ 0 };
+        std::atomic<uint64_t> liveBytes{ 0 };
+        std::atomic<uint64_t> peakBytes{ 0 };
+        std::atomic<uint64_t> totalBytes{ 0 };
+    };
+
+    static VKAPI_ATTR void* VKAPI_CALL allocation(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL reallocation(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL free(void* userData, void* memory);
+    static VKAPI_ATTR void VKAPI_CALL internalAllocation(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL internalFree(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+    void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void release(void* memory);
+    void count(uint32_t scope, size_t size);
+    void uncount(uint32_t scope, size_t size);
+
+    VkAllocationCallbacks allocationCallbacks{};
+    SizeClass sizeClasses[HOST_ALLOCATOR_SIZE_CLASSES];
+    ScopeCounters scopes[HOST_ALLOCATION_SCOPE_COUNT];
+
+    std::atomic<uint64_t> internalByteCount{ 0 };
+
+    std::atomic<uint64_t> frameCount{ 0 };
+    std::atomic<uint64_t> frameByteCount{ 0 };
+    uint64_t lastFrameCount = 0;
+    uint64_t lastFrameByteCount = 0;
+    uint64_t frames = 0;
+    uint64_t framedAllocations = 0;   // summed over every complete frame, for the average
+};
+
+extern HostAllocator hostAllocator;
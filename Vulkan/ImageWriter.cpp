@@ -0,0 +1,142 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <vector>
+
+// Stored deflate blocks hold at most this many bytes
+#define DEFLATE_STORED_BLOCK 65535
+
+bool writeImage(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height) {
+    bool ppm = path.size() >= 4 && path.compare(path.size() - 4, 4, ".ppm") == 0;
+    return ppm ? writePpm(path, rgba, width, height) : writePng(path, rgba, width, height);
+}
+
+bool writePpm(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+
+    std::vector<uint8_t> row(size_t(width) * 3);
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* source = rgba + size_t(y) * width * 4;
+        for (uint32_t x = 0; x < width; x++) {
+            row[x * 3 + 0] = source[x * 4 + 0];
+            row[x * 3 + 1] = source[x * 4 + 1];
+            row[x * 3 + 2] = source[x * 4 + 2];
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    return bool(file);
+}
+
+static const std::array<uint32_t, 256>& crcTable() {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> entries{};
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+        return entries;
+    }();
+    return table;
+}
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size) {
+    const std::array<uint32_t, 256>& table = crcTable();
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+static void putBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(uint8_t(value >> 24));
+    out.push_back(uint8_t(value >> 16));
+    out.push_back(uint8_t(value >> 8));
+    out.push_back(uint8_t(value));
+}
+
+static void writeChunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> header;
+    putBigEndian(header, static_cast<uint32_t>(data.size()));
+    header.insert(header.end(), type, type + 4);
+
+    uint32_t crc = updateCrc(0xffffffffu, header.data() + 4, 4);
+    crc = updateCrc(crc, data.data(), data.size()) ^ 0xffffffffu;
+
+    std::vector<uint8_t> trailer;
+    putBigEndian(trailer, crc);
+
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    file.write(reinterpret_cast<const char*>(trailer.data()), trailer.size());
+}
+
+bool writePng(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<uint8_t> header;
+    putBigEndian(header, width);
+    putBigEndian(header, height);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 });   // 8-bit RGB, deflate, adaptive filtering, no interlace
+    writeChunk(file, "IHDR", header);
+
+    // Scanlines with filter type 0 in front of each
+    size_t rowBytes = size_t(width) * 3 + 1;
+    std::vector<uint8_t> raw(rowBytes * height);
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* row = raw.data() + y * rowBytes;
+        const uint8_t* source = rgba + size_t(y) * width * 4;
+        row[0] = 0;
+        for (uint32_t x = 0; x < width; x++) {
+            row[1 + x * 3 + 0] = source[x * 4 + 0];
+            row[1 + x * 3 + 1] = source[x * 4 + 1];
+            row[1 + x * 3 + 2] = source[x * 4 + 2];
+        }
+    }
+
+    // zlib stream of stored deflate blocks, followed by the Adler-32 of the scanlines
+    std::vector<uint8_t> compressed;
+    compressed.reserve(raw.size() + raw.size() / DEFLATE_STORED_BLOCK * 5 + 16);
+    compressed.push_back(0x78);
+    compressed.push_back(0x01);
+
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+    size_t offset = 0;
+    do {
+        size_t blockSize = std::min<size_t>(raw.size() - offset, DEFLATE_STORED_BLOCK);
+        bool last = offset + blockSize == raw.size();
+
+        compressed.push_back(last ? 1 : 0);
+        compressed.push_back(uint8_t(blockSize));
+        compressed.push_back(uint8_t(blockSize >> 8));
+        compressed.push_back(uint8_t(~blockSize));
+        compressed.push_back(uint8_t(~blockSize >> 8));
+        compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+
+        // The sums cannot overflow within 5552 bytes, so the modulo only runs once per run of that many
+        for (size_t run = offset; run < offset + blockSize; run += 5552) {
+            size_t runEnd = std::min(run + 5552, offset + blockSize);
+            for (size_t i = run; i < runEnd; i++) {
+                adlerA += raw[i];
+                adlerB += adlerA;
+            }
+            adlerA %= 65521;
+            adlerB %= 65521;
+        }
+        offset += blockSize;
+    } while (offset < raw.size());
+
+    putBigEndian(compressed, (adlerB << 16) | adlerA);
+    writeChunk(file, "IDAT", compressed);
+    writeChunk(file, "IEND", {});
+
+    return bool(file);
+}
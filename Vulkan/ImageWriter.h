@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Writes tightly packed 8-bit RGBA pixels, top row first, dropping alpha. The format follows the extension:
+// ".ppm" is binary PPM, anything else PNG. PNGs are stored without compression, trading file size for an encoder
+// that costs no more than a CRC pass over the pixels. Returns false if the file cannot be written.
+bool writeImage(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+bool writePpm(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height);
+bool writePng(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height);
@@ -0,0 +1,283 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+// Index into JobSystem::states of the calling thread, -1 for threads the job system doesn't know
+static thread_local int threadIndex = -1;
+
+// Failed steal rounds before an idle worker goes to sleep
+#define JOB_IDLE_SPINS 64
+
+bool JobDeque::push(Job* job) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= JOB_QUEUE_SIZE) return false;
+
+    jobs[b & (JOB_QUEUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+Job* JobDeque::pop() {
+    // The paper's seq_cst fences are folded into the accesses around them, which is equivalent here
+    // and visible to thread sanitizers
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_seq_cst);
+
+    if (t > b) {
+        // Empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = jobs[b & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // Last job: race the thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* JobDeque::steal() {
+    int64_t t = top.load(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_seq_cst);
+    if (t >= b) return nullptr;
+
+    Job* job = jobs[t & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;   // lost to the owner or another thief
+    }
+    return job;
+}
+
+void JobSystem::start(uint32_t workerCount) {
+    if (workerCount == 0) {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    states.resize(workerCount + 1);
+    for (uint32_t i = 0; i < states.size(); i++) {
+        states[i] = new ThreadState();
+        states[i]->random = i * 2654435761u + 1;
+    }
+
+    threadIndex = 0;
+    running.store(true, std::memory_order_release);
+
+    for (uint32_t i = 1; i <= workerCount; i++) {
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+void JobSystem::stop() {
+    if (!running.load(std::memory_order_acquire)) return;
+
+    // Run whatever the main thread was still owed, then let the workers go
+    pumpMainThread();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        running.store(false, std::memory_order_release);
+    }
+    wakeCondition.notify_all();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+
+    for (ThreadState* state : states) {
+        delete state;
+    }
+    states.clear();
+    threadIndex = -1;
+}
+
+bool JobSystem::isMainThread() const {
+    return threadIndex == 0;
+}
+
+Job* JobSystem::allocateJob() {
+    if (threadIndex < 0) {
+        throw std::runtime_error("jobs can only be queued from the main thread or from a job!");
+    }
+
+    // Round-robin from the last slot handed out, skipping those whose jobs are still unfinished, so one
+    // long-running job doesn't stop the pool from wrapping around it
+    ThreadState& self = *states[threadIndex];
+    for (uint32_t i = 0; i < JOB_QUEUE_SIZE; i++) {
+        Job* job = &self.pool[self.poolNext++ & (JOB_QUEUE_SIZE - 1)];
+        if (!job->inUse.exchange(true, std::memory_order_acquire)) return job;
+    }
+    throw std::runtime_error("job pool exhausted!");
+}
+
+void JobSystem::submit(Job* job, JobCounter* dependency) {
+    if (dependency) {
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->pending.load(std::memory_order_acquire) != 0) {
+            // Queued by whichever thread finishes the dependency's last job
+            job->next = dependency->waiting;
+            dependency->waiting = job;
+            return;
+        }
+    }
+    push(job);
+}
+
+void JobSystem::submitToMainThread(Job* job) {
+    std::lock_guard<std::mutex> lock(mainThreadMutex);
+    if (mainThreadTail) mainThreadTail->next = job;
+    else mainThreadHead = job;
+    mainThreadTail = job;
+}
+
+void JobSystem::push(Job* job) {
+    if (!states[threadIndex]->deque.push(job)) {
+        // Deque full: run it here rather than block
+        execute(job);
+        return;
+    }
+
+    queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+        // Taking the mutex orders this against a worker that is between checking queuedJobs and sleeping
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wakeCondition.notify_one();
+    }
+}
+
+void JobSystem::execute(Job* job) {
+    job->invoke(*job);
+    job->destroy(*job);
+
+    JobCounter* counter = job->counter;
+    job->inUse.store(false, std::memory_order_release);
+    if (!counter) return;
+
+    Job* ready = nullptr;
+    {
+        // Held across the decrement so wait() can't return, and its counter go out of scope, under our feet
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ready = counter->waiting;
+            counter->waiting = nullptr;
+        }
+    }
+
+    while (ready) {
+        Job* next = ready->next;
+        ready->next = nullptr;
+        push(ready);
+        ready = next;
+    }
+}
+
+Job* JobSystem::findJob(ThreadState& self) {
+    Job* job = self.deque.pop();
+
+    if (!job) {
+        // Start at a random victim so thieves spread out
+        uint32_t count = static_cast<uint32_t>(states.size());
+        self.random ^= self.random << 13;
+        self.random ^= self.random >> 17;
+        self.random ^= self.random << 5;
+
+        uint32_t first = self.random % count;
+        for (uint32_t i = 0; i < count && !job; i++) {
+            ThreadState* victim = states[(first + i) % count];
+            if (victim != &self) job = victim->deque.steal();
+        }
+    }
+
+    if (job) queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+bool JobSystem::runMainThreadJob() {
+    Job* job;
+    {
+        std::lock_guard<std::mutex> lock(mainThreadMutex);
+        job = mainThreadHead;
+        if (!job) return false;
+
+        mainThreadHead = job->next;
+        if (!mainThreadHead) mainThreadTail = nullptr;
+    }
+
+    job->next = nullptr;
+    execute(job);
+    return true;
+}
+
+void JobSystem::pumpMainThread() {
+    if (!isMainThread()) return;
+
+    // Only what is queued now, so a job that queues itself again can't keep the frame waiting
+    Job* job;
+    {
+        std::lock_guard<std::mutex> lock(mainThreadMutex);
+        job = mainThreadHead;
+        mainThreadHead = nullptr;
+        mainThreadTail = nullptr;
+    }
+
+    while (job) {
+        Job* next = job->next;
+        job->next = nullptr;
+        execute(job);
+        job = next;
+    }
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    while (!counter.done()) {
+        if (isMainThread() && runMainThreadJob()) continue;
+
+        Job* job = threadIndex >= 0 ? findJob(*states[threadIndex]) : nullptr;
+        if (job) execute(job);
+        else std::this_thread::yield();
+    }
+
+    // The thread that finished the last job may still be inside the counter's lock
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+    threadIndex = static_cast<int>(index);
+    ThreadState& self = *states[index];
+
+#if PROFILER_ENABLED
+    char threadName[32];
+    snprintf(threadName, sizeof(threadName), "Worker %u", index);
+    PROFILE_THREAD_NAME(threadName);
+#endif
+
+    uint32_t idleSpins = 0;
+    while (running.load(std::memory_order_acquire)) {
+        if (Job* job = findJob(self)) {
+            execute(job);
+            idleSpins = 0;
+            continue;
+        }
+
+        if (++idleSpins < JOB_IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        wakeCondition.wait(lock, [this] {
+            return queuedJobs.load(std::memory_order_seq_cst) > 0 || !running.load(std::memory_order_acquire);
+        });
+        sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+        idleSpins = 0;
+    }
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Jobs each thread can have queued at once; also the size of each thread's job pool
+#define JOB_QUEUE_SIZE 4096
+
+// Bytes of captured state a job can carry without touching the heap
+#define JOB_STORAGE_SIZE 48
+
+struct Job;
+
+// Counts unfinished jobs. Jobs can be made to wait for a counter to reach zero before they start,
+// and threads can wait on one while helping to run other jobs.
+struct JobCounter {
+    std::atomic<uint32_t> pending{ 0 };
+
+    std::mutex mutex;
+    Job* waiting = nullptr;   // jobs to queue once pending drops to zero
+
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job {
+    std::atomic<bool> inUse{ false };   // the slot is free again once the job has run
+    void (*invoke)(Job&) = nullptr;
+    void (*destroy)(Job&) = nullptr;
+    alignas(std::max_align_t) unsigned char storage[JOB_STORAGE_SIZE];
+
+    JobCounter* counter = nullptr;   // decremented when the job has run
+    Job* next = nullptr;             // intrusive link for JobCounter::waiting and the main-thread queue
+};
+
+// Chase-Lev work-stealing deque (Le et al. 2013, "Correct and Efficient Work-Stealing for Weak Memory Models").
+// The owning thread pushes and pops at the bottom, LIFO for cache locality; any other thread steals
+// from the top. Fixed capacity: push() fails when full and the caller runs the job itself.
+class JobDeque {
+public:
+    bool push(Job* job);
+    Job* pop();
+    Job* steal();
+
+private:
+    alignas(64) std::atomic<int64_t> top{ 0 };
+    alignas(64) std::atomic<int64_t> bottom{ 0 };
+    std::atomic<Job*> jobs[JOB_QUEUE_SIZE];
+};
+
+// Work-stealing scheduler: one worker per remaining core, plus the main thread, which takes part whenever
+// it waits. Each thread owns a deque and a job pool; idle workers steal from random victims and go to sleep
+// when there is nothing to steal. Jobs queued with runOnMainThread() only ever run on the main thread
+// (GLFW must only be called from there), from pumpMainThread() or while it waits.
+//
+// Jobs may only be queued from the main thread or from inside other jobs, and come out of a per-thread pool of
+// JOB_QUEUE_SIZE slots, so no thread may have more than that many of its jobs unfinished at once.
+// Before start() every job runs inline on the calling thread, so code using the job system also works
+// in tools that never start workers.
+class JobSystem {
+public:
+    // workerCount 0 uses one worker per hardware thread besides the calling one, which becomes the main thread
+    void start(uint32_t workerCount = 0);
+    void stop();
+
+    ~JobSystem() { stop(); }
+
+    template <typename F>
+    void run(F&& function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr) {
+        if (!running.load(std::memory_order_acquire)) {
+            function();
+            return;
+        }
+        submit(createJob(std::forward<F>(function), counter), dependency);
+    }
+
+    template <typename F>
+    void runOnMainThread(F&& function, JobCounter* counter = nullptr) {
+        if (!running.load(std::memory_order_acquire)) {
+            function();
+            return;
+        }
+        submitToMainThread(createJob(std::forward<F>(function), counter));
+    }
+
+    // Calls function(begin, end) over [0, count) in chunks of at most grainSize, and returns once all have run
+    template <typename F>
+    void parallelFor(uint32_t count, uint32_t grainSize, const F& function) {
+        JobCounter counter;
+        for (uint32_t begin = 0; begin < count; begin += grainSize) {
+            uint32_t end = begin + grainSize < count ? begin + grainSize : count;
+            run([&function, begin, end] { function(begin, end); }, &counter);
+        }
+        wait(counter);
+    }
+
+    // Runs other jobs (and main-thread jobs, on the main thread) until counter reaches zero
+    void wait(JobCounter& counter);
+
+    // Runs the jobs queued for the main thread; call once per frame from the main loop
+    void pumpMainThread();
+
+    bool isMainThread() const;
+    // Threads that run jobs, the main thread included
+    uint32_t threadCount() const { return states.empty() ? 1 : static_cast<uint32_t>(states.size()); }
+
+private:
+    struct ThreadState {
+        JobDeque deque;
+        Job pool[JOB_QUEUE_SIZE];
+        uint32_t poolNext = 0;
+        uint32_t random = 0;   // xorshift state for picking steal victims
+    };
+
+    template <typename F>
+    Job* createJob(F&& function, JobCounter* counter) {
+        using Function = std::decay_t<F>;
+        static_assert(sizeof(Function) <= JOB_STORAGE_SIZE, "job captures more than JOB_STORAGE_SIZE bytes");
+        static_assert(alignof(Function) <= alignof(std::max_align_t), "job capture is over-aligned");
+
+        Job* job = allocateJob();
+        new (job->storage) Function(std::forward<F>(function));
+        job->invoke = [](Job& self) { (*std::launder(reinterpret_cast<Function*>(self.storage)))(); };
+        job->destroy = [](Job& self) { std::launder(reinterpret_cast<Function*>(self.storage))->~Function(); };
+        job->counter = counter;
+        job->next = nullptr;
+
+        if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    Job* allocateJob();
+    void submit(Job* job, JobCounter* dependency);
+    void submitToMainThread(Job* job);
+    void push(Job* job);
+    void execute(Job* job);
+    Job* findJob(ThreadState& self);
+    bool runMainThreadJob();
+    void workerLoop(uint32_t index);
+
+    std::vector<ThreadState*> states;   // [0] is the main thread
+    std::vector<std::thread> threads;
+
+    std::atomic<bool> running{ false };
+    std::atomic<uint32_t> queuedJobs{ 0 };
+    std::atomic<uint32_t> sleepingWorkers{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+
+    std::mutex mainThreadMutex;
+    Job* mainThreadHead = nullptr;
+    Job* mainThreadTail = nullptr;
+};
+
+extern JobSystem jobSystem;
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file.
+// The bytes are read straight out of the page cache, so loading a file costs no
+// heap allocation and no copy. The mapping is hinted for sequential access.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& filename) {
+#ifdef _WIN32
+        // FILE_FLAG_SEQUENTIAL_SCAN is the Win32 counterpart of MADV_SEQUENTIAL
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("failed to open file: " + filename);
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            CloseHandle(file);
+            throw std::runtime_error("failed to stat file: " + filename);
+        }
+        mappedSize = static_cast<size_t>(fileSize.QuadPart);
+
+        if (mappedSize > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping != nullptr) {
+                mappedBytes = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                CloseHandle(mapping); // the view keeps the mapping alive
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open file: " + filename);
+        }
+
+        struct stat sb {};
+        if (fstat(fd, &sb) != 0) {
+            close(fd);
+            throw std::runtime_error("failed to stat file: " + filename);
+        }
+        mappedSize = static_cast<size_t>(sb.st_size);
+
+        if (mappedSize > 0) {
+            void* p = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, mappedSize, MADV_SEQUENTIAL);
+                mappedBytes = static_cast<const char*>(p);
+            }
+        }
+        close(fd); // the mapping keeps the file alive
+#endif
+
+        if (mappedSize > 0 && mappedBytes == nullptr) {
+            throw std::runtime_error("failed to map file: " + filename);
+        }
+    }
+
+    ~MappedFile() {
+        if (mappedBytes == nullptr) return;
+#ifdef _WIN32
+        UnmapViewOfFile(mappedBytes);
+#else
+        munmap(const_cast<char*>(mappedBytes), mappedSize);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept : mappedBytes(other.mappedBytes), mappedSize(other.mappedSize) {
+        other.mappedBytes = nullptr;
+        other.mappedSize = 0;
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            this->~MappedFile();
+            mappedBytes = other.mappedBytes;
+            mappedSize = other.mappedSize;
+            other.mappedBytes = nullptr;
+            other.mappedSize = 0;
+        }
+        return *this;
+    }
+
+    // Page aligned, so it can be handed to vkCreateShaderModule as-is
+    const char* data() const { return mappedBytes; }
+    size_t size() const { return mappedSize; }
+
+private:
+    const char* mappedBytes = nullptr;
+    size_t mappedSize = 0;
+};
@@ -0,0 +1,112 @@
+#include "Material.h"
+#include "PipelineCompiler.h"
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+MaterialTable::MaterialTable() {
+    add(GpuMaterial{});
+}
+
+size_t MaterialTable::MaterialHash::operator()(const GpuMaterial& material) const {
+    // FNV-1a over the raw floats; identical materials are bit-identical since they come from the same parser
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&material);
+    size_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(GpuMaterial); i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint32_t MaterialTable::add(const GpuMaterial& material) {
+    auto [it, inserted] = lookup.emplace(material, static_cast<uint32_t>(materials.size()));
+    if (inserted) {
+        materials.push_back(material);
+    }
+    return it->second;
+}
+
+bool MaterialTable::upload() {
+    bool recreated = false;
+
+    if (materials.size() > materialBufferCapacity) {
+        size_t capacity = std::max<size_t>({ materials.size(), materialBufferCapacity * 2, MATERIAL_TABLE_INITIAL_CAPACITY });
+
+        // The caller makes sure the GPU is done with the old buffer
+        destroy();
+
+        materialBufferCapacity = capacity;
+        createBuffer(bufferSize(),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            materialBuffer,
+            materialBufferMemory,
+            MemoryCategory::Other);
+        recreated = true;
+    }
+
+    VkDeviceSize bytes = materials.size() * sizeof(GpuMaterial);
+    StagingRing ring(bytes);
+    ring.write(materialBuffer, 0, materials.data(), bytes);
+    ring.finish();
+
+    uploadedCount = materials.size();
+    return recreated;
+}
+
+bool MaterialTable::recordUpdate(VkCommandBuffer commandBuffer) {
+    if (uploadedCount == materials.size()) return true;
+    if (materials.size() > materialBufferCapacity) return false;
+
+    // vkCmdUpdateBuffer takes at most 65536 bytes at a time
+    const size_t chunk = 65536 / sizeof(GpuMaterial);
+    for (size_t first = uploadedCount; first < materials.size(); first += chunk) {
+        size_t count = std::min(chunk, materials.size() - first);
+        vkCmdUpdateBuffer(commandBuffer, materialBuffer, first * sizeof(GpuMaterial), count * sizeof(GpuMaterial), &materials[first]);
+    }
+    uploadedCount = materials.size();
+
+    // vkCmdUpdateBuffer runs in the clear stage, not the copy stage
+    VkMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.memoryBarrierCount = 1;
+    depInfo.pMemoryBarriers = &barrier;
+
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+    return true;
+}
+
+void MaterialTable::destroy() {
+    vkDestroyBuffer(device, materialBuffer, hostAllocationCallbacks);
+    memoryBudget.free(materialBufferMemory);
+    materialBuffer = VK_NULL_HANDLE;
+    materialBufferMemory = VK_NULL_HANDLE;
+    materialBufferCapacity = 0;
+    uploadedCount = 0;
+}
+
+uint64_t makeDrawSortKey(uint32_t pipelineIndex, uint32_t materialIndex, float viewDepth) {
+    // Non-negative floats order the same as their bit patterns
+    uint32_t depthBits;
+    float depth = viewDepth > 0.0f ? viewDepth : 0.0f;
+    memcpy(&depthBits, &depth, sizeof(depthBits));
+
+    // Blended draws composite in order, so they go back to front whatever their material
+    if (pipelineIndex & PIPELINE_VARIANT_BLEND) {
+        return (uint64_t(pipelineIndex & 0xFF) << 56) | ~depthBits;
+    }
+    return (uint64_t(pipelineIndex & 0xFF) << 56) | (uint64_t(materialIndex & 0xFFFFFF) << 32) | depthBits;
+}
+
+void sortDrawItems(DrawItem* draws, size_t count) {
+    std::sort(draws, draws + count, [](const DrawItem& a, const DrawItem& b) { return a.sortKey < b.sortKey; });
+}
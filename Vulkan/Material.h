@@ -0,0 +1,82 @@
+#pragma once
+
+#include "VulkanCore.h"
+
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+// Entries the material buffer is first created with, so materials of streamed-in meshes rarely force a reallocation
+#define MATERIAL_TABLE_INITIAL_CAPACITY 256
+
+// One entry of the material table, std430 layout to match Material in Shaders/shader.frag
+struct GpuMaterial {
+    glm::vec4 diffuse = glm::vec4(1.0f);                       // Kd, d (dissolve)
+    glm::vec4 specular = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);    // Ks, Ns (shininess)
+    glm::vec4 emission = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);    // Ke, Ni (index of refraction)
+
+    bool operator==(const GpuMaterial& other) const {
+        return diffuse == other.diffuse && specular == other.specular && emission == other.emission;
+    }
+};
+
+static_assert(sizeof(GpuMaterial) == 48, "GpuMaterial must stay tightly packed for std430");
+
+// Every material of every mesh, deduplicated, in one device-local storage buffer.
+// Draws pick their entry through firstInstance (gl_InstanceIndex), so a material change needs
+// neither a pipeline bind nor a push constant update.
+class MaterialTable {
+public:
+    MaterialTable();
+
+    // Returns the index of an identical entry, adding one if there is none.
+    // Index 0 is the default material (white, so vertex colors show through).
+    uint32_t add(const GpuMaterial& material);
+
+    // (Re)creates the storage buffer if the table has outgrown it and copies the whole table into it.
+    // Returns true when the buffer was recreated, so descriptor sets pointing at it need rewriting.
+    bool upload();
+
+    // Records vkCmdUpdateBuffer for the entries added since the last upload, followed by a barrier for
+    // fragment shader reads. Returns false without recording anything if they no longer fit the buffer,
+    // in which case upload() has to be called once the GPU is idle.
+    bool recordUpdate(VkCommandBuffer commandBuffer);
+
+    void destroy();
+
+    VkBuffer buffer() const { return materialBuffer; }
+    VkDeviceSize bufferSize() const { return materialBufferCapacity * sizeof(GpuMaterial); }
+    uint32_t size() const { return static_cast<uint32_t>(materials.size()); }
+    const GpuMaterial& operator[](uint32_t index) const { return materials[index]; }
+
+private:
+    struct MaterialHash {
+        size_t operator()(const GpuMaterial& material) const;
+    };
+
+    std::vector<GpuMaterial> materials;
+    std::unordered_map<GpuMaterial, uint32_t, MaterialHash> lookup;
+
+    VkBuffer materialBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory materialBufferMemory = VK_NULL_HANDLE;
+    size_t materialBufferCapacity = 0;
+    size_t uploadedCount = 0;   // entries already in the buffer
+};
+
+// ---- Draw sorting ----
+// Draws are sorted by a 64 bit key: pipeline in the top 8 bits, material in the next 24, then view depth,
+// so each pipeline is bound once, draws of one material are adjacent and each batch goes front to back.
+// Blended draws leave out the material and sort back to front instead.
+
+struct DrawItem {
+    uint64_t sortKey;
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    uint32_t materialIndex;
+    uint32_t subsetIndex;   // into GpuMesh::subsets, for culling
+};
+
+uint64_t makeDrawSortKey(uint32_t pipelineIndex, uint32_t materialIndex, float viewDepth);
+
+void sortDrawItems(DrawItem* draws, size_t count);
@@ -0,0 +1,180 @@
+#include "MemoryBudget.h"
+
+#include "VulkanCore.h"
+
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+const char* memoryCategoryName(MemoryCategory category) {
+    switch (category) {
+    case MemoryCategory::Vertex: return "vertex";
+    case MemoryCategory::Index: return "index";
+    case MemoryCategory::Texture: return "texture";
+    case MemoryCategory::Attachment: return "attachment";
+    case MemoryCategory::Staging: return "staging";
+    case MemoryCategory::Uniform: return "uniform";
+    case MemoryCategory::Readback: return "readback";
+    default: return "other";
+    }
+}
+
+void MemoryBudget::create(bool extension) {
+    budgetExtension = extension;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    update();
+
+    std::cout << "Memory budget tracking created (" << (budgetExtension ? "VK_EXT_memory_budget" : "estimated budgets") << ")\n";
+}
+
+void MemoryBudget::destroy() {
+    std::lock_guard<std::mutex> lock(allocationsMutex);
+    if (!allocations.empty()) {
+        std::cerr << allocations.size() << " device memory allocations were never freed:\n";
+        for (const auto& [memory, allocation] : allocations) {
+            std::cerr << "  " << allocation.size << " bytes of " << memoryCategoryName(allocation.category) << "\n";
+        }
+    }
+    allocations.clear();
+}
+
+VkDeviceMemory MemoryBudget::allocate(const VkMemoryAllocateInfo& allocInfo, MemoryCategory category) {
+    bool knownType = allocInfo.memoryTypeIndex < memoryProperties.memoryTypeCount;
+    uint32_t heapIndex = knownType ? memoryProperties.memoryTypes[allocInfo.memoryTypeIndex].heapIndex : 0;
+
+    // Give the residency policy the chance to make room before going over budget, not after
+    if (knownType) {
+        MemoryHeapStats heap = heapStats(heapIndex);
+        if (heap.usage + allocInfo.allocationSize > heap.budget) {
+            pressure(heapIndex, allocInfo.allocationSize);
+        }
+    }
+
+    VkDeviceMemory memory;
+    VkResult result = vkAllocateMemory(device, &allocInfo, hostAllocationCallbacks, &memory);
+    if ((result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) && knownType && pressureCallback) {
+        pressure(heapIndex, allocInfo.allocationSize);
+        result = vkAllocateMemory(device, &allocInfo, hostAllocationCallbacks, &memory);
+    }
+    if (result != VK_SUCCESS) {
+        std::cerr << "allocating " << allocInfo.allocationSize << " bytes of " << memoryCategoryName(category) << " memory failed:\n";
+        report();
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+
+    CategoryCounters& counters = categories[int(category)];
+    VkDeviceSize bytes = counters.bytes.fetch_add(allocInfo.allocationSize, std::memory_order_relaxed) + allocInfo.allocationSize;
+    counters.count.fetch_add(1, std::memory_order_relaxed);
+
+    VkDeviceSize peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while (bytes > peak && !counters.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {}
+
+    if (knownType) {
+        heaps[heapIndex].sinceUpdate.fetch_add(static_cast<int64_t>(allocInfo.allocationSize), std::memory_order_relaxed);
+        heaps[heapIndex].tracked.fetch_add(allocInfo.allocationSize, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(allocationsMutex);
+    allocations[memory] = { allocInfo.allocationSize, category, knownType ? heapIndex : UINT32_MAX };
+    return memory;
+}
+
+void MemoryBudget::free(VkDeviceMemory memory) {
+    if (memory == VK_NULL_HANDLE) return;
+
+    Allocation allocation{};
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(allocationsMutex);
+        auto entry = allocations.find(memory);
+        if (entry != allocations.end()) {
+            allocation = entry->second;
+            allocations.erase(entry);
+            found = true;
+        }
+    }
+
+    vkFreeMemory(device, memory, hostAllocationCallbacks);
+    if (!found) return;
+
+    categories[int(allocation.category)].bytes.fetch_sub(allocation.size, std::memory_order_relaxed);
+    categories[int(allocation.category)].count.fetch_sub(1, std::memory_order_relaxed);
+    if (allocation.heapIndex != UINT32_MAX) {
+        heaps[allocation.heapIndex].sinceUpdate.fetch_sub(static_cast<int64_t>(allocation.size), std::memory_order_relaxed);
+        heaps[allocation.heapIndex].tracked.fetch_sub(allocation.size, std::memory_order_relaxed);
+    }
+}
+
+void MemoryBudget::update() {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    if (budgetExtension) {
+        VkPhysicalDeviceMemoryProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties2.pNext = &budgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+    }
+
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        HeapCounters& heap = heaps[i];
+
+        // The driver's usage covers everything up to now, so the running delta starts over
+        if (budgetExtension) {
+            heap.budget.store(budgetProperties.heapBudget[i], std::memory_order_relaxed);
+            heap.usage.store(budgetProperties.heapUsage[i], std::memory_order_relaxed);
+            heap.sinceUpdate.store(0, std::memory_order_relaxed);
+        }
+        else {
+            heap.budget.store(static_cast<VkDeviceSize>(memoryProperties.memoryHeaps[i].size * MEMORY_BUDGET_FALLBACK_FRACTION),
+                std::memory_order_relaxed);
+            heap.usage.store(0, std::memory_order_relaxed);
+        }
+
+        MemoryHeapStats stats = heapStats(i);
+        bool over = stats.usage > stats.budget * MEMORY_PRESSURE_THRESHOLD;
+        if (over && !heap.overThreshold) {
+            pressure(i, 0);
+        }
+        heap.overThreshold = over;
+    }
+}
+
+MemoryHeapStats MemoryBudget::heapStats(uint32_t heapIndex) const {
+    const HeapCounters& heap = heaps[heapIndex];
+
+    // Without the extension usage is only what we track, which sinceUpdate never resets
+    int64_t usage = static_cast<int64_t>(heap.usage.load(std::memory_order_relaxed)) + heap.sinceUpdate.load(std::memory_order_relaxed);
+
+    MemoryHeapStats stats{};
+    stats.size = memoryProperties.memoryHeaps[heapIndex].size;
+    stats.budget = heap.budget.load(std::memory_order_relaxed);
+    stats.usage = usage > 0 ? static_cast<VkDeviceSize>(usage) : 0;
+    stats.tracked = heap.tracked.load(std::memory_order_relaxed);
+    stats.deviceLocal = (memoryProperties.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    return stats;
+}
+
+void MemoryBudget::pressure(uint32_t heapIndex, VkDeviceSize requested) {
+    if (pressureCallback) {
+        pressureCallback(heapIndex, heapStats(heapIndex), requested);
+    }
+}
+
+void MemoryBudget::report() const {
+    const double MiB = 1024.0 * 1024.0;
+    char line[160];
+
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        MemoryHeapStats stats = heapStats(i);
+        snprintf(line, sizeof(line), "Memory heap %u%s: %.1f of %.1f MiB budget (%.1f MiB tracked, heap %.1f MiB)\n",
+            i, stats.deviceLocal ? " (device local)" : "", stats.usage / MiB, stats.budget / MiB, stats.tracked / MiB, stats.size / MiB);
+        std::cout << line;
+    }
+    for (int i = 0; i < int(MemoryCategory::Count); i++) {
+        const CategoryCounters& counters = categories[i];
+        snprintf(line, sizeof(line), "  %-10s %8.2f MiB in %u allocations, peak %.2f MiB\n", memoryCategoryName(MemoryCategory(i)),
+            counters.bytes.load() / MiB, counters.count.load(), counters.peakBytes.load() / MiB);
+        std::cout << line;
+    }
+}
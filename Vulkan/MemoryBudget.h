@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+// Fraction of a heap's budget past which the pressure callback runs
+#define MEMORY_PRESSURE_THRESHOLD 0.9
+
+// Without VK_EXT_memory_budget, the fraction of each heap assumed to be ours
+#define MEMORY_BUDGET_FALLBACK_FRACTION 0.8
+
+// What a device memory allocation holds, for accounting
+enum class MemoryCategory { Vertex, Index, Texture, Attachment, Staging, Uniform, Readback, Other, Count };
+
+const char* memoryCategoryName(MemoryCategory category);
+
+struct MemoryHeapStats {
+    VkDeviceSize size;       // the whole heap
+    VkDeviceSize budget;     // how much this process can use before it risks failures or paging
+    VkDeviceSize usage;      // this process's usage, including allocations made since the last update()
+    VkDeviceSize tracked;    // the part of usage that went through MemoryBudget::allocate()
+    bool deviceLocal;
+};
+
+// Residency policy hook. Runs when a heap's usage crosses MEMORY_PRESSURE_THRESHOLD of its budget
+// (requested 0, from update()), and before an allocation that would take a heap past its budget or
+// that the driver has just refused (requested is its size, on the allocating thread). Whatever it
+// frees or demotes is taken into account when the allocation is attempted after it returns.
+using MemoryPressureCallback = void (*)(uint32_t heapIndex, const MemoryHeapStats& heap, VkDeviceSize requested);
+
+// Accounts for every device memory allocation by category and heap, and keeps each heap's budget and usage
+// from VK_EXT_memory_budget (or an estimate without it). The counters are atomics that any thread may read;
+// allocate() and free() may be called from any thread.
+class MemoryBudget {
+public:
+    void create(bool budgetExtension);
+
+    // Reports allocations that were never freed
+    void destroy();
+
+    // vkAllocateMemory with accounting; throws if the allocation still fails after the pressure callback
+    VkDeviceMemory allocate(const VkMemoryAllocateInfo& allocInfo, MemoryCategory category);
+    void free(VkDeviceMemory memory);
+
+    // Once per frame: refreshes budgets and usage, and runs the pressure callback for heaps that crossed the threshold
+    void update();
+
+    void setPressureCallback(MemoryPressureCallback callback) { pressureCallback = callback; }
+
+    uint32_t heapCount() const { return memoryProperties.memoryHeapCount; }
+    MemoryHeapStats heapStats(uint32_t heapIndex) const;
+
+    VkDeviceSize categoryBytes(MemoryCategory category) const { return categories[int(category)].bytes.load(std::memory_order_relaxed); }
+    uint32_t categoryAllocations(MemoryCategory category) const { return categories[int(category)].count.load(std::memory_order_relaxed); }
+
+    // Prints every heap's usage against its budget and the bytes in each category
+    void report() const;
+
+private:
+    struct Allocation {
+        VkDeviceSize size;
+        MemoryCategory category;
+        uint32_t heapIndex;
+    };
+
+    struct CategoryCounters {
+        std::atomic<VkDeviceSize> bytes{ 0 };
+        std::atomic<VkDeviceSize> peakBytes{ 0 };
+        std::atomic<uint32_t> count{ 0 };
+    };
+
+    struct HeapCounters {
+        std::atomic<VkDeviceSize> budget{ 0 };
+        std::atomic<VkDeviceSize> usage{ 0 };       // as of the last update()
+        std::atomic<int64_t> sinceUpdate{ 0 };      // allocated minus freed since then
+        std::atomic<VkDeviceSize> tracked{ 0 };
+        bool overThreshold = false;                 // main thread only
+    };
+
+    void pressure(uint32_t heapIndex, VkDeviceSize requested);
+
+    bool budgetExtension = false;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    MemoryPressureCallback pressureCallback = nullptr;
+
+    CategoryCounters categories[int(MemoryCategory::Count)];
+    HeapCounters heaps[VK_MAX_MEMORY_HEAPS];
+
+    std::mutex allocationsMutex;
+    std::unordered_map<VkDeviceMemory, Allocation> allocations;
+};
+
+extern MemoryBudget memoryBudget;
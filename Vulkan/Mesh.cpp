@@ -0,0 +1,393 @@
+#include "Mesh.h"
+#include "JobSystem.h"
+#include "MeshOptimizer.h"
+#include "StagingRing.h"
+
+#include "tiny_obj_loader.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+struct CornerKey {
+    int vertex;
+    int normal;
+    int texcoord;
+
+    bool operator==(const CornerKey& other) const {
+        return vertex == other.vertex && normal == other.normal && texcoord == other.texcoord;
+    }
+};
+
+struct CornerKeyHash {
+    size_t operator()(const CornerKey& key) const {
+        size_t h = std::hash<int>()(key.vertex);
+        h = h * 31 + std::hash<int>()(key.normal);
+        h = h * 31 + std::hash<int>()(key.texcoord);
+        return h;
+    }
+};
+
+void printMeshStatistics(const char* stage, const MeshData& mesh) {
+    const MeshLod& lod = mesh.lods[0];
+    const uint32_t* indices = mesh.indices.data() + lod.indexOffset;
+
+    VertexCacheStatistics cache = analyzeVertexCache(indices, lod.indexCount, mesh.vertices.size());
+    VertexFetchStatistics fetch = analyzeVertexFetch(indices, lod.indexCount, mesh.vertices.size(), sizeof(GpuVertex));
+
+    std::cout << std::fixed << std::setprecision(3)
+        << "  " << std::left << std::setw(14) << stage << std::right
+        << " ACMR " << cache.acmr << "  ATVR " << cache.atvr << "  overfetch " << fetch.overfetch << "\n"
+        << std::defaultfloat;
+}
+
+} // namespace
+
+MeshData loadObjMesh(const std::string& filename) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn;
+    std::string err;
+
+    std::string baseDir = filename.substr(0, filename.find_last_of("/\\") + 1);
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str(), baseDir.c_str())) {
+        throw std::runtime_error("failed to load OBJ file: " + filename + "\n" + err);
+    }
+    if (!warn.empty()) {
+        std::cerr << warn;
+    }
+
+    MeshData mesh;
+    std::unordered_map<CornerKey, uint32_t, CornerKeyHash> uniqueCorners;
+    std::map<int, std::vector<uint32_t>> materialIndices;
+
+    for (const tinyobj::shape_t& shape : shapes) {
+        for (size_t i = 0; i < shape.mesh.indices.size(); i++) {
+            const tinyobj::index_t& index = shape.mesh.indices[i];
+            CornerKey key{ index.vertex_index, index.normal_index, index.texcoord_index };
+
+            auto inserted = uniqueCorners.emplace(key, static_cast<uint32_t>(mesh.vertices.size()));
+            if (inserted.second) {
+                Vertex vertex{};
+                for (int j = 0; j < 3; j++) {
+                    vertex.pos[j] = static_cast<float>(attrib.vertices[3 * index.vertex_index + j]);
+                    vertex.color[j] = static_cast<float>(attrib.colors[3 * index.vertex_index + j]);
+                }
+                if (index.normal_index >= 0) {
+                    for (int j = 0; j < 3; j++) {
+                        vertex.normal[j] = static_cast<float>(attrib.normals[3 * index.normal_index + j]);
+                    }
+                }
+                if (index.texcoord_index >= 0) {
+                    // OBJ puts v = 0 at the bottom of the image, Vulkan at the top
+                    vertex.uv[0] = static_cast<float>(attrib.texcoords[2 * index.texcoord_index + 0]);
+                    vertex.uv[1] = 1.0f - static_cast<float>(attrib.texcoords[2 * index.texcoord_index + 1]);
+                }
+                mesh.vertices.push_back(vertex);
+            }
+
+            // LoadObj triangulates, so every face has three corners
+            materialIndices[shape.mesh.material_ids[i / 3]].push_back(inserted.first->second);
+        }
+    }
+
+    MeshLod lod{};
+    for (const auto& [materialId, indices] : materialIndices) {
+        mesh.subsets.push_back({ materialId, static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(indices.size()) });
+        mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+    }
+    lod.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    lod.subsetCount = static_cast<uint32_t>(mesh.subsets.size());
+    mesh.lods.push_back(lod);
+
+    glm::vec3 minPosition(FLT_MAX);
+    glm::vec3 maxPosition(-FLT_MAX);
+    for (const Vertex& vertex : mesh.vertices) {
+        minPosition = glm::min(minPosition, glm::vec3(vertex.pos[0], vertex.pos[1], vertex.pos[2]));
+        maxPosition = glm::max(maxPosition, glm::vec3(vertex.pos[0], vertex.pos[1], vertex.pos[2]));
+    }
+    if (!mesh.vertices.empty()) {
+        mesh.boundsCenter = (minPosition + maxPosition) * 0.5f;
+        for (const Vertex& vertex : mesh.vertices) {
+            glm::vec3 offset = glm::vec3(vertex.pos[0], vertex.pos[1], vertex.pos[2]) - mesh.boundsCenter;
+            mesh.boundsRadius = std::max(mesh.boundsRadius, glm::length(offset));
+        }
+    }
+
+    for (const tinyobj::material_t& material : materials) {
+        GpuMaterial gpuMaterial;
+        gpuMaterial.diffuse = glm::vec4(material.diffuse[0], material.diffuse[1], material.diffuse[2], material.dissolve);
+        gpuMaterial.specular = glm::vec4(material.specular[0], material.specular[1], material.specular[2], material.shininess);
+        gpuMaterial.emission = glm::vec4(material.emission[0], material.emission[1], material.emission[2], material.ior);
+        mesh.materials.push_back(gpuMaterial);
+    }
+
+    std::cout << "Loaded " << filename << ": " << mesh.vertices.size() << " vertices, "
+        << mesh.indices.size() / 3 << " triangles, " << mesh.subsets.size() << " materials\n";
+
+    return mesh;
+}
+
+void generateMeshLods(MeshData& mesh, uint32_t lodCount) {
+    // Vertices whose position is used by more than one material sit on a material boundary
+    std::vector<unsigned char> vertexLock(mesh.vertices.size(), 0);
+    {
+        std::unordered_map<glm::vec3, int, PositionHash> positionSubset;
+        std::vector<char> shared;
+
+        for (uint32_t s = 0; s < mesh.lods[0].subsetCount; s++) {
+            const MeshSubset& subset = mesh.subsets[mesh.lods[0].firstSubset + s];
+            for (uint32_t i = 0; i < subset.indexCount; i++) {
+                const Vertex& vertex = mesh.vertices[mesh.indices[subset.indexOffset + i]];
+                auto [it, inserted] = positionSubset.emplace(glm::vec3(vertex.pos[0], vertex.pos[1], vertex.pos[2]), int(s));
+                if (!inserted && it->second != int(s)) it->second = -1;
+            }
+        }
+
+        for (size_t v = 0; v < mesh.vertices.size(); v++) {
+            auto it = positionSubset.find(glm::vec3(mesh.vertices[v].pos[0], mesh.vertices[v].pos[1], mesh.vertices[v].pos[2]));
+            vertexLock[v] = it != positionSubset.end() && it->second == -1;
+        }
+    }
+
+    float targetError = mesh.boundsRadius * MESH_LOD_MAX_ERROR;
+
+    // One output buffer and error per subset of LOD 0, so the subsets of a level simplify in parallel
+    uint32_t sourceSubsetCount = mesh.lods[0].subsetCount;
+    std::vector<std::vector<uint32_t>> simplified(sourceSubsetCount);
+    std::vector<float> errors(sourceSubsetCount);
+
+    for (uint32_t level = 1; level < lodCount; level++) {
+        const MeshLod& previous = mesh.lods.back();
+
+        MeshLod lod{};
+        lod.indexOffset = static_cast<uint32_t>(mesh.indices.size());
+        lod.firstSubset = static_cast<uint32_t>(mesh.subsets.size());
+
+        // Always simplified from LOD 0, so the reported error is measured against the original
+        jobSystem.parallelFor(sourceSubsetCount, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t s = begin; s < end; s++) {
+                const MeshSubset& source = mesh.subsets[mesh.lods[0].firstSubset + s];
+
+                size_t targetIndexCount = size_t(source.indexCount >> level) / 3 * 3;
+                simplified[s].resize(source.indexCount);
+
+                errors[s] = 0.0f;
+                size_t indexCount = simplifyMesh(simplified[s].data(), mesh.indices.data() + source.indexOffset, source.indexCount,
+                    mesh.vertices[0].pos, mesh.vertices.size(), sizeof(Vertex),
+                    targetIndexCount, targetError, vertexLock.data(), &errors[s]);
+                simplified[s].resize(indexCount);
+            }
+        });
+
+        // Appended in subset order, so the result doesn't depend on which job finished first
+        for (uint32_t s = 0; s < sourceSubsetCount; s++) {
+            const MeshSubset& source = mesh.subsets[mesh.lods[0].firstSubset + s];
+            mesh.subsets.push_back({ source.materialId, static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(simplified[s].size()) });
+            mesh.indices.insert(mesh.indices.end(), simplified[s].begin(), simplified[s].end());
+            lod.error = std::max(lod.error, errors[s]);
+        }
+
+        lod.indexCount = static_cast<uint32_t>(mesh.indices.size()) - lod.indexOffset;
+        lod.subsetCount = static_cast<uint32_t>(mesh.subsets.size()) - lod.firstSubset;
+        lod.error = std::max(lod.error, previous.error);
+
+        // Not worth a level of its own: the error bound or the locked vertices stopped the simplifier
+        if (lod.indexCount == 0 || lod.indexCount > previous.indexCount - previous.indexCount / 8) {
+            mesh.indices.resize(lod.indexOffset);
+            mesh.subsets.resize(lod.firstSubset);
+            break;
+        }
+
+        mesh.lods.push_back(lod);
+    }
+
+    std::cout << "Generated " << mesh.lods.size() << " LODs:";
+    for (const MeshLod& lod : mesh.lods) {
+        std::cout << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+    }
+    std::cout << "\n";
+}
+
+void optimizeMesh(MeshData& mesh) {
+    // Nothing to reorder, and no first vertex to take the positions from
+    if (mesh.vertices.empty() || mesh.lods.empty()) return;
+
+    std::cout << "Optimizing mesh (" << VERTEX_CACHE_SIZE << " entry FIFO cache):\n";
+    printMeshStatistics("input", mesh);
+
+    // Triangles never cross a subset boundary, so every LOD keeps its material ranges
+    // and the subsets can be optimized in parallel
+    uint32_t subsetCount = static_cast<uint32_t>(mesh.subsets.size());
+    jobSystem.parallelFor(subsetCount, 1, [&mesh](uint32_t begin, uint32_t end) {
+        for (uint32_t s = begin; s < end; s++) {
+            uint32_t* indices = mesh.indices.data() + mesh.subsets[s].indexOffset;
+            optimizeVertexCache(indices, indices, mesh.subsets[s].indexCount, mesh.vertices.size());
+        }
+    });
+    printMeshStatistics("vertex cache", mesh);
+
+    jobSystem.parallelFor(subsetCount, 1, [&mesh](uint32_t begin, uint32_t end) {
+        for (uint32_t s = begin; s < end; s++) {
+            uint32_t* indices = mesh.indices.data() + mesh.subsets[s].indexOffset;
+            optimizeOverdraw(indices, indices, mesh.subsets[s].indexCount, mesh.vertices[0].pos, mesh.vertices.size(), sizeof(Vertex));
+        }
+    });
+    printMeshStatistics("overdraw", mesh);
+
+    optimizeVertexFetch(mesh.vertices, mesh.indices.data(), mesh.indices.size());
+    printMeshStatistics("vertex fetch", mesh);
+}
+
+std::vector<GpuVertex> packMeshVertices(const MeshData& mesh, VertexQuantization& quantization) {
+    glm::vec3 minPosition(FLT_MAX);
+    glm::vec3 maxPosition(-FLT_MAX);
+    for (const Vertex& vertex : mesh.vertices) {
+        minPosition = glm::min(minPosition, glm::vec3(vertex.pos[0], vertex.pos[1], vertex.pos[2]));
+        maxPosition = glm::max(maxPosition, glm::vec3(vertex.pos[0], vertex.pos[1], vertex.pos[2]));
+    }
+    quantization = computeVertexQuantization(minPosition, maxPosition);
+
+    std::vector<GpuVertex> gpuVertices(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        gpuVertices[i] = toGpuVertex(mesh.vertices[i], quantization);
+    }
+    return gpuVertices;
+}
+
+GpuMesh createGpuMesh(const MeshData& mesh, const VertexQuantization& quantization) {
+    if (mesh.vertices.empty() || mesh.indices.empty()) {
+        throw std::runtime_error("cannot upload an empty mesh!");
+    }
+
+    GpuMesh gpuMesh{};
+
+    createBuffer(sizeof(GpuVertex) * mesh.vertices.size(),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        gpuMesh.vertexBuffer,
+        gpuMesh.vertexBufferMemory,
+        MemoryCategory::Vertex);
+
+    createBuffer(sizeof(uint32_t) * mesh.indices.size(),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        gpuMesh.indexBuffer,
+        gpuMesh.indexBufferMemory,
+        MemoryCategory::Index);
+
+    gpuMesh.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    gpuMesh.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    gpuMesh.lods = mesh.lods;
+    gpuMesh.subsets = mesh.subsets;
+
+    // Grown by one quantization step, so the boxes still hold the decoded positions
+    glm::vec3 padding = quantization.scale / 65535.0f;
+    for (MeshSubset& subset : gpuMesh.subsets) {
+        glm::vec3 minPosition(FLT_MAX);
+        glm::vec3 maxPosition(-FLT_MAX);
+        for (uint32_t i = 0; i < subset.indexCount; i++) {
+            const Vertex& vertex = mesh.vertices[mesh.indices[subset.indexOffset + i]];
+            glm::vec3 position(vertex.pos[0], vertex.pos[1], vertex.pos[2]);
+            minPosition = glm::min(minPosition, position);
+            maxPosition = glm::max(maxPosition, position);
+        }
+        if (subset.indexCount > 0) {
+            subset.boundsMin = minPosition - padding;
+            subset.boundsMax = maxPosition + padding;
+        }
+    }
+
+    // The occluder: opaque triangles of the coarsest LOD
+    const MeshLod& coarsest = mesh.lods.back();
+    std::vector<uint32_t> occluderRemap(mesh.vertices.size(), UINT32_MAX);
+    for (uint32_t s = 0; s < coarsest.subsetCount; s++) {
+        const MeshSubset& subset = mesh.subsets[coarsest.firstSubset + s];
+        bool translucent = subset.materialId >= 0 && size_t(subset.materialId) < mesh.materials.size() &&
+            mesh.materials[subset.materialId].diffuse.a < 1.0f;
+        if (translucent) continue;
+
+        for (uint32_t i = 0; i < subset.indexCount; i++) {
+            uint32_t vertex = mesh.indices[subset.indexOffset + i];
+            if (occluderRemap[vertex] == UINT32_MAX) {
+                occluderRemap[vertex] = static_cast<uint32_t>(gpuMesh.occluderPositions.size());
+                gpuMesh.occluderPositions.emplace_back(mesh.vertices[vertex].pos[0], mesh.vertices[vertex].pos[1], mesh.vertices[vertex].pos[2]);
+            }
+            gpuMesh.occluderIndices.push_back(occluderRemap[vertex]);
+        }
+    }
+    gpuMesh.occluderError = coarsest.error;
+    if (gpuMesh.occluderIndices.size() / 3 > MESH_OCCLUDER_MAX_TRIANGLES) {
+        gpuMesh.occluderPositions = {};
+        gpuMesh.occluderIndices = {};
+    }
+
+    gpuMesh.boundsCenter = mesh.boundsCenter;
+    gpuMesh.boundsRadius = mesh.boundsRadius;
+    gpuMesh.quantization = quantization;
+    return gpuMesh;
+}
+
+void assignMeshMaterials(GpuMesh& gpuMesh, const MeshData& mesh, MaterialTable& materialTable) {
+    for (MeshSubset& subset : gpuMesh.subsets) {
+        bool hasMaterial = subset.materialId >= 0 && size_t(subset.materialId) < mesh.materials.size();
+        subset.materialIndex = hasMaterial ? materialTable.add(mesh.materials[subset.materialId]) : 0;
+    }
+}
+
+GpuMesh uploadMesh(const MeshData& mesh, MaterialTable& materialTable) {
+    VertexQuantization quantization;
+    std::vector<GpuVertex> gpuVertices = packMeshVertices(mesh, quantization);
+    GpuMesh gpuMesh = createGpuMesh(mesh, quantization);
+
+    VkDeviceSize vertexBytes = sizeof(GpuVertex) * gpuVertices.size();
+    VkDeviceSize indexBytes = sizeof(uint32_t) * mesh.indices.size();
+    {
+        StagingRing ring(std::min<VkDeviceSize>(vertexBytes + indexBytes, 16 * 1024 * 1024));
+        ring.write(gpuMesh.vertexBuffer, 0, gpuVertices.data(), vertexBytes);
+        ring.write(gpuMesh.indexBuffer, 0, mesh.indices.data(), indexBytes);
+        ring.finish();
+    }
+
+    assignMeshMaterials(gpuMesh, mesh, materialTable);
+    return gpuMesh;
+}
+
+uint32_t selectMeshLod(const GpuMesh& mesh, const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj,
+    float viewportHeight, float pixelError) {
+    if (mesh.lods.size() < 2) return 0;
+
+    // Errors are in object space; scale them by the largest axis scale of the model matrix
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    glm::vec4 center = view * model * glm::vec4(mesh.boundsCenter, 1.0f);
+
+    // View space looks down -z; measure from the nearest point of the bounding sphere
+    float depth = -center.z - mesh.boundsRadius * scale;
+    if (depth <= 0.0f) return 0;
+
+    // proj[1][1] is cot(fovy / 2): one unit at this depth covers proj[1][1] / depth of the half-height
+    float pixelsPerUnit = std::abs(proj[1][1]) * 0.5f * viewportHeight / depth;
+
+    uint32_t selected = 0;
+    for (uint32_t i = 1; i < mesh.lods.size(); i++) {
+        if (mesh.lods[i].error * scale * pixelsPerUnit > pixelError) break;
+        selected = i;
+    }
+    return selected;
+}
+
+void destroyGpuMesh(GpuMesh& mesh) {
+    vkDestroyBuffer(device, mesh.indexBuffer, hostAllocationCallbacks);
+    memoryBudget.free(mesh.indexBufferMemory);
+    vkDestroyBuffer(device, mesh.vertexBuffer, hostAllocationCallbacks);
+    memoryBudget.free(mesh.vertexBufferMemory);
+    mesh = GpuMesh{};
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "VulkanCore.h"
+#include "Material.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Levels generated by generateMeshLods, LOD 0 included
+#define MESH_LOD_COUNT 4
+
+// Largest deviation a LOD may introduce, as a fraction of the mesh bounding radius
+#define MESH_LOD_MAX_ERROR 0.05f
+
+// Projected error, in pixels, below which a coarser LOD is drawn instead
+#define MESH_LOD_PIXEL_ERROR 1.0f
+
+// Occluders are only kept for meshes whose coarsest LOD has at most this many opaque triangles
+#define MESH_OCCLUDER_MAX_TRIANGLES 16384
+
+// Triangles of one material within one LOD
+struct MeshSubset {
+    int materialId = -1;          // into MeshData::materials, -1 for none
+    uint32_t indexOffset = 0;
+    uint32_t indexCount = 0;
+    uint32_t materialIndex = 0;   // into the MaterialTable, set by uploadMesh
+    glm::vec3 boundsMin = glm::vec3(0.0f);   // object-space box of the triangles, set by createGpuMesh
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+// One level of detail: a contiguous range of the shared index buffer, split into subsets.
+// Every LOD indexes the same vertex buffer.
+struct MeshLod {
+    uint32_t indexOffset = 0;
+    uint32_t indexCount = 0;
+    uint32_t firstSubset = 0;
+    uint32_t subsetCount = 0;
+    float error = 0.0f;   // object-space distance from LOD 0
+};
+
+// Device-local geometry, drawn with vkCmdDrawIndexed
+struct GpuMesh {
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+
+    std::vector<MeshLod> lods;
+    std::vector<MeshSubset> subsets;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+
+    // Decodes the vertex positions, goes into ObjectUniforms with every draw
+    VertexQuantization quantization;
+
+    // Low-poly stand-in for the opaque subsets, for software occlusion culling: the coarsest LOD with only the
+    // vertices it uses, in object space. Empty when that LOD is too big, or the mesh was streamed.
+    std::vector<glm::vec3> occluderPositions;
+    std::vector<uint32_t> occluderIndices;
+    float occluderError = 0.0f;   // object-space distance from LOD 0, the error of the coarsest LOD
+};
+
+// Indexed triangle list on the CPU
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<GpuMaterial> materials;
+
+    std::vector<MeshLod> lods;
+    std::vector<MeshSubset> subsets;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+};
+
+// Loads an OBJ with tinyobj::LoadObj and builds an index buffer from it.
+// Face corners are welded only when their position, normal and texcoord indices all match, so seams survive.
+// Triangles are grouped by material into the subsets of LOD 0, and the MTL materials are kept alongside.
+MeshData loadObjMesh(const std::string& filename);
+
+// Appends up to lodCount - 1 simplified levels after LOD 0, each roughly halving the triangle count.
+// Every subset is simplified on its own with the vertices it shares with other materials locked,
+// so material boundaries and UV/normal seams stay intact. Stops early once a level no longer shrinks.
+void generateMeshLods(MeshData& mesh, uint32_t lodCount = MESH_LOD_COUNT);
+
+// Reorders every subset for the vertex cache, then for overdraw, then the vertices for fetch,
+// printing the ACMR/ATVR of LOD 0 after each stage
+void optimizeMesh(MeshData& mesh);
+
+// Picks the coarsest LOD whose error, projected at the near side of the bounding sphere, stays within pixelError
+uint32_t selectMeshLod(const GpuMesh& mesh, const glm::mat4& model, const glm::mat4& view, const glm::mat4& proj,
+    float viewportHeight, float pixelError = MESH_LOD_PIXEL_ERROR);
+
+// Converts the vertices to GpuVertex, quantized against the mesh bounds. Touches no Vulkan state.
+std::vector<GpuVertex> packMeshVertices(const MeshData& mesh, VertexQuantization& quantization);
+
+// Creates empty device-local vertex and index buffers sized for mesh and fills in everything
+// but the material indices, including the subset boxes and the occluder. Safe on any thread.
+GpuMesh createGpuMesh(const MeshData& mesh, const VertexQuantization& quantization);
+
+// Adds the materials of mesh to materialTable and points the subsets of gpuMesh at them
+void assignMeshMaterials(GpuMesh& gpuMesh, const MeshData& mesh, MaterialTable& materialTable);
+
+// packMeshVertices + createGpuMesh + a blocking copy through a staging ring + assignMeshMaterials.
+// The caller uploads materialTable once all meshes are in.
+GpuMesh uploadMesh(const MeshData& mesh, MaterialTable& materialTable);
+
+void destroyGpuMesh(GpuMesh& mesh);
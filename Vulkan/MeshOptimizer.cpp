@@ -0,0 +1,671 @@
+#include "MeshOptimizer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Triangles using each vertex, as offset/count ranges into one flat array
+struct TriangleAdjacency {
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+};
+
+void buildTriangleAdjacency(TriangleAdjacency& adjacency, const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    size_t faceCount = indexCount / 3;
+
+    adjacency.counts.assign(vertexCount, 0);
+    adjacency.offsets.resize(vertexCount);
+    adjacency.triangles.resize(faceCount * 3);
+
+    for (size_t i = 0; i < faceCount * 3; i++) {
+        adjacency.counts[indices[i]]++;
+    }
+
+    uint32_t offset = 0;
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacency.offsets[v] = offset;
+        offset += adjacency.counts[v];
+    }
+
+    // offsets are advanced while filling and rewound afterwards
+    for (size_t i = 0; i < faceCount * 3; i++) {
+        adjacency.triangles[adjacency.offsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacency.offsets[v] -= adjacency.counts[v];
+    }
+}
+
+// FIFO cache modelled with timestamps: a vertex is resident while fewer than cacheSize
+// other vertices have been transformed since it was
+struct FifoCache {
+    std::vector<uint32_t> timestamps;
+    uint32_t timestamp;
+    uint32_t size;
+
+    FifoCache(size_t vertexCount, uint32_t cacheSize)
+        : timestamps(vertexCount, 0), timestamp(cacheSize + 1), size(cacheSize) {
+    }
+
+    // Returns true on a miss
+    bool access(uint32_t vertex) {
+        if (timestamp - timestamps[vertex] > size) {
+            timestamps[vertex] = timestamp++;
+            return true;
+        }
+        return false;
+    }
+
+    void flush() {
+        timestamp += size + 1;
+    }
+};
+
+// Sum of squared distances to a set of weighted planes, as the symmetric matrix A, vector b and scalar c
+// of v^T A v + 2 b.v + c. weight is kept so the error can be reported as an average distance.
+struct Quadric {
+    float a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+    float b0 = 0, b1 = 0, b2 = 0;
+    float c = 0;
+    float weight = 0;
+};
+
+void quadricAddPlane(Quadric& q, glm::vec3 n, float d, float weight) {
+    q.a00 += n.x * n.x * weight;
+    q.a11 += n.y * n.y * weight;
+    q.a22 += n.z * n.z * weight;
+    q.a01 += n.x * n.y * weight;
+    q.a02 += n.x * n.z * weight;
+    q.a12 += n.y * n.z * weight;
+    q.b0 += n.x * d * weight;
+    q.b1 += n.y * d * weight;
+    q.b2 += n.z * d * weight;
+    q.c += d * d * weight;
+    q.weight += weight;
+}
+
+void quadricAdd(Quadric& q, const Quadric& other) {
+    q.a00 += other.a00;
+    q.a11 += other.a11;
+    q.a22 += other.a22;
+    q.a01 += other.a01;
+    q.a02 += other.a02;
+    q.a12 += other.a12;
+    q.b0 += other.b0;
+    q.b1 += other.b1;
+    q.b2 += other.b2;
+    q.c += other.c;
+    q.weight += other.weight;
+}
+
+// Mean squared distance from p to the planes
+float quadricError(const Quadric& q, glm::vec3 p) {
+    float rx = q.a00 * p.x + q.a01 * p.y + q.a02 * p.z + 2.0f * q.b0;
+    float ry = q.a01 * p.x + q.a11 * p.y + q.a12 * p.z + 2.0f * q.b1;
+    float rz = q.a02 * p.x + q.a12 * p.y + q.a22 * p.z + 2.0f * q.b2;
+    float error = p.x * rx + p.y * ry + p.z * rz + q.c;
+    return q.weight > 0.0f ? std::fabs(error) / q.weight : 0.0f;
+}
+
+enum class VertexKind : unsigned char { Manifold, Border, Locked };
+
+// Open border edges are weighted well above faces so the outline survives simplification
+#define SIMPLIFY_BORDER_WEIGHT 10.0f
+
+// Seams only have to keep their shape in the texture or normals, so they are weighted like faces
+#define SIMPLIFY_SEAM_WEIGHT 1.0f
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    float error;
+};
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+} // namespace
+
+VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStatistics stats{};
+    FifoCache cache(vertexCount, cacheSize);
+
+    for (size_t i = 0; i < indexCount; i++) {
+        if (cache.access(indices[i])) stats.verticesTransformed++;
+    }
+
+    size_t faceCount = indexCount / 3;
+    stats.acmr = faceCount == 0 ? 0.0f : float(stats.verticesTransformed) / float(faceCount);
+    stats.atvr = vertexCount == 0 ? 0.0f : float(stats.verticesTransformed) / float(vertexCount);
+    return stats;
+}
+
+VertexFetchStatistics analyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t vertexSize) {
+    const size_t lineSize = 64;
+    const size_t lineCount = 256;   // 16 KB, roughly one shader core's vertex fetch cache
+
+    VertexFetchStatistics stats{};
+    std::vector<uint64_t> tags(lineCount, ~0ull);
+
+    for (size_t i = 0; i < indexCount; i++) {
+        uint64_t begin = uint64_t(indices[i]) * vertexSize;
+        uint64_t end = begin + vertexSize;
+
+        for (uint64_t line = begin / lineSize; line <= (end - 1) / lineSize; line++) {
+            uint64_t& tag = tags[line % lineCount];
+            if (tag != line) {
+                tag = line;
+                stats.bytesFetched += lineSize;
+            }
+        }
+    }
+
+    size_t bufferSize = vertexCount * vertexSize;
+    stats.overfetch = bufferSize == 0 ? 0.0f : float(double(stats.bytesFetched) / double(bufferSize));
+    return stats;
+}
+
+void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+    size_t faceCount = indexCount / 3;
+    if (faceCount == 0) return;
+
+    // Work from a copy when optimizing in place
+    std::vector<uint32_t> source;
+    if (destination == indices) {
+        source.assign(indices, indices + faceCount * 3);
+        indices = source.data();
+    }
+
+    TriangleAdjacency adjacency;
+    buildTriangleAdjacency(adjacency, indices, indexCount, vertexCount);
+
+    std::vector<uint32_t> liveTriangles = adjacency.counts;
+    std::vector<char> emitted(faceCount, 0);
+    std::vector<uint32_t> deadEnd;
+    deadEnd.reserve(faceCount * 3);
+
+    FifoCache cache(vertexCount, cacheSize);
+
+    uint32_t cursor = 0;                    // next vertex to try once the dead-end stack runs dry
+    uint32_t fanningVertex = indices[0];
+    size_t written = 0;
+
+    while (fanningVertex != ~0u) {
+        size_t candidatesBegin = deadEnd.size();
+
+        // Emit every remaining triangle around the fanning vertex
+        const uint32_t* fan = &adjacency.triangles[adjacency.offsets[fanningVertex]];
+        for (uint32_t i = 0; i < adjacency.counts[fanningVertex]; i++) {
+            uint32_t triangle = fan[i];
+            if (emitted[triangle]) continue;
+
+            for (int corner = 0; corner < 3; corner++) {
+                uint32_t v = indices[triangle * 3 + corner];
+                destination[written++] = v;
+                deadEnd.push_back(v);
+                liveTriangles[v]--;
+                cache.access(v);
+            }
+            emitted[triangle] = 1;
+        }
+
+        // Next fan: the oldest vertex that is still cached and stays cached after its own fan is emitted
+        uint32_t best = ~0u;
+        int bestPriority = -1;
+        for (size_t i = candidatesBegin; i < deadEnd.size(); i++) {
+            uint32_t v = deadEnd[i];
+            if (liveTriangles[v] == 0) continue;
+
+            int priority = 0;
+            uint32_t age = cache.timestamp - cache.timestamps[v];
+            if (age + 2 * liveTriangles[v] <= cacheSize) {
+                priority = int(age);
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        if (best == ~0u) {
+            // Dead end: back up to a recently used vertex, or fall back to input order
+            while (!deadEnd.empty()) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0) {
+                    best = v;
+                    break;
+                }
+            }
+            while (best == ~0u && cursor < vertexCount) {
+                if (liveTriangles[cursor] > 0) best = cursor;
+                cursor++;
+            }
+        }
+
+        fanningVertex = best;
+    }
+}
+
+void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+    const float* positions, size_t vertexCount, size_t positionStride, float threshold, uint32_t cacheSize) {
+    size_t faceCount = indexCount / 3;
+    if (faceCount == 0) return;
+
+    std::vector<uint32_t> source;
+    if (destination == indices) {
+        source.assign(indices, indices + faceCount * 3);
+        indices = source.data();
+    }
+
+    auto position = [&](uint32_t v) {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * positionStride);
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // Hard boundaries: triangles where the cache starts from scratch anyway
+    std::vector<uint32_t> hardClusters;
+    {
+        FifoCache cache(vertexCount, cacheSize);
+        for (size_t t = 0; t < faceCount; t++) {
+            int misses = cache.access(indices[t * 3 + 0]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+            if (t == 0 || misses == 3) hardClusters.push_back(static_cast<uint32_t>(t));
+        }
+    }
+    hardClusters.push_back(static_cast<uint32_t>(faceCount));
+
+    // Soft boundaries: end a cluster as soon as its own ACMR is within threshold of the hard cluster's
+    std::vector<uint32_t> clusters;
+    {
+        FifoCache cache(vertexCount, cacheSize);
+        for (size_t c = 0; c + 1 < hardClusters.size(); c++) {
+            uint32_t begin = hardClusters[c];
+            uint32_t end = hardClusters[c + 1];
+
+            cache.flush();
+            uint32_t misses = 0;
+            for (uint32_t t = begin; t < end; t++) {
+                for (int corner = 0; corner < 3; corner++) misses += cache.access(indices[t * 3 + corner]);
+            }
+            float targetAcmr = float(misses) / float(end - begin) * threshold;
+
+            cache.flush();
+            clusters.push_back(begin);
+            uint32_t clusterBegin = begin;
+            misses = 0;
+            for (uint32_t t = begin; t < end; t++) {
+                for (int corner = 0; corner < 3; corner++) misses += cache.access(indices[t * 3 + corner]);
+
+                if (t + 1 < end && float(misses) / float(t + 1 - clusterBegin) <= targetAcmr) {
+                    // Later clusters start with a cold cache once they are reordered
+                    cache.flush();
+                    clusters.push_back(t + 1);
+                    clusterBegin = t + 1;
+                    misses = 0;
+                }
+            }
+        }
+    }
+    clusters.push_back(static_cast<uint32_t>(faceCount));
+
+    // Area weighted centroid and normal per cluster
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; c++) {
+        float clusterArea = 0.0f;
+        for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            glm::vec3 p0 = position(indices[t * 3 + 0]);
+            glm::vec3 p1 = position(indices[t * 3 + 1]);
+            glm::vec3 p2 = position(indices[t * 3 + 2]);
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(normal);
+
+            clusterCentroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+            clusterNormals[c] += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += clusterCentroids[c];
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f) clusterCentroids[c] /= clusterArea;
+    }
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+    // Clusters facing away from the centre are the likely occluders, so they go first
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        float length = glm::length(clusterNormals[c]);
+        sortKeys[c] = length > 0.0f ? glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / length) : 0.0f;
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) order[c] = static_cast<uint32_t>(c);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    size_t written = 0;
+    for (uint32_t c : order) {
+        size_t count = (clusters[c + 1] - clusters[c]) * 3;
+        memcpy(destination + written, indices + clusters[c] * 3, count * sizeof(uint32_t));
+        written += count;
+    }
+}
+
+size_t optimizeVertexFetchRemap(std::vector<uint32_t>& remap, uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    remap.assign(vertexCount, ~0u);
+
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t& target = remap[indices[i]];
+        if (target == ~0u) target = next++;
+        indices[i] = target;
+    }
+
+    return next;
+}
+
+size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+    const float* positions, size_t vertexCount, size_t positionStride,
+    size_t targetIndexCount, float targetError, const unsigned char* vertexLock, float* resultError) {
+    size_t faceCount = indexCount / 3;
+    std::vector<uint32_t> result(indices, indices + faceCount * 3);
+
+    if (resultError) *resultError = 0.0f;
+
+    auto position = [&](uint32_t v) {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * positionStride);
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // Work in a unit box so the float quadrics behave the same for any mesh scale
+    glm::vec3 minPosition(FLT_MAX);
+    glm::vec3 maxPosition(-FLT_MAX);
+    for (uint32_t index : result) {
+        minPosition = glm::min(minPosition, position(index));
+        maxPosition = glm::max(maxPosition, position(index));
+    }
+    glm::vec3 size = maxPosition - minPosition;
+    float extent = std::max(size.x, std::max(size.y, size.z));
+    float scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+
+    std::vector<glm::vec3> scaled(vertexCount);
+    for (uint32_t index : result) {
+        scaled[index] = (position(index) - minPosition) * scale;
+    }
+
+    // Vertices with equal positions are wedges of one point, split by a UV or normal seam. wedges links the
+    // wedges of each point in a cycle, and canonical names the first of them.
+    std::vector<uint32_t> canonical(vertexCount, ~0u);
+    std::vector<uint32_t> wedges(vertexCount, ~0u);
+    {
+        std::unordered_map<glm::vec3, uint32_t, PositionHash> firstVertex;
+
+        for (uint32_t index : result) {
+            if (canonical[index] != ~0u) continue;
+            auto [it, inserted] = firstVertex.emplace(position(index), index);
+            canonical[index] = it->second;
+            wedges[index] = inserted ? index : wedges[it->second];
+            if (!inserted) wedges[it->second] = index;
+        }
+    }
+
+    // Kinds, quadrics and the touched flags below are kept per point, under its canonical vertex:
+    // every wedge of a point moves together
+    std::vector<VertexKind> kinds(vertexCount, VertexKind::Manifold);
+    if (vertexLock) {
+        for (uint32_t index : result) {
+            if (vertexLock[index]) kinds[canonical[index]] = VertexKind::Locked;
+        }
+    }
+
+    // Edges are matched by position, so a seam edge counts as interior and only open edges are borders.
+    // Matched by vertex as well, a seam edge is the interior edge whose two sides use different wedges.
+    std::unordered_map<uint64_t, uint32_t> edgeCounts;
+    std::unordered_map<uint64_t, uint32_t> wedgeEdgeCounts;
+    edgeCounts.reserve(faceCount * 3);
+    wedgeEdgeCounts.reserve(faceCount * 3);
+    for (size_t i = 0; i < faceCount * 3; i++) {
+        uint32_t a = result[i];
+        uint32_t b = result[i % 3 == 2 ? i - 2 : i + 1];
+        edgeCounts[edgeKey(canonical[a], canonical[b])]++;
+        wedgeEdgeCounts[edgeKey(a, b)]++;
+    }
+
+    auto isBorderEdge = [&](uint32_t a, uint32_t b) {
+        return edgeCounts.find(edgeKey(canonical[a], canonical[b]))->second == 1;
+    };
+    auto isSeamEdge = [&](uint32_t a, uint32_t b) {
+        return edgeCounts.find(edgeKey(canonical[a], canonical[b]))->second == 2 &&
+            wedgeEdgeCounts.find(edgeKey(a, b))->second == 1;
+    };
+
+    for (size_t i = 0; i < faceCount * 3; i++) {
+        uint32_t a = canonical[result[i]];
+        uint32_t b = canonical[result[i % 3 == 2 ? i - 2 : i + 1]];
+        uint32_t count = edgeCounts.find(edgeKey(a, b))->second;
+
+        if (count > 2) {
+            kinds[a] = VertexKind::Locked;
+            kinds[b] = VertexKind::Locked;
+        }
+        else if (count == 1) {
+            if (kinds[a] == VertexKind::Manifold) kinds[a] = VertexKind::Border;
+            if (kinds[b] == VertexKind::Manifold) kinds[b] = VertexKind::Border;
+        }
+    }
+
+    // Face planes weighted by area, plus a plane through each border and seam edge perpendicular to its face,
+    // so that outlines and seams keep their shape
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < faceCount; t++) {
+        uint32_t v[3] = { result[t * 3 + 0], result[t * 3 + 1], result[t * 3 + 2] };
+        glm::vec3 p[3] = { scaled[v[0]], scaled[v[1]], scaled[v[2]] };
+
+        glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        float length = glm::length(normal);
+        if (length == 0.0f) continue;
+        normal /= length;
+
+        for (int corner = 0; corner < 3; corner++) {
+            quadricAddPlane(quadrics[canonical[v[corner]]], normal, -glm::dot(normal, p[0]), length * 0.5f);
+        }
+
+        for (int corner = 0; corner < 3; corner++) {
+            int next = (corner + 1) % 3;
+            float edgeWeight = isBorderEdge(v[corner], v[next]) ? SIMPLIFY_BORDER_WEIGHT :
+                isSeamEdge(v[corner], v[next]) ? SIMPLIFY_SEAM_WEIGHT : 0.0f;
+            if (edgeWeight == 0.0f) continue;
+
+            glm::vec3 edge = p[next] - p[corner];
+            float edgeLength = glm::length(edge);
+            if (edgeLength == 0.0f) continue;
+
+            glm::vec3 edgeNormal = glm::normalize(glm::cross(edge, normal));
+            float weight = edgeLength * edgeLength * edgeWeight;
+            quadricAddPlane(quadrics[canonical[v[corner]]], edgeNormal, -glm::dot(edgeNormal, p[corner]), weight);
+            quadricAddPlane(quadrics[canonical[v[next]]], edgeNormal, -glm::dot(edgeNormal, p[corner]), weight);
+        }
+    }
+
+    // Errors are compared squared, in the unit box
+    float errorLimit = targetError * scale;
+    errorLimit *= errorLimit;
+    float maxError = 0.0f;
+
+    TriangleAdjacency adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<char> touched(vertexCount);
+    std::vector<uint32_t> wedgeTargets;
+
+    // Where each wedge of from goes when from collapses onto to: the one wedge of to it shares triangles with.
+    // A wedge that shares none, or touches several wedges of to, would lose its attributes, so the collapse is
+    // refused; on a seam this only lets a point slide along the seam, each side onto its own wedge.
+    // Fills wedgeTargets with (wedge, target) pairs.
+    auto matchWedges = [&](uint32_t from, uint32_t to) {
+        wedgeTargets.clear();
+        uint32_t wedge = from;
+        do {
+            uint32_t target = ~0u;
+            const uint32_t* fan = &adjacency.triangles[adjacency.offsets[wedge]];
+            for (uint32_t i = 0; i < adjacency.counts[wedge]; i++) {
+                const uint32_t* triangle = &result[fan[i] * 3];
+                for (int corner = 0; corner < 3; corner++) {
+                    if (canonical[triangle[corner]] != canonical[to]) continue;
+                    if (target != ~0u && target != triangle[corner]) return false;
+                    target = triangle[corner];
+                }
+            }
+
+            // Wedges left without triangles by earlier collapses have nothing to carry over
+            if (adjacency.counts[wedge] > 0) {
+                if (target == ~0u) return false;
+                wedgeTargets.push_back(wedge);
+                wedgeTargets.push_back(target);
+            }
+            wedge = wedges[wedge];
+        } while (wedge != from);
+        return true;
+    };
+
+    // Moving from onto to must not flip or badly fold any triangle that survives the collapse
+    auto collapseFlips = [&](uint32_t from, uint32_t to) {
+        uint32_t wedge = from;
+        do {
+            const uint32_t* fan = &adjacency.triangles[adjacency.offsets[wedge]];
+            for (uint32_t i = 0; i < adjacency.counts[wedge]; i++) {
+                const uint32_t* triangle = &result[fan[i] * 3];
+                if (canonical[triangle[0]] == canonical[to] || canonical[triangle[1]] == canonical[to] ||
+                    canonical[triangle[2]] == canonical[to]) continue;
+
+                glm::vec3 p[3];
+                glm::vec3 moved[3];
+                for (int corner = 0; corner < 3; corner++) {
+                    p[corner] = scaled[triangle[corner]];
+                    moved[corner] = canonical[triangle[corner]] == canonical[from] ? scaled[to] : p[corner];
+                }
+
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after)) return true;
+            }
+            wedge = wedges[wedge];
+        } while (wedge != from);
+        return false;
+    };
+
+    // Border vertices may only slide along the border. Collapses reshape the border, so the edge is checked
+    // against the current triangles of every wedge.
+    auto canCollapse = [&](uint32_t from, uint32_t to) {
+        VertexKind kind = kinds[canonical[from]];
+        if (kind == VertexKind::Locked) return false;
+
+        if (kind == VertexKind::Border) {
+            if (kinds[canonical[to]] == VertexKind::Manifold) return false;
+
+            uint32_t sharedTriangles = 0;
+            uint32_t wedge = from;
+            do {
+                const uint32_t* fan = &adjacency.triangles[adjacency.offsets[wedge]];
+                for (uint32_t i = 0; i < adjacency.counts[wedge]; i++) {
+                    const uint32_t* triangle = &result[fan[i] * 3];
+                    for (int corner = 0; corner < 3; corner++) {
+                        if (canonical[triangle[corner]] == canonical[to]) sharedTriangles++;
+                    }
+                }
+                wedge = wedges[wedge];
+            } while (wedge != from);
+            if (sharedTriangles != 1) return false;
+        }
+
+        return matchWedges(from, to);
+    };
+
+    // Each pass collapses a batch of independent edges in order of increasing error
+    while (result.size() > targetIndexCount) {
+        buildTriangleAdjacency(adjacency, result.data(), result.size(), vertexCount);
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i++) {
+            uint32_t a = result[i];
+            uint32_t b = result[i % 3 == 2 ? i - 2 : i + 1];
+            if (canonical[a] == canonical[b]) continue;
+
+            Quadric merged = quadrics[canonical[a]];
+            quadricAdd(merged, quadrics[canonical[b]]);
+
+            Collapse best{ ~0u, ~0u, FLT_MAX };
+            if (canCollapse(a, b)) best = { a, b, quadricError(merged, scaled[b]) };
+            if (canCollapse(b, a)) {
+                float error = quadricError(merged, scaled[a]);
+                if (error < best.error) best = { b, a, error };
+            }
+            if (best.from != ~0u) collapses.push_back(best);
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+        // Every collapse drops about two triangles
+        size_t collapseBudget = (result.size() - targetIndexCount) / 6 + 1;
+        size_t collapsed = 0;
+
+        for (size_t v = 0; v < vertexCount; v++) remap[v] = static_cast<uint32_t>(v);
+        std::fill(touched.begin(), touched.end(), 0);
+
+        for (const Collapse& collapse : collapses) {
+            if (collapse.error > errorLimit || collapsed >= collapseBudget) break;
+            if (touched[canonical[collapse.from]] || touched[canonical[collapse.to]]) continue;
+            if (collapseFlips(collapse.from, collapse.to)) continue;
+
+            // Nothing around from has moved since the candidate was found, so its wedges still match
+            matchWedges(collapse.from, collapse.to);
+            for (size_t i = 0; i < wedgeTargets.size(); i += 2) {
+                remap[wedgeTargets[i]] = wedgeTargets[i + 1];
+            }
+            quadricAdd(quadrics[canonical[collapse.to]], quadrics[canonical[collapse.from]]);
+            maxError = std::max(maxError, collapse.error);
+            collapsed++;
+
+            // The whole fan of the removed point changes shape, so none of it may move again this pass
+            uint32_t wedge = collapse.from;
+            do {
+                const uint32_t* fan = &adjacency.triangles[adjacency.offsets[wedge]];
+                for (uint32_t i = 0; i < adjacency.counts[wedge]; i++) {
+                    for (int corner = 0; corner < 3; corner++) touched[canonical[result[fan[i] * 3 + corner]]] = 1;
+                }
+                wedge = wedges[wedge];
+            } while (wedge != collapse.from);
+        }
+
+        if (collapsed == 0) break;
+
+        size_t written = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            uint32_t a = remap[result[i + 0]];
+            uint32_t b = remap[result[i + 1]];
+            uint32_t c = remap[result[i + 2]];
+            if (a == b || b == c || c == a) continue;
+
+            result[written++] = a;
+            result[written++] = b;
+            result[written++] = c;
+        }
+        result.resize(written);
+    }
+
+    memcpy(destination, result.data(), result.size() * sizeof(uint32_t));
+    if (resultError) *resultError = std::sqrt(maxError) * extent;
+    return result.size();
+}
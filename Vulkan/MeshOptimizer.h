@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Triangle and vertex reordering, and simplification, for indexed triangle lists.
+// Nothing in here touches Vulkan, so the same passes can run at load time or in an offline tool.
+// The usual order is optimizeVertexCache -> optimizeOverdraw -> optimizeVertexFetch.
+
+#define VERTEX_CACHE_SIZE 16
+
+// Hashes the bits of a position, for maps that weld vertices with equal positions. -0 is hashed as +0,
+// which it compares equal to.
+struct PositionHash {
+    size_t operator()(const glm::vec3& p) const {
+        glm::vec3 normalized(p.x == 0.0f ? 0.0f : p.x, p.y == 0.0f ? 0.0f : p.y, p.z == 0.0f ? 0.0f : p.z);
+        uint32_t bits[3];
+        memcpy(bits, &normalized, sizeof(bits));
+        return size_t(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+    }
+};
+
+struct VertexCacheStatistics {
+    uint32_t verticesTransformed = 0;
+    float acmr = 0.0f;   // vertices transformed per triangle (0.5 is ideal, 3 is worst)
+    float atvr = 0.0f;   // vertices transformed per vertex (1 is ideal)
+};
+
+struct VertexFetchStatistics {
+    uint64_t bytesFetched = 0;
+    float overfetch = 0.0f;   // bytes fetched / vertex buffer size (1 is ideal)
+};
+
+// Simulates a FIFO post-transform cache of cacheSize entries
+VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Simulates a small direct-mapped cache of 64 byte lines over the vertex buffer
+VertexFetchStatistics analyzeVertexFetch(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    size_t vertexSize);
+
+// Reorders triangles with Tipsify (Sander et al. 2007) for post-transform cache reuse.
+// destination may be indices itself, to reorder in place.
+void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+    uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Splits the cache-optimized order into clusters at cache flushes, and again wherever a cluster already
+// reaches threshold x its ACMR, then sorts the clusters so outward-facing ones are drawn first.
+// Cache efficiency drops by at most the threshold. positions points at float x, y, z with the given stride.
+void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+    const float* positions, size_t vertexCount, size_t positionStride, float threshold = 1.05f,
+    uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Renumbers vertices in order of first use, so vertex fetch walks the buffer linearly.
+// Rewrites indices in place, fills remap (old index -> new index, ~0u if unused) and returns the new vertex count.
+size_t optimizeVertexFetchRemap(std::vector<uint32_t>& remap, uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Applies optimizeVertexFetchRemap to an array of vertices
+template <typename T>
+void optimizeVertexFetch(std::vector<T>& vertices, uint32_t* indices, size_t indexCount) {
+    std::vector<uint32_t> remap;
+    size_t uniqueVertices = optimizeVertexFetchRemap(remap, indices, indexCount, vertices.size());
+
+    std::vector<T> reordered(uniqueVertices);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        if (remap[i] != ~0u) reordered[remap[i]] = vertices[i];
+    }
+    vertices.swap(reordered);
+}
+
+// Quadric error metric simplification (Garland & Heckbert 1997) by half-edge collapse.
+// Vertices are only ever collapsed onto other existing vertices, so the result indexes the same vertex buffer.
+// Vertices that share a position (wedges, split by a UV or normal seam) collapse together, each onto the wedge
+// of the target on its side of the seam, so seams only collapse along themselves; so do open borders.
+// Non-manifold vertices and vertices flagged in vertexLock never move.
+// Stops at targetIndexCount or when the next collapse would exceed targetError (in position units).
+// Returns the number of indices written to destination; resultError receives the largest error introduced.
+size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+    const float* positions, size_t vertexCount, size_t positionStride,
+    size_t targetIndexCount, float targetError, const unsigned char* vertexLock = nullptr, float* resultError = nullptr);
@@ -0,0 +1,213 @@
+#include "PipelineCompiler.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+static const VkGraphicsPipelineLibraryFlagsEXT partFlags[PIPELINE_PART_COUNT] = {
+    VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT
+};
+
+static const uint32_t partVariantBits[PIPELINE_PART_COUNT] = {
+    PIPELINE_VERTEX_INPUT_VARIANT_BITS,
+    PIPELINE_PRE_RASTERIZATION_VARIANT_BITS,
+    PIPELINE_FRAGMENT_SHADER_VARIANT_BITS,
+    PIPELINE_FRAGMENT_OUTPUT_VARIANT_BITS
+};
+
+void PipelineCompiler::create(PipelineBuilder builder, VkPipelineLayout pipelineLayout, const std::string& path, bool libraries) {
+    build = builder;
+    layout = pipelineLayout;
+    cachePath = path;
+    useLibraries = libraries;
+    loadCache();
+
+    std::cout << "Pipeline compiler using " << (useLibraries ? "graphics pipeline libraries" : "complete pipelines") << "\n";
+}
+
+void PipelineCompiler::destroy() {
+    jobSystem.wait(compileJobs);
+    for (auto& variantParts : parts) {
+        for (LibraryPart& part : variantParts) {
+            jobSystem.wait(part.compileJob);
+        }
+    }
+    saveCache();
+
+    // Linked pipelines first; they may reference the libraries
+    for (uint32_t variant = 0; variant < PIPELINE_VARIANT_COUNT; variant++) {
+        vkDestroyPipeline(device, pipelines[variant].exchange(VK_NULL_HANDLE), hostAllocationCallbacks);
+        vkDestroyPipeline(device, fastLinked[variant], hostAllocationCallbacks);
+        fastLinked[variant] = VK_NULL_HANDLE;
+        requested[variant] = false;
+    }
+    for (auto& variantParts : parts) {
+        for (LibraryPart& part : variantParts) {
+            vkDestroyPipeline(device, part.library.exchange(VK_NULL_HANDLE), hostAllocationCallbacks);
+            part.requested = false;
+        }
+    }
+
+    vkDestroyPipelineCache(device, cache, hostAllocationCallbacks);
+    cache = VK_NULL_HANDLE;
+}
+
+void PipelineCompiler::request(uint32_t variant) {
+    if (requested[variant]) return;
+    requested[variant] = true;
+
+    if (!useLibraries) {
+        jobSystem.run([this, variant] {
+            PROFILE_SCOPE("PipelineCompiler::compile");
+            auto start = std::chrono::steady_clock::now();
+            try {
+                pipelines[variant].store(build(variant, cache, 0), std::memory_order_release);
+            }
+            catch (const std::exception& e) {
+                // Left unpublished, so draws keep using the fallback
+                std::cerr << "failed to compile pipeline variant " << variant << ": " << e.what() << "\n";
+                return;
+            }
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "Pipeline variant " << variant << " compiled in the background (" << elapsed.count() << " ms)\n";
+        }, &compileJobs);
+        return;
+    }
+
+    LibraryPart* variantParts[PIPELINE_PART_COUNT];
+    for (uint32_t part = 0; part < PIPELINE_PART_COUNT; part++) {
+        variantParts[part] = &requestPart(part, variant);
+    }
+
+    // The optimized link waits for the parts while helping to run other jobs
+    jobSystem.run([this, variant, variantParts] {
+        for (LibraryPart* part : variantParts) {
+            jobSystem.wait(part->compileJob);
+        }
+
+        PROFILE_SCOPE("PipelineCompiler::linkOptimized");
+        auto start = std::chrono::steady_clock::now();
+        VkPipeline pipeline = link(variant, true);
+        if (pipeline == VK_NULL_HANDLE) return;
+
+        pipelines[variant].store(pipeline, std::memory_order_release);
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Pipeline variant " << variant << " linked with optimization (" << elapsed.count() << " ms)\n";
+    }, &compileJobs);
+}
+
+PipelineCompiler::LibraryPart& PipelineCompiler::requestPart(uint32_t part, uint32_t variant) {
+    uint32_t partVariant = variant & partVariantBits[part];
+    LibraryPart& library = parts[part][partVariant];
+    if (library.requested) return library;
+    library.requested = true;
+
+    jobSystem.run([this, part, partVariant, &library] {
+        PROFILE_SCOPE("PipelineCompiler::compileLibrary");
+        try {
+            library.library.store(build(partVariant, cache, partFlags[part]), std::memory_order_release);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "failed to compile pipeline library part " << part << " of variant " << partVariant << ": " << e.what() << "\n";
+        }
+    }, &library.compileJob);
+
+    return library;
+}
+
+VkPipeline PipelineCompiler::get(uint32_t variant) {
+    VkPipeline pipeline = pipelines[variant].load(std::memory_order_acquire);
+    if (pipeline != VK_NULL_HANDLE) return pipeline;
+
+    request(variant);
+    if (!useLibraries) return VK_NULL_HANDLE;
+
+    // Until the optimized link lands, a fast link is cheap enough to do in the middle of recording.
+    // It stays alive until destroy(), since command buffers still in flight may use it.
+    if (fastLinked[variant] == VK_NULL_HANDLE) {
+        PROFILE_SCOPE("PipelineCompiler::fastLink");
+        fastLinked[variant] = link(variant, false);
+    }
+    return fastLinked[variant];
+}
+
+// Links the parts of variant, or returns VK_NULL_HANDLE if one is not ready or linking fails
+VkPipeline PipelineCompiler::link(uint32_t variant, bool optimize) {
+    VkPipeline libraries[PIPELINE_PART_COUNT];
+    for (uint32_t part = 0; part < PIPELINE_PART_COUNT; part++) {
+        libraries[part] = parts[part][variant & partVariantBits[part]].library.load(std::memory_order_acquire);
+        if (libraries[part] == VK_NULL_HANDLE) return VK_NULL_HANDLE;
+    }
+
+    VkPipelineLibraryCreateInfoKHR libraryInfo{};
+    libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    libraryInfo.libraryCount = PIPELINE_PART_COUNT;
+    libraryInfo.pLibraries = libraries;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &libraryInfo;
+    pipelineInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+    pipelineInfo.layout = layout;
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device, optimize ? cache : VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocationCallbacks, &pipeline) != VK_SUCCESS) {
+        std::cerr << "failed to link pipeline variant " << variant << "\n";
+        return VK_NULL_HANDLE;
+    }
+    return pipeline;
+}
+
+void PipelineCompiler::loadCache() {
+    std::vector<char> data;
+    std::ifstream file(cachePath, std::ios::binary);
+    if (file) {
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // Drivers should reject a cache from another device or driver themselves, but not all of them do.
+    // The header is: length, version, vendor ID, device ID, then the 16 byte pipeline cache UUID.
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    bool valid = data.size() >= 32;
+    if (valid) {
+        uint32_t header[4];
+        memcpy(header, data.data(), sizeof(header));
+        valid = header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            header[2] == properties.vendorID && header[3] == properties.deviceID &&
+            memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = valid ? data.size() : 0;
+    cacheInfo.pInitialData = valid ? data.data() : nullptr;
+
+    if (vkCreatePipelineCache(device, &cacheInfo, hostAllocationCallbacks, &cache) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+
+    std::cout << "Pipeline cache " << (valid ? "loaded from " + cachePath : std::string("created empty")) << "\n";
+}
+
+void PipelineCompiler::saveCache() {
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) return;
+
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) return;
+
+    std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(size));
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "VulkanCore.h"
+
+#include <atomic>
+#include <string>
+
+// Pipeline variants are bit sets of the flags below, and go into the top 8 bits of a draw's sort key
+#define PIPELINE_VARIANT_BLEND 0x1    // alpha blended without depth writes, for materials with dissolve < 1
+#define PIPELINE_VARIANT_COUNT 256
+
+// The four parts of a graphics pipeline that VK_EXT_graphics_pipeline_library compiles separately
+#define PIPELINE_PART_COUNT 4
+
+// Variant bits each part depends on. Variants that differ only in other bits share the part, so N vertex
+// layouts and M fragment variants compile N + M parts and link N * M pipelines from them.
+#define PIPELINE_VERTEX_INPUT_VARIANT_BITS 0
+#define PIPELINE_PRE_RASTERIZATION_VARIANT_BITS 0
+#define PIPELINE_FRAGMENT_SHADER_VARIANT_BITS PIPELINE_VARIANT_BLEND    // depth writes
+#define PIPELINE_FRAGMENT_OUTPUT_VARIANT_BITS PIPELINE_VARIANT_BLEND    // blend state
+
+// Builds the pipeline of one variant through cache. With parts 0 that is a complete pipeline; otherwise it is a
+// pipeline library holding only the given VkGraphicsPipelineLibraryFlagsEXT parts. Called on worker threads,
+// so it may only touch state that stays fixed while pipelines compile.
+using PipelineBuilder = VkPipeline (*)(uint32_t variant, VkPipelineCache cache, VkGraphicsPipelineLibraryFlagsEXT parts);
+
+// Compiles pipeline variants on worker threads the first time they are asked for, so neither startup nor
+// a first-seen material waits on the driver's compiler. A finished pipeline is published with a single
+// atomic store; until then get() returns VK_NULL_HANDLE and the caller falls back to another variant or
+// skips the draw. Compiles go through one VkPipelineCache, which the driver synchronizes internally,
+// and the cache is saved to disk on destroy() so later runs mostly hit it.
+//
+// With graphics pipeline libraries the four parts of a variant are compiled as libraries instead and shared
+// with every variant that needs the same part. Once a variant's parts are ready, get() fast-links them on the
+// spot, and a background job links them again with link-time optimization, which replaces the fast link.
+class PipelineCompiler {
+public:
+    void create(PipelineBuilder builder, VkPipelineLayout layout, const std::string& cachePath, bool useLibraries);
+
+    // Waits for outstanding compiles, saves the pipeline cache and destroys every pipeline
+    void destroy();
+
+    // Main thread only. Queues a compile of variant unless it has already been requested.
+    void request(uint32_t variant);
+
+    // Main thread only. The best pipeline of variant that is ready, or VK_NULL_HANDLE (after requesting it)
+    // while it is still compiling.
+    VkPipeline get(uint32_t variant);
+
+private:
+    struct LibraryPart {
+        std::atomic<VkPipeline> library{ VK_NULL_HANDLE };
+        bool requested = false;
+        JobCounter compileJob;
+    };
+
+    LibraryPart& requestPart(uint32_t part, uint32_t variant);
+    VkPipeline link(uint32_t variant, bool optimize);
+
+    void loadCache();
+    void saveCache();
+
+    PipelineBuilder build = nullptr;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::string cachePath;
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    bool useLibraries = false;
+
+    std::atomic<VkPipeline> pipelines[PIPELINE_VARIANT_COUNT] = {};   // complete or optimized links
+    VkPipeline fastLinked[PIPELINE_VARIANT_COUNT] = {};
+    bool requested[PIPELINE_VARIANT_COUNT] = {};
+    JobCounter compileJobs;
+
+    LibraryPart parts[PIPELINE_PART_COUNT][PIPELINE_VARIANT_COUNT];
+};
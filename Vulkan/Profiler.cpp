@@ -0,0 +1,86 @@
+#include "Profiler.h"
+
+#if PROFILER_ENABLED
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Registered buffers are kept until exit, so scopes of threads that have already finished still get written
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<ProfileThreadBuffer>> registry;
+
+ProfileThreadBuffer& profilerThreadBuffer() {
+    static thread_local ProfileThreadBuffer* buffer = nullptr;
+    if (buffer) return *buffer;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.push_back(std::make_unique<ProfileThreadBuffer>());
+    buffer = registry.back().get();
+    buffer->threadId = static_cast<uint32_t>(registry.size());
+    snprintf(buffer->threadName, sizeof(buffer->threadName), "Thread %u", buffer->threadId);
+    return *buffer;
+}
+
+void profilerSetThreadName(const char* name) {
+    ProfileThreadBuffer& buffer = profilerThreadBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    snprintf(buffer.threadName, sizeof(buffer.threadName), "%s", name);
+}
+
+// Scope names are identifiers and literals, but keep the JSON valid whatever they hold
+static void writeJsonString(std::ofstream& file, const char* text) {
+    file << '"';
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') file << '\\' << *c;
+        else if (static_cast<unsigned char>(*c) >= 0x20) file << *c;
+    }
+    file << '"';
+}
+
+bool profilerWriteTrace(const std::string& path) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        std::cerr << "failed to open trace file " << path << "\n";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    size_t eventCount = 0;
+    bool first = true;
+    char timing[64];
+
+    file << "{\"traceEvents\":[\n";
+    for (const std::unique_ptr<ProfileThreadBuffer>& buffer : registry) {
+        if (!first) file << ",\n";
+        first = false;
+        file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+        writeJsonString(file, buffer->threadName);
+        file << "}}";
+
+        uint64_t count = buffer->count.load(std::memory_order_acquire);
+        uint64_t begin = count > PROFILER_EVENTS_PER_THREAD ? count - PROFILER_EVENTS_PER_THREAD : 0;
+        for (uint64_t i = begin; i < count; i++) {
+            const ProfileEvent& event = buffer->events[i & (PROFILER_EVENTS_PER_THREAD - 1)];
+
+            // Trace Event timestamps are in microseconds; keep the nanoseconds as decimals
+            snprintf(timing, sizeof(timing), "\"ts\":%.3f,\"dur\":%.3f", event.start / 1000.0, event.duration / 1000.0);
+
+            file << ",\n{\"ph\":\"X\",\"name\":";
+            writeJsonString(file, event.name);
+            file << ",\"pid\":1,\"tid\":" << buffer->threadId << "," << timing << "}";
+        }
+        eventCount += static_cast<size_t>(count - begin);
+    }
+    file << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+    std::cout << "Profiler trace written to " << path << " (" << eventCount << " events)\n";
+    return static_cast<bool>(file);
+}
+
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// CPU profiling. 1 records PROFILE_* scopes and writes them out as a trace; 0 compiles every macro below
+// to nothing. Can be overridden from the build.
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// Most recent scopes each thread keeps; older ones are overwritten (power of two)
+#define PROFILER_EVENTS_PER_THREAD (1 << 17)
+
+// Where PROFILE_WRITE_TRACE output goes by default: Chrome Trace Event JSON, for chrome://tracing or ui.perfetto.dev
+#define PROFILER_TRACE_PATH "trace.json"
+
+#if PROFILER_ENABLED
+
+// One finished scope. name must outlive the profiler (a string literal or __func__).
+struct ProfileEvent {
+    const char* name;
+    uint64_t start;      // ns
+    uint64_t duration;   // ns
+};
+
+// Events of one thread. Only the owning thread writes; count is published with a release store,
+// so the trace writer needs no lock.
+struct ProfileThreadBuffer {
+    ProfileEvent events[PROFILER_EVENTS_PER_THREAD];
+    std::atomic<uint64_t> count{ 0 };
+    uint32_t threadId = 0;
+    char threadName[32] = {};
+};
+
+// The calling thread's buffer, registered on first use
+ProfileThreadBuffer& profilerThreadBuffer();
+
+// Nanoseconds since the profiler's epoch, the first time anything asked for it
+inline uint64_t profilerNow() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count());
+}
+
+inline void profilerRecord(const char* name, uint64_t start, uint64_t end) {
+    static thread_local ProfileThreadBuffer* buffer = &profilerThreadBuffer();
+
+    uint64_t index = buffer->count.load(std::memory_order_relaxed);
+    buffer->events[index & (PROFILER_EVENTS_PER_THREAD - 1)] = { name, start, end - start };
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+// Labels the calling thread in the trace
+void profilerSetThreadName(const char* name);
+
+// Writes every thread's events as Chrome Trace Event JSON. Scopes still being recorded while it runs
+// may come out torn, so call it once the threads of interest are idle.
+bool profilerWriteTrace(const std::string& path);
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* scopeName) : name(scopeName), start(profilerNow()) {}
+    ~ProfileScope() { profilerRecord(name, start, profilerNow()); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_THREAD_NAME(name) profilerSetThreadName(name)
+#define PROFILE_WRITE_TRACE(path) profilerWriteTrace(path)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_WRITE_TRACE(path) ((void)0)
+
+#endif
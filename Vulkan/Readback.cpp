@@ -0,0 +1,263 @@
+#include "Readback.h"
+
+#include "ImageWriter.h"
+#include "Profiler.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+void Readback::create() {
+    // Host-cached memory makes reading the pixels back as fast as reading any other memory; write-combined
+    // memory, the usual alternative, is uncached and many times slower to read
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+        if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) {
+            memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        }
+    }
+    coherent = memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    stopping = false;
+    encoder = std::thread(&Readback::encodeLoop, this);
+
+    std::cout << "Readback created successfully! (" << (coherent ? "host-coherent" : "host-cached") << " buffers)\n";
+}
+
+void Readback::destroy() {
+    finish();
+
+    {
+        std::lock_guard<std::mutex> lock(encodeMutex);
+        stopping = true;
+    }
+    encodeCondition.notify_one();
+    if (encoder.joinable()) encoder.join();
+
+    for (Slot& slot : slots) {
+        if (slot.buffer == VK_NULL_HANDLE) continue;
+        vkUnmapMemory(device, slot.memory);
+        vkDestroyBuffer(device, slot.buffer, hostAllocationCallbacks);
+        memoryBudget.free(slot.memory);
+        slot = Slot{};
+    }
+
+    if (captured + dropped > 0) {
+        std::cout << "Readback: " << captured << " images captured, " << dropped << " dropped\n";
+    }
+}
+
+Readback::Slot* Readback::acquireSlot(VkDeviceSize size) {
+    Slot* free = nullptr;
+    for (Slot& slot : slots) {
+        if (slot.busy) continue;
+        if (slot.capacity >= size) return &slot;
+        if (!free) free = &slot;
+    }
+    if (!free) return nullptr;
+
+    // No free buffer is big enough: grow one, which is idle and so can be replaced right away
+    if (free->buffer != VK_NULL_HANDLE) {
+        vkUnmapMemory(device, free->memory);
+        vkDestroyBuffer(device, free->buffer, hostAllocationCallbacks);
+        memoryBudget.free(free->memory);
+    }
+
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryFlags, free->buffer, free->memory, MemoryCategory::Readback);
+
+    // Mapped once for the lifetime of the buffer
+    void* data;
+    vkMapMemory(device, free->memory, 0, VK_WHOLE_SIZE, 0, &data);
+    free->mapped = static_cast<const uint8_t*>(data);
+    free->capacity = size;
+    return free;
+}
+
+Readback::Slot* Readback::record(VkCommandBuffer commandBuffer, uint32_t frame, VkImage image, VkFormat format, VkExtent2D extent,
+    VkImageLayout layout) {
+    PROFILE_FUNCTION();
+
+    Slot* slot = acquireSlot(VkDeviceSize(extent.width) * extent.height * 4);
+    if (!slot) {
+        dropped++;
+        return nullptr;
+    }
+
+    slot->busy = true;
+    slot->frame = frame;
+    slot->width = extent.width;
+    slot->height = extent.height;
+    slot->format = format;
+
+    VkImageMemoryBarrier2 toTransfer{};
+    toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    toTransfer.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    toTransfer.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    toTransfer.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    toTransfer.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+    toTransfer.oldLayout = layout;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.image = image;
+    toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.imageMemoryBarrierCount = 1;
+    depInfo.pImageMemoryBarriers = &toTransfer;
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { extent.width, extent.height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+    // Back to the caller's layout, and the copied bytes made visible to the host once the fence signals
+    VkImageMemoryBarrier2 toLayout = toTransfer;
+    toLayout.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    toLayout.srcAccessMask = VK_ACCESS_2_NONE;
+    toLayout.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    toLayout.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+    toLayout.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toLayout.newLayout = layout;
+
+    VkBufferMemoryBarrier2 toHost{};
+    toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    toHost.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    toHost.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    toHost.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    toHost.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+    toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.buffer = slot->buffer;
+    toHost.size = VK_WHOLE_SIZE;
+
+    depInfo.imageMemoryBarrierCount = 1;
+    depInfo.pImageMemoryBarriers = &toLayout;
+    depInfo.bufferMemoryBarrierCount = 1;
+    depInfo.pBufferMemoryBarriers = &toHost;
+    vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+    return slot;
+}
+
+bool Readback::capture(VkCommandBuffer commandBuffer, uint32_t frame, VkImage image, VkFormat format, VkExtent2D extent,
+    VkImageLayout layout, ReadbackCallback callback, void* userData) {
+    Slot* slot = record(commandBuffer, frame, image, format, extent, layout);
+    if (!slot) return false;
+
+    slot->callback = callback;
+    slot->userData = userData;
+    return true;
+}
+
+bool Readback::captureToFile(VkCommandBuffer commandBuffer, uint32_t frame, VkImage image, VkFormat format, VkExtent2D extent,
+    VkImageLayout layout, const std::string& path) {
+    bool supported = format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB ||
+        format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+    if (!supported) {
+        std::cerr << "cannot write " << path << ": the image format has no encoder\n";
+        return false;
+    }
+
+    Slot* slot = record(commandBuffer, frame, image, format, extent, layout);
+    if (!slot) return false;
+
+    slot->path = path;
+    return true;
+}
+
+void Readback::finish() {
+    for (Slot& slot : slots) {
+        if (slot.busy) deliver(slot);
+    }
+
+    std::unique_lock<std::mutex> lock(encodeMutex);
+    encodeIdle.wait(lock, [this] { return encodePending == 0; });
+}
+
+void Readback::beginFrame(uint32_t frame) {
+    for (Slot& slot : slots) {
+        if (slot.busy && slot.frame == frame) deliver(slot);
+    }
+}
+
+void Readback::deliver(Slot& slot) {
+    PROFILE_FUNCTION();
+
+    if (!coherent) {
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = slot.memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+
+    if (slot.callback) {
+        slot.callback({ slot.mapped, slot.width, slot.height, slot.format }, slot.userData);
+        captured++;
+    }
+    else if (!slot.path.empty()) {
+        // Copied out so the buffer can take the next capture; the swizzle and encoding happen on the encoder thread
+        std::unique_lock<std::mutex> lock(encodeMutex);
+        if (lossless) {
+            PROFILE_SCOPE("waitForEncoder");
+            encodeIdle.wait(lock, [this] { return encodeQueue.size() < READBACK_ENCODE_QUEUE; });
+        }
+        if (encodeQueue.size() < READBACK_ENCODE_QUEUE) {
+            EncodeJob& job = encodeQueue.emplace_back();
+            job.path = std::move(slot.path);
+            job.width = slot.width;
+            job.height = slot.height;
+            job.swizzle = slot.format == VK_FORMAT_B8G8R8A8_UNORM || slot.format == VK_FORMAT_B8G8R8A8_SRGB;
+            job.pixels.assign(slot.mapped, slot.mapped + size_t(slot.width) * slot.height * 4);
+            encodePending++;
+            lock.unlock();
+            encodeCondition.notify_one();
+            captured++;
+        }
+        else {
+            dropped++;
+        }
+    }
+
+    slot.busy = false;
+    slot.callback = nullptr;
+    slot.userData = nullptr;
+    slot.path.clear();
+}
+
+void Readback::encodeLoop() {
+    PROFILE_THREAD_NAME("Readback encoder");
+
+    for (;;) {
+        EncodeJob job;
+        {
+            std::unique_lock<std::mutex> lock(encodeMutex);
+            encodeCondition.wait(lock, [this] { return stopping || !encodeQueue.empty(); });
+            if (encodeQueue.empty()) return;
+            job = std::move(encodeQueue.front());
+            encodeQueue.pop_front();
+        }
+
+        {
+            PROFILE_SCOPE("encodeImage");
+            if (job.swizzle) {
+                for (size_t i = 0; i < job.pixels.size(); i += 4) std::swap(job.pixels[i], job.pixels[i + 2]);
+            }
+            if (!writeImage(job.path, job.pixels.data(), job.width, job.height)) {
+                std::cerr << "failed to write " << job.path << "\n";
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(encodeMutex);
+        encodePending--;
+        encodeIdle.notify_all();
+    }
+}
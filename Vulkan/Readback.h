@@ -0,0 +1,114 @@
+#pragma once
+
+#include "VulkanCore.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Readback buffers in the ring; one capture per frame in flight needs IMAGES_IN_FLIGHT of them
+#define READBACK_SLOTS 4
+
+// Images waiting for the encoder thread; captures beyond this are dropped rather than stalling the frame,
+// unless the readback is lossless
+#define READBACK_ENCODE_QUEUE 8
+
+// Pixels of a completed capture, mapped for the duration of the callback only
+struct ReadbackImage {
+    const uint8_t* pixels;   // tightly packed rows, top row first
+    uint32_t width;
+    uint32_t height;
+    VkFormat format;
+};
+
+using ReadbackCallback = void (*)(const ReadbackImage& image, void* userData);
+
+// Asynchronous GPU-to-CPU image readback. capture() records a vkCmdCopyImageToBuffer into a free buffer of a ring of
+// host-cached buffers; once the fence of that frame has been waited on anyway, beginFrame() hands the mapped pixels to
+// the callback, so nothing ever waits on the GPU for a capture. captureToFile() sends the pixels on to an encoder
+// thread that writes PNG or PPM. When every buffer is in flight or the encoder is backed up, captures are dropped.
+//
+// Only 8-bit RGBA and BGRA images can be written to files. Main thread only, apart from the encoder thread itself.
+class Readback {
+public:
+    void create();
+
+    // finish(), then frees the buffers and stops the encoder thread
+    void destroy();
+
+    // Delivers every capture still in flight, whose fences the caller must have waited for, and blocks until
+    // the encoder has written them all
+    void finish();
+
+    // Records the copy of image into commandBuffer, which must be submitted with frame's fence. The image is in
+    // layout before and after, and must have been created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT. Returns false if
+    // no buffer was free.
+    bool capture(VkCommandBuffer commandBuffer, uint32_t frame, VkImage image, VkFormat format, VkExtent2D extent,
+        VkImageLayout layout, ReadbackCallback callback, void* userData);
+
+    // capture() with a callback that encodes the image to path, as PNG or, for a ".ppm" extension, PPM
+    bool captureToFile(VkCommandBuffer commandBuffer, uint32_t frame, VkImage image, VkFormat format, VkExtent2D extent,
+        VkImageLayout layout, const std::string& path);
+
+    // Once frame's fence has signalled: runs the callbacks of the captures submitted with it
+    void beginFrame(uint32_t frame);
+
+    // Lossless: a backed-up encoder makes beginFrame() wait instead of dropping images, for batch rendering
+    void setLossless(bool enable) { lossless = enable; }
+
+    // Captured: handed to a callback or queued for the encoder; dropped: no free buffer or the encoder was backed up
+    uint64_t capturedImages() const { return captured; }
+    uint64_t droppedImages() const { return dropped; }
+
+private:
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        const uint8_t* mapped = nullptr;
+        VkDeviceSize capacity = 0;
+
+        bool busy = false;
+        uint32_t frame = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        ReadbackCallback callback = nullptr;
+        void* userData = nullptr;
+        std::string path;
+    };
+
+    struct EncodeJob {
+        std::string path;
+        uint32_t width;
+        uint32_t height;
+        bool swizzle;   // BGRA to RGBA
+        std::vector<uint8_t> pixels;
+    };
+
+    Slot* acquireSlot(VkDeviceSize size);
+    Slot* record(VkCommandBuffer commandBuffer, uint32_t frame, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout);
+    void deliver(Slot& slot);
+    void encodeLoop();
+
+    Slot slots[READBACK_SLOTS];
+    VkMemoryPropertyFlags memoryFlags = 0;
+    bool coherent = false;
+    bool lossless = false;
+
+    std::thread encoder;
+    std::mutex encodeMutex;
+    std::condition_variable encodeCondition;
+    std::deque<EncodeJob> encodeQueue;
+    size_t encodePending = 0;   // queued or being written
+    std::condition_variable encodeIdle;
+    bool stopping = false;
+
+    uint64_t captured = 0;
+    uint64_t dropped = 0;
+};
+
+extern Readback readback;
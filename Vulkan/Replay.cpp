@@ -0,0 +1,115 @@
+#include "Replay.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+static_assert(sizeof(ReplayFrame) == 36, "ReplayFrame is written to disk as-is and must stay packed");
+static_assert(sizeof(ReplayHeader) == 16, "ReplayHeader is written to disk as-is and must stay packed");
+
+void Replay::record(const std::string& path, const std::string& modelPath) {
+    output.open(path, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        throw std::runtime_error("failed to open replay file for writing!");
+    }
+
+    ReplayHeader header{ REPLAY_FILE_MAGIC, REPLAY_FILE_VERSION, 0, static_cast<uint32_t>(modelPath.size()) };
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(modelPath.data(), modelPath.size());
+
+    replayMode = ReplayMode::Record;
+    filePath = path;
+    recordedModelPath = modelPath;
+
+    std::cout << "Recording replay to " << path << "\n";
+}
+
+void Replay::play(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("failed to open replay file!");
+    }
+
+    ReplayHeader header{};
+    input.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!input || header.magic != REPLAY_FILE_MAGIC || header.version != REPLAY_FILE_VERSION) {
+        throw std::runtime_error("replay file has an unsupported format!");
+    }
+
+    recordedModelPath.resize(header.modelPathLength);
+    input.read(recordedModelPath.data(), header.modelPathLength);
+
+    frames.resize(header.frameCount);
+    input.read(reinterpret_cast<char*>(frames.data()), frames.size() * sizeof(ReplayFrame));
+    if (!input) {
+        throw std::runtime_error("replay file is truncated!");
+    }
+
+    frameSeconds.reserve(frames.size());
+    gpuMilliseconds.reserve(frames.size());
+
+    replayMode = ReplayMode::Replay;
+    filePath = path;
+
+    std::cout << "Replaying " << frames.size() << " frames from " << path << "\n";
+}
+
+void Replay::destroy() {
+    if (replayMode == ReplayMode::Record) {
+        // The frame count goes into the header last, so a recording cut short by a crash is rejected, not misread
+        output.seekp(offsetof(ReplayHeader, frameCount));
+        output.write(reinterpret_cast<const char*>(&recordedFrames), sizeof(recordedFrames));
+        output.close();
+
+        std::cout << "Recorded " << recordedFrames << " frames to " << filePath << "\n";
+    }
+    else if (replayMode == ReplayMode::Replay && !frameSeconds.empty()) {
+        std::vector<double> sorted = frameSeconds;
+        std::sort(sorted.begin(), sorted.end());
+
+        double total = 0.0;
+        for (double seconds : sorted) total += seconds;
+
+        double recordedTotal = 0.0;
+        for (const ReplayFrame& frame : frames) recordedTotal += frame.deltaTime;
+
+        double gpuTotal = 0.0;
+        for (double milliseconds : gpuMilliseconds) gpuTotal += milliseconds;
+
+        auto percentile = [&sorted](double fraction) {
+            return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))] * 1000.0;
+        };
+
+        char line[256];
+        snprintf(line, sizeof(line), "Replay of %s: %zu frames in %.3f s (recorded mean frame %.3f ms)\n", filePath.c_str(),
+            sorted.size(), total, recordedTotal * 1000.0 / frames.size());
+        std::cout << line;
+        snprintf(line, sizeof(line), "  frame ms: mean %.3f, median %.3f, p95 %.3f, p99 %.3f, max %.3f; GPU ms: mean %.3f\n",
+            total * 1000.0 / sorted.size(), percentile(0.5), percentile(0.95), percentile(0.99), sorted.back() * 1000.0,
+            gpuTotal / gpuMilliseconds.size());
+        std::cout << line;
+    }
+
+    replayMode = ReplayMode::Off;
+    frames.clear();
+    frameSeconds.clear();
+    gpuMilliseconds.clear();
+}
+
+void Replay::recordFrame(const ReplayFrame& frame) {
+    output.write(reinterpret_cast<const char*>(&frame), sizeof(frame));
+    recordedFrames++;
+}
+
+bool Replay::nextFrame() {
+    if (current + 1 >= frames.size()) return false;
+    current++;
+    return true;
+}
+
+void Replay::frameTimed(double seconds, double gpuMs) {
+    frameSeconds.push_back(seconds);
+    gpuMilliseconds.push_back(gpuMs);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#define REPLAY_FILE_MAGIC 0x50524b56u   // "VKRP"
+#define REPLAY_FILE_VERSION 1
+
+// Seconds the scene advances by per replayed frame, whatever the recorded frame took
+#define REPLAY_TIMESTEP (1.0 / 60.0)
+
+// Seconds a replay waits for the window system to apply a recorded window size
+#define REPLAY_RESIZE_TIMEOUT 1.0
+
+// Scene mutations that happened during a frame
+#define REPLAY_EVENT_MODEL_READY 0x1   // the background-loaded model replaced the cube
+#define REPLAY_EVENT_RESIZE 0x2        // the window changed to width x height
+
+enum class ReplayMode { Off, Record, Replay };
+
+// Inputs of one frame, written as-is: the file is a ReplayHeader, the model path and then one of these per frame
+struct ReplayFrame {
+    float deltaTime;   // wall-clock seconds the recorded frame took
+    glm::vec3 cameraPosition;
+    glm::vec3 cameraTarget;
+    uint16_t width;    // window size in screen coordinates
+    uint16_t height;
+    uint32_t events;   // REPLAY_EVENT_* bits
+};
+
+struct ReplayHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t frameCount;        // patched in when recording finishes
+    uint32_t modelPathLength;   // bytes of model path following the header, 0 for the cube
+};
+
+// Records the per-frame inputs of a session to a compact binary file, or plays a recorded file back.
+// A replay advances the scene by REPLAY_TIMESTEP instead of the wall clock, and scene mutations happen
+// on the recorded frame (waiting for them if need be), so every replay of a file renders exactly the same
+// frame sequence; its frame times are collected for a benchmark report. A recorded resize is waited for and the
+// swapchain recreated before that frame renders; a window system that refuses the size (e.g. a tiling window
+// manager) leaves the frames at whatever size it chose. Main thread only.
+class Replay {
+public:
+    // Starts writing frames to path
+    void record(const std::string& path, const std::string& modelPath);
+
+    // Reads the whole of path up front, so that replay timings include no file I/O
+    void play(const std::string& path);
+
+    // Finishes the file when recording, prints the timing report when replaying
+    void destroy();
+
+    ReplayMode mode() const { return replayMode; }
+
+    // The model the recording was made with, empty for the cube
+    const std::string& modelPath() const { return recordedModelPath; }
+
+    // Recording: appends the inputs of the frame that just ended
+    void recordFrame(const ReplayFrame& frame);
+
+    // Replaying: moves on to the next recorded frame; false once there are none left
+    bool nextFrame();
+    const ReplayFrame& frame() const { return frames[current]; }
+
+    // Replaying: wall-clock seconds and GPU milliseconds the current frame took, for the report
+    void frameTimed(double seconds, double gpuMilliseconds);
+
+private:
+    ReplayMode replayMode = ReplayMode::Off;
+    std::string filePath;
+    std::string recordedModelPath;
+
+    std::ofstream output;
+    uint32_t recordedFrames = 0;
+
+    std::vector<ReplayFrame> frames;
+    size_t current = SIZE_MAX;   // SIZE_MAX before the first frame
+    std::vector<double> frameSeconds;
+    std::vector<double> gpuMilliseconds;
+};
+
+extern Replay replay;
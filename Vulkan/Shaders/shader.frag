@@ -1,9 +1,22 @@
 #version 450
 
 layout(location = 0) in vec3 fragColor;  // received from vertex shader
+layout(location = 3) flat in uint fragMaterial;
+
+// GpuMaterial in Material.h
+struct Material {
+    vec4 diffuse;    // Kd, d
+    vec4 specular;   // Ks, Ns
+    vec4 emission;   // Ke, Ni
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer MaterialTable {
+    Material materials[];
+};
 
 layout(location = 0) out vec4 outColor;  // final pixel color
 
 void main() {
-    outColor = vec4(fragColor, 1.0);      // RGB + alpha
+    Material material = materials[fragMaterial];
+    outColor = vec4(fragColor * material.diffuse.rgb + material.emission.rgb, material.diffuse.a);      // RGB + alpha
 }
\ No newline at end of file
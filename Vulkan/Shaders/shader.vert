@@ -2,16 +2,30 @@
 
 layout(location = 0) in vec3 inPos;    // from vertex buffer
 layout(location = 1) in vec3 inColor;  // from vertex buffer
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec2 inUV;
 
-layout(push_constant) uniform PushConstants {
-    mat4 model;
+// Both blocks live in the uniform ring and are located by dynamic offsets
+layout(set = 0, binding = 1) uniform Frame {
     mat4 view;
     mat4 proj;
-} pc;
+} frame;
+
+layout(set = 0, binding = 2) uniform Object {
+    mat4 model;
+    vec4 positionScale;   // only used by shader_packed.vert
+    vec4 positionOffset;
+} object;
 
 layout(location = 0) out vec3 fragColor; // pass to fragment shader
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragUV;
+layout(location = 3) flat out uint fragMaterial;  // firstInstance of the draw
 
 void main() {
-    gl_Position = pc.proj * pc.view * pc.model * vec4(inPos, 1.0); // convert 2D -> 4D for Vulkan
+    gl_Position = frame.proj * frame.view * object.model * vec4(inPos, 1.0); // convert 2D -> 4D for Vulkan
     fragColor = inColor;
+    fragNormal = mat3(object.model) * inNormal;
+    fragUV = inUV;
+    fragMaterial = gl_InstanceIndex;
 }
\ No newline at end of file
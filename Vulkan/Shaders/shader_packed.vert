@@ -0,0 +1,41 @@
+#version 450
+
+// Same as shader.vert, for PackedVertex (VERTEX_FORMAT_PACKED)
+layout(location = 0) in vec4 inPos;     // unorm16 inside the mesh bounds
+layout(location = 1) in vec4 inColor;   // unorm8
+layout(location = 2) in vec2 inNormal;  // octahedral, snorm16
+layout(location = 3) in vec2 inUV;      // half
+
+layout(set = 0, binding = 1) uniform Frame {
+    mat4 view;
+    mat4 proj;
+} frame;
+
+layout(set = 0, binding = 2) uniform Object {
+    mat4 model;
+    vec4 positionScale;
+    vec4 positionOffset;
+} object;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragUV;
+layout(location = 3) flat out uint fragMaterial;  // firstInstance of the draw
+
+// Unfolds the lower half of the octahedron, see encodeOctahedral in VertexFormat.cpp
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main() {
+    vec3 position = inPos.xyz * object.positionScale.xyz + object.positionOffset.xyz;
+
+    gl_Position = frame.proj * frame.view * object.model * vec4(position, 1.0);
+    fragColor = inColor.rgb;
+    fragNormal = mat3(object.model) * decodeOctahedral(inNormal);
+    fragUV = inUV;
+    fragMaterial = gl_InstanceIndex;
+}
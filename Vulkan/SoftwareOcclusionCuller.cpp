@@ -0,0 +1,362 @@
+#include "SoftwareOcclusionCuller.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#if SOFTWARE_OCCLUSION_AVX2 || SOFTWARE_OCCLUSION_SSE
+#include <immintrin.h>
+#endif
+
+static_assert(SOFTWARE_OCCLUSION_TILE_WIDTH == 8 && SOFTWARE_OCCLUSION_TILE_HEIGHT == 4, "a tile's coverage is one 32-bit mask");
+static_assert(SOFTWARE_OCCLUSION_WIDTH % SOFTWARE_OCCLUSION_TILE_WIDTH == 0 && SOFTWARE_OCCLUSION_HEIGHT % SOFTWARE_OCCLUSION_TILE_HEIGHT == 0,
+    "the buffer must be a whole number of tiles");
+
+namespace {
+
+const uint32_t fullMask = 0xFFFFFFFF;
+
+// a * x + b * y + c, positive inside the triangle
+struct Edge {
+    float a;
+    float b;
+    float c;
+};
+
+Edge makeEdge(const glm::vec4& from, const glm::vec4& to) {
+    return { from.y - to.y, to.x - from.x, from.x * to.y - from.y * to.x };
+}
+
+// Bit row * 8 + column is set for each pixel of the tile at (x, y) whose center is inside all three edges.
+// A pixel is outside when any edge function is negative, which is the sign bit of their bitwise or.
+#if SOFTWARE_OCCLUSION_AVX2
+
+uint32_t coverTile(const Edge edges[3], float x, float y) {
+    __m256 pixelX = _mm256_add_ps(_mm256_set1_ps(x + 0.5f), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+    __m256 edgeX[3];
+    for (int e = 0; e < 3; e++) edgeX[e] = _mm256_mul_ps(_mm256_set1_ps(edges[e].a), pixelX);
+
+    uint32_t mask = 0;
+    for (int row = 0; row < SOFTWARE_OCCLUSION_TILE_HEIGHT; row++) {
+        float pixelY = y + row + 0.5f;
+        __m256 outside = _mm256_setzero_ps();
+        for (int e = 0; e < 3; e++) {
+            outside = _mm256_or_ps(outside, _mm256_add_ps(edgeX[e], _mm256_set1_ps(edges[e].b * pixelY + edges[e].c)));
+        }
+        mask |= (~uint32_t(_mm256_movemask_ps(outside)) & 0xFF) << (row * 8);
+    }
+    return mask;
+}
+
+#elif SOFTWARE_OCCLUSION_SSE
+
+uint32_t coverTile(const Edge edges[3], float x, float y) {
+    __m128 pixelX = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+    __m128 edgeX[3][2];
+    for (int e = 0; e < 3; e++) {
+        __m128 a = _mm_set1_ps(edges[e].a);
+        edgeX[e][0] = _mm_mul_ps(a, pixelX);
+        edgeX[e][1] = _mm_add_ps(edgeX[e][0], _mm_mul_ps(a, _mm_set1_ps(4.0f)));
+    }
+
+    uint32_t mask = 0;
+    for (int row = 0; row < SOFTWARE_OCCLUSION_TILE_HEIGHT; row++) {
+        float pixelY = y + row + 0.5f;
+        __m128 outsideLeft = _mm_setzero_ps();
+        __m128 outsideRight = _mm_setzero_ps();
+        for (int e = 0; e < 3; e++) {
+            __m128 edgeY = _mm_set1_ps(edges[e].b * pixelY + edges[e].c);
+            outsideLeft = _mm_or_ps(outsideLeft, _mm_add_ps(edgeX[e][0], edgeY));
+            outsideRight = _mm_or_ps(outsideRight, _mm_add_ps(edgeX[e][1], edgeY));
+        }
+        uint32_t outside = uint32_t(_mm_movemask_ps(outsideLeft)) | uint32_t(_mm_movemask_ps(outsideRight)) << 4;
+        mask |= (~outside & 0xFF) << (row * 8);
+    }
+    return mask;
+}
+
+#else
+
+uint32_t coverTile(const Edge edges[3], float x, float y) {
+    uint32_t mask = 0;
+    for (int row = 0; row < SOFTWARE_OCCLUSION_TILE_HEIGHT; row++) {
+        for (int column = 0; column < SOFTWARE_OCCLUSION_TILE_WIDTH; column++) {
+            float pixelX = x + column + 0.5f;
+            float pixelY = y + row + 0.5f;
+            bool inside = true;
+            for (int e = 0; e < 3; e++) inside = inside && edges[e].a * pixelX + edges[e].b * pixelY + edges[e].c >= 0.0f;
+            if (inside) mask |= 1u << (row * 8 + column);
+        }
+    }
+    return mask;
+}
+
+#endif
+
+// True when depth is at or in front of any of count reference depths; up to a register past them may be read
+#if SOFTWARE_OCCLUSION_AVX2
+
+bool anyTileInFront(const float* tileDepths, uint32_t count, float depth) {
+    __m256 depths = _mm256_set1_ps(depth);
+    for (uint32_t i = 0; i < count; i += 8) {
+        uint32_t inFront = _mm256_movemask_ps(_mm256_cmp_ps(depths, _mm256_loadu_ps(tileDepths + i), _CMP_LE_OQ));
+        uint32_t valid = count - i >= 8 ? 0xFF : (1u << (count - i)) - 1;
+        if (inFront & valid) return true;
+    }
+    return false;
+}
+
+#elif SOFTWARE_OCCLUSION_SSE
+
+bool anyTileInFront(const float* tileDepths, uint32_t count, float depth) {
+    __m128 depths = _mm_set1_ps(depth);
+    for (uint32_t i = 0; i < count; i += 4) {
+        uint32_t inFront = _mm_movemask_ps(_mm_cmple_ps(depths, _mm_loadu_ps(tileDepths + i)));
+        uint32_t valid = count - i >= 4 ? 0xF : (1u << (count - i)) - 1;
+        if (inFront & valid) return true;
+    }
+    return false;
+}
+
+#else
+
+bool anyTileInFront(const float* tileDepths, uint32_t count, float depth) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (depth <= tileDepths[i]) return true;
+    }
+    return false;
+}
+
+#endif
+
+// Adds a triangle's coverage of a tile and its farthest depth over the tile
+void mergeTile(float& reference, float& layer, uint32_t& mask, uint32_t coverage, float depth) {
+    // Nothing the reference does not already guarantee
+    if (depth >= reference) return;
+
+    // A triangle closer to the reference than to the working layer starts the layer over
+    if (mask != 0 && std::abs(layer - depth) > std::abs(reference - depth)) mask = 0;
+
+    layer = mask != 0 ? std::max(layer, depth) : depth;
+    mask |= coverage;
+    if (mask == fullMask) {
+        reference = layer;
+        mask = 0;
+    }
+}
+
+// Range of tiles under [low, high] pixels along one axis, clamped to the buffer
+void tileRange(float low, float high, float tileSize, uint32_t tileCount, uint32_t& first, uint32_t& last) {
+    first = static_cast<uint32_t>(std::clamp(low / tileSize, 0.0f, float(tileCount - 1)));
+    last = static_cast<uint32_t>(std::clamp(high / tileSize, 0.0f, float(tileCount - 1)));
+}
+
+const char* simdPath() {
+#if SOFTWARE_OCCLUSION_AVX2
+    return "AVX2";
+#elif SOFTWARE_OCCLUSION_SSE
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
+
+}
+
+void SoftwareOcclusionCuller::create() {
+    std::fill(std::begin(tileDepth), std::end(tileDepth), 1.0f);
+
+    std::cout << "Software occlusion culler created successfully! (" << SOFTWARE_OCCLUSION_WIDTH << "x"
+        << SOFTWARE_OCCLUSION_HEIGHT << ", " << simdPath() << ")\n";
+}
+
+void SoftwareOcclusionCuller::destroy() {
+    if (pendingMesh) finish();
+    culledMesh = nullptr;
+
+    if (frames == 0) return;
+
+    char line[200];
+    snprintf(line, sizeof(line), "Software occlusion culling: %.1f of %.1f subsets occluded and %.1f outside the view per frame over %llu frames\n",
+        double(subsetsOccluded) / frames, double(subsetsTested) / frames, double(subsetsOutside) / frames,
+        static_cast<unsigned long long>(frames));
+    std::cout << line;
+}
+
+void SoftwareOcclusionCuller::begin(const GpuMesh& mesh, const glm::mat4& matrix) {
+    PROFILE_FUNCTION();
+
+    // A frame that never got as far as recording, e.g. for a swapchain that had to be recreated
+    if (pendingMesh) finish();
+
+    pendingMesh = &mesh;
+    modelViewProj = matrix;
+    screenVertices.resize(mesh.occluderPositions.size());
+    subsetVisible.resize(mesh.subsets.size());
+
+    uint32_t vertexCount = static_cast<uint32_t>(mesh.occluderPositions.size());
+    for (uint32_t first = 0; first < vertexCount; first += SOFTWARE_OCCLUSION_VERTEX_GRAIN) {
+        uint32_t last = std::min(first + SOFTWARE_OCCLUSION_VERTEX_GRAIN, vertexCount);
+        jobSystem.run([this, first, last] { transformVertices(first, last); }, &transformJobs);
+    }
+    for (uint32_t band = 0; band < SOFTWARE_OCCLUSION_BANDS; band++) {
+        jobSystem.run([this, band] { rasterizeBand(band); }, &rasterJobs, &transformJobs);
+    }
+    jobSystem.run([this] { testSubsets(); }, &testJobs, &rasterJobs);
+}
+
+void SoftwareOcclusionCuller::finish() {
+    if (!pendingMesh) {
+        culledMesh = nullptr;
+        return;
+    }
+
+    PROFILE_FUNCTION();
+    jobSystem.wait(testJobs);
+    culledMesh = pendingMesh;
+    pendingMesh = nullptr;
+}
+
+void SoftwareOcclusionCuller::transformVertices(uint32_t first, uint32_t last) {
+    PROFILE_SCOPE("SoftwareOcclusionCuller::transformVertices");
+
+    const std::vector<glm::vec3>& positions = pendingMesh->occluderPositions;
+    for (uint32_t i = first; i < last; i++) {
+        glm::vec4 clip = modelViewProj * glm::vec4(positions[i], 1.0f);
+        if (clip.w <= 0.0f || clip.z < 0.0f) {
+            screenVertices[i] = glm::vec4(0.0f);
+            continue;
+        }
+
+        // Same mapping from normalized device coordinates as the viewport's, so the buffer is the frame scaled down
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        screenVertices[i] = glm::vec4((ndc.x * 0.5f + 0.5f) * SOFTWARE_OCCLUSION_WIDTH,
+            (ndc.y * 0.5f + 0.5f) * SOFTWARE_OCCLUSION_HEIGHT, ndc.z, 1.0f);
+    }
+}
+
+void SoftwareOcclusionCuller::rasterizeBand(uint32_t band) {
+    PROFILE_SCOPE("SoftwareOcclusionCuller::rasterizeBand");
+
+    uint32_t firstRow = band * tilesY / SOFTWARE_OCCLUSION_BANDS;
+    uint32_t endRow = (band + 1) * tilesY / SOFTWARE_OCCLUSION_BANDS;
+    std::fill(tileDepth + firstRow * tilesX, tileDepth + endRow * tilesX, 1.0f);
+    std::fill(layerMask + firstRow * tilesX, layerMask + endRow * tilesX, 0u);
+
+    float bandTop = float(firstRow * SOFTWARE_OCCLUSION_TILE_HEIGHT);
+    float bandBottom = float(endRow * SOFTWARE_OCCLUSION_TILE_HEIGHT);
+
+    const std::vector<uint32_t>& indices = pendingMesh->occluderIndices;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        glm::vec4 v0 = screenVertices[indices[t]];
+        glm::vec4 v1 = screenVertices[indices[t + 1]];
+        glm::vec4 v2 = screenVertices[indices[t + 2]];
+
+        // Triangles reaching behind the near plane are left out rather than clipped
+        if (v0.w == 0.0f || v1.w == 0.0f || v2.w == 0.0f) continue;
+
+        float minX = std::min({ v0.x, v1.x, v2.x });
+        float maxX = std::max({ v0.x, v1.x, v2.x });
+        float minY = std::min({ v0.y, v1.y, v2.y });
+        float maxY = std::max({ v0.y, v1.y, v2.y });
+        if (maxX < 0.0f || minX >= SOFTWARE_OCCLUSION_WIDTH || maxY < bandTop || minY >= bandBottom) continue;
+
+        // Both windings: the occluder's back faces are behind its front faces anyway
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (!(std::abs(area) > 0.0f)) continue;
+        if (area < 0.0f) {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        Edge edges[3] = { makeEdge(v0, v1), makeEdge(v1, v2), makeEdge(v2, v0) };
+
+        // Depth is linear in screen space
+        float depthX = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+        float depthY = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+        float maxDepth = std::max({ v0.z, v1.z, v2.z });
+
+        uint32_t tileX0, tileX1, tileY0, tileY1;
+        tileRange(minX, maxX, SOFTWARE_OCCLUSION_TILE_WIDTH, tilesX, tileX0, tileX1);
+        tileRange(std::max(minY, bandTop), std::min(maxY, bandBottom - 1.0f), SOFTWARE_OCCLUSION_TILE_HEIGHT, tilesY, tileY0, tileY1);
+
+        for (uint32_t tileY = tileY0; tileY <= tileY1; tileY++) {
+            for (uint32_t tileX = tileX0; tileX <= tileX1; tileX++) {
+                float x = float(tileX * SOFTWARE_OCCLUSION_TILE_WIDTH);
+                float y = float(tileY * SOFTWARE_OCCLUSION_TILE_HEIGHT);
+                uint32_t coverage = coverTile(edges, x, y);
+                if (coverage == 0) continue;
+
+                // The plane's farthest depth over the tile, at the corner it rises towards
+                float cornerX = depthX > 0.0f ? x + SOFTWARE_OCCLUSION_TILE_WIDTH : x;
+                float cornerY = depthY > 0.0f ? y + SOFTWARE_OCCLUSION_TILE_HEIGHT : y;
+                float depth = std::min(maxDepth, v0.z + depthX * (cornerX - v0.x) + depthY * (cornerY - v0.y));
+
+                uint32_t tile = tileY * tilesX + tileX;
+                mergeTile(tileDepth[tile], layerDepth[tile], layerMask[tile], coverage, depth);
+            }
+        }
+    }
+}
+
+void SoftwareOcclusionCuller::testSubsets() {
+    PROFILE_SCOPE("SoftwareOcclusionCuller::testSubsets");
+
+    const GpuMesh& mesh = *pendingMesh;
+
+    // The occluder and the subset's own LOD each lie within occluderError of LOD 0, so a visible subset could be
+    // up to twice that behind the occluder's surface
+    glm::vec3 padding(2.0f * mesh.occluderError);
+
+    for (size_t s = 0; s < mesh.subsets.size(); s++) {
+        const MeshSubset& subset = mesh.subsets[s];
+        subsetVisible[s] = 1;
+        subsetsTested++;
+
+        glm::vec3 boundsMin = subset.boundsMin - padding;
+        glm::vec3 boundsMax = subset.boundsMax + padding;
+
+        bool crossesNear = false;
+        glm::vec3 screenMin(FLT_MAX);
+        glm::vec3 screenMax(-FLT_MAX);
+        for (int i = 0; i < 8 && !crossesNear; i++) {
+            glm::vec3 corner(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z);
+            glm::vec4 clip = modelViewProj * glm::vec4(corner, 1.0f);
+            crossesNear = clip.w <= 0.0f || clip.z < 0.0f;
+
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            glm::vec3 screen((ndc.x * 0.5f + 0.5f) * SOFTWARE_OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * SOFTWARE_OCCLUSION_HEIGHT, ndc.z);
+            screenMin = glm::min(screenMin, screen);
+            screenMax = glm::max(screenMax, screen);
+        }
+
+        // A box reaching behind the near plane has no rectangle to test, and is kept
+        if (crossesNear) continue;
+
+        if (screenMax.x < 0.0f || screenMin.x > SOFTWARE_OCCLUSION_WIDTH || screenMax.y < 0.0f ||
+            screenMin.y > SOFTWARE_OCCLUSION_HEIGHT || screenMin.z > 1.0f) {
+            subsetVisible[s] = 0;
+            subsetsOutside++;
+            continue;
+        }
+
+        uint32_t tileX0, tileX1, tileY0, tileY1;
+        tileRange(screenMin.x, screenMax.x, SOFTWARE_OCCLUSION_TILE_WIDTH, tilesX, tileX0, tileX1);
+        tileRange(screenMin.y, screenMax.y, SOFTWARE_OCCLUSION_TILE_HEIGHT, tilesY, tileY0, tileY1);
+
+        bool occluded = true;
+        for (uint32_t tileY = tileY0; tileY <= tileY1 && occluded; tileY++) {
+            occluded = !anyTileInFront(tileDepth + tileY * tilesX + tileX0, tileX1 - tileX0 + 1, screenMin.z);
+        }
+        if (occluded) {
+            subsetVisible[s] = 0;
+            subsetsOccluded++;
+        }
+    }
+
+    frames++;
+}
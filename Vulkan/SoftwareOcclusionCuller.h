@@ -0,0 +1,101 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "Mesh.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// 0 leaves devices without GPU occlusion culling to draw every subset in the frustum
+#define SOFTWARE_OCCLUSION_ENABLED 1
+
+// Depth buffer in pixels, made of 8x4-pixel tiles with one bit of coverage per pixel
+#define SOFTWARE_OCCLUSION_WIDTH 256
+#define SOFTWARE_OCCLUSION_HEIGHT 128
+#define SOFTWARE_OCCLUSION_TILE_WIDTH 8
+#define SOFTWARE_OCCLUSION_TILE_HEIGHT 4
+
+// Rows of tiles are split into this many bands, each rasterized by its own job
+#define SOFTWARE_OCCLUSION_BANDS 4
+
+// Occluder vertices transformed per job
+#define SOFTWARE_OCCLUSION_VERTEX_GRAIN 2048
+
+// The instruction set is picked at compile time, as in TransformKernels.h: AVX2 covers a tile row per register,
+// SSE (nothing beyond SSE2, which every x86-64 CPU has) half of one, and anything else falls back to scalar code
+#if defined(__AVX2__)
+#define SOFTWARE_OCCLUSION_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#define SOFTWARE_OCCLUSION_SSE 1
+#endif
+
+// CPU occlusion culling of a mesh's subsets against its own occluder (GpuMesh::occluderPositions), the fallback
+// for devices without the indirect draws HiZCuller needs. After Hasselgren et al. 2016, "Masked Software
+// Occlusion Culling":
+// - Instead of a depth per pixel, each tile keeps a reference depth that holds for all of its pixels, and a
+//   working layer: a coverage mask and the farthest depth of the triangles that set it. Once the mask is full
+//   the working layer becomes the reference; a triangle closer to the reference than to the working layer
+//   starts the layer over.
+// - A triangle's coverage of a tile comes from its edge functions, evaluated for a whole row of pixels at once.
+// - A subset's box is occluded when its nearest depth is behind the reference depth of every tile under its
+//   screen rectangle, and outside the view when the rectangle misses the buffer.
+// Depth is not reversed here, as in the renderer: 0 is near and each tile keeps the farthest depth.
+//
+// begin() queues the work as jobs: the occluder vertices are transformed in parallel, each band of tiles is
+// rasterized on its own, and one job tests the boxes of every subset. It is called before the frame fence is
+// waited on, so the jobs run while the previous frame is still on the GPU.
+class SoftwareOcclusionCuller {
+public:
+    void create();
+
+    // Prints how much was culled; waits for any jobs still running
+    void destroy();
+
+    // Starts culling the subsets of every LOD of mesh for modelViewProj. mesh must stay unchanged until finish().
+    void begin(const GpuMesh& mesh, const glm::mat4& modelViewProj);
+
+    // Once per frame before the draws are built: waits for the jobs of begin(), or, without a begin() since the
+    // last call, leaves every subset visible
+    void finish();
+
+    // Forgets the results, for a mesh that has just been replaced
+    void discard() { culledMesh = nullptr; }
+
+    // False when finish() found the subset of mesh occluded or outside the view
+    bool visible(const GpuMesh& mesh, uint32_t subsetIndex) const {
+        return &mesh != culledMesh || subsetVisible[subsetIndex] != 0;
+    }
+
+private:
+    static constexpr uint32_t tilesX = SOFTWARE_OCCLUSION_WIDTH / SOFTWARE_OCCLUSION_TILE_WIDTH;
+    static constexpr uint32_t tilesY = SOFTWARE_OCCLUSION_HEIGHT / SOFTWARE_OCCLUSION_TILE_HEIGHT;
+
+    void transformVertices(uint32_t begin, uint32_t end);
+    void rasterizeBand(uint32_t band);
+    void testSubsets();
+
+    // Row by row. tileDepth has one register of padding, so a row's last tiles can be loaded as a whole register.
+    alignas(32) float tileDepth[tilesX * tilesY + 8];   // reference depth
+    float layerDepth[tilesX * tilesY];                  // working layer
+    uint32_t layerMask[tilesX * tilesY];
+
+    // Occluder vertices in pixels, with the depth in z; w is 0 for those behind the near plane
+    std::vector<glm::vec4> screenVertices;
+    std::vector<uint8_t> subsetVisible;
+
+    glm::mat4 modelViewProj = glm::mat4(1.0f);
+    const GpuMesh* pendingMesh = nullptr;   // between begin() and finish()
+    const GpuMesh* culledMesh = nullptr;    // whose results subsetVisible holds
+
+    JobCounter transformJobs;
+    JobCounter rasterJobs;
+    JobCounter testJobs;
+
+    // Running totals for the report, written by the test job
+    uint64_t frames = 0;
+    uint64_t subsetsTested = 0;
+    uint64_t subsetsOccluded = 0;
+    uint64_t subsetsOutside = 0;
+};
@@ -0,0 +1,194 @@
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+StagingRing::StagingRing(VkDeviceSize size) {
+    // No destructor runs for a ring that fails to construct, so whatever was created is released here
+    try {
+        create(size);
+    }
+    catch (...) {
+        release();
+        throw;
+    }
+}
+
+void StagingRing::create(VkDeviceSize size) {
+    segmentSize = std::max<VkDeviceSize>(size / STAGING_SEGMENTS, 1);
+
+    createBuffer(segmentSize * STAGING_SEGMENTS,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        stagingBuffer,
+        stagingBufferMemory,
+        MemoryCategory::Staging);
+
+    // Mapped once for the lifetime of the ring
+    void* data;
+    if (vkMapMemory(device, stagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map staging ring!");
+    }
+    mapped = static_cast<char*>(data);
+
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+    if (vkCreateCommandPool(device, &poolInfo, hostAllocationCallbacks, &uploadCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = uploadCommandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    for (StagingSegment& segment : segments) {
+        if (vkAllocateCommandBuffers(device, &allocInfo, &segment.commandBuffer) != VK_SUCCESS ||
+            vkCreateFence(device, &fenceInfo, hostAllocationCallbacks, &segment.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create staging ring segment!");
+        }
+    }
+}
+
+StagingRing::~StagingRing() {
+    waitAll();
+    release();
+}
+
+void StagingRing::release() {
+    // Handles not created yet are VK_NULL_HANDLE, which every destroy call ignores
+    for (StagingSegment& segment : segments) {
+        vkDestroyFence(device, segment.fence, hostAllocationCallbacks);
+    }
+    vkDestroyCommandPool(device, uploadCommandPool, hostAllocationCallbacks);
+
+    if (mapped) vkUnmapMemory(device, stagingBufferMemory);
+    vkDestroyBuffer(device, stagingBuffer, hostAllocationCallbacks);
+    memoryBudget.free(stagingBufferMemory);
+}
+
+void StagingRing::write(VkBuffer destination, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+    const char* bytes = static_cast<const char*>(data);
+
+    while (size > 0) {
+        if (head == segmentSize) {
+            submitSegment();
+            advance();
+        }
+
+        VkDeviceSize chunk = std::min(size, segmentSize - head);
+
+        StagingSegment& segment = segments[current];
+        VkDeviceSize srcOffset = current * segmentSize + head;
+        memcpy(mapped + srcOffset, bytes, static_cast<size_t>(chunk));
+        head += chunk;
+
+        auto target = std::find_if(segment.copies.begin(), segment.copies.end(),
+            [destination](const StagingCopies& copies) { return copies.destination == destination; });
+        if (target == segment.copies.end()) {
+            target = segment.copies.insert(segment.copies.end(), { destination, {} });
+        }
+
+        std::vector<VkBufferCopy>& copies = target->regions;
+        if (!copies.empty() &&
+            copies.back().srcOffset + copies.back().size == srcOffset &&
+            copies.back().dstOffset + copies.back().size == dstOffset) {
+            copies.back().size += chunk;
+        }
+        else {
+            copies.push_back({ srcOffset, dstOffset, chunk });
+        }
+
+        bytes += chunk;
+        dstOffset += chunk;
+        size -= chunk;
+    }
+}
+
+void StagingRing::finish() {
+    submitSegment();
+    advance();
+    waitAll();
+}
+
+void StagingRing::submitSegment() {
+    if (head == 0) return;
+
+    StagingSegment& segment = segments[current];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(segment.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording upload command buffer!");
+    }
+
+    for (const StagingCopies& copies : segment.copies) {
+        vkCmdCopyBuffer(segment.commandBuffer, stagingBuffer, copies.destination,
+            static_cast<uint32_t>(copies.regions.size()), copies.regions.data());
+    }
+
+    // Make the copied ranges visible to vertex input and shader reads in any later submission on this queue
+    VkMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+
+    VkDependencyInfo depInfo{};
+    depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    depInfo.memoryBarrierCount = 1;
+    depInfo.pMemoryBarriers = &barrier;
+
+    vkCmdPipelineBarrier2(segment.commandBuffer, &depInfo);
+
+    if (vkEndCommandBuffer(segment.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &segment.commandBuffer;
+
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, segment.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload command buffer!");
+    }
+    segment.inFlight = true;
+}
+
+// Moves on to the next segment, waiting for its previous copies to retire first
+void StagingRing::advance() {
+    current = (current + 1) % STAGING_SEGMENTS;
+    head = 0;
+
+    StagingSegment& segment = segments[current];
+    if (segment.inFlight) {
+        vkWaitForFences(device, 1, &segment.fence, VK_TRUE, UINT64_MAX);
+        vkResetFences(device, 1, &segment.fence);
+        segment.inFlight = false;
+    }
+    segment.copies.clear();
+}
+
+void StagingRing::waitAll() {
+    for (StagingSegment& segment : segments) {
+        if (segment.inFlight) {
+            vkWaitForFences(device, 1, &segment.fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &segment.fence);
+            segment.inFlight = false;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "VulkanCore.h"
+
+#include <vector>
+
+// The ring is split into segments: the CPU fills one while the copies out of the others are in flight
+#define STAGING_SEGMENTS 4
+
+// Copy regions into one destination buffer, merged whenever they are contiguous
+struct StagingCopies {
+    VkBuffer destination;
+    std::vector<VkBufferCopy> regions;
+};
+
+struct StagingSegment {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    bool inFlight = false;
+
+    // Recorded while the segment was being filled, one entry per destination
+    std::vector<StagingCopies> copies;
+};
+
+// Persistently mapped, host-visible buffer that feeds device-local buffers through vkCmdCopyBuffer.
+// Copies are submitted to graphicsQueue segment by segment and made visible to vertex input and shader reads;
+// finish() must be called before the destinations are used.
+class StagingRing {
+public:
+    explicit StagingRing(VkDeviceSize size);
+    ~StagingRing();
+
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    // Copies size bytes into the ring, to land at dstOffset in destination.
+    // Writes larger than the free space in a segment are split across segments.
+    void write(VkBuffer destination, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+    // Flushes the partially filled segment and blocks until every copy has completed
+    void finish();
+
+private:
+    void create(VkDeviceSize size);
+    void release();
+
+    void submitSegment();
+    void advance();
+    void waitAll();
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+    char* mapped = nullptr;
+
+    VkCommandPool uploadCommandPool = VK_NULL_HANDLE;
+    StagingSegment segments[STAGING_SEGMENTS];
+
+    VkDeviceSize segmentSize = 0;
+    uint32_t current = 0;
+    VkDeviceSize head = 0;   // write offset inside the current segment
+};
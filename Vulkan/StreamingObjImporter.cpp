@@ -0,0 +1,240 @@
+#include "StreamingObjImporter.h"
+#include "MappedFile.h"
+#include "StagingRing.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include <cfloat>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+struct ObjStreamState {
+    StagingRing* ring;
+    VkBuffer vertexBuffer;
+    VkBuffer indexBuffer;
+
+    uint32_t expectedVertices;
+    uint32_t expectedIndices;
+
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    uint32_t skippedFaces = 0;
+
+    VertexQuantization quantization;
+};
+
+bool isObjSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Cheap pass over the mapped file that counts what the callbacks will emit, so the device-local
+// buffers can be sized up front. Mirrors the line and face token rules of tinyobj.
+// Also takes the position bounds, which packed vertices are quantized against as they stream.
+void countObjElements(const MappedFile& file, uint64_t& vertexCount, uint64_t& indexCount,
+    glm::vec3& minPosition, glm::vec3& maxPosition) {
+    minPosition = glm::vec3(FLT_MAX);
+    maxPosition = glm::vec3(-FLT_MAX);
+
+    const char* p = file.data();
+    const char* end = p + file.size();
+
+    if (end - p >= 3 && p[0] == '\xEF' && p[1] == '\xBB' && p[2] == '\xBF') p += 3;
+
+    while (p < end) {
+        const char* lineEnd = p;
+        while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r') lineEnd++;
+
+        while (p < lineEnd && isObjSpace(*p)) p++;
+
+        if (lineEnd - p >= 2 && isObjSpace(p[1])) {
+            if (p[0] == 'v') {
+                vertexCount++;
+
+                glm::vec3 position(0.0f);
+                const char* q = p + 2;
+                for (int i = 0; i < 3; i++) {
+                    while (q < lineEnd && isObjSpace(*q)) q++;
+                    q = std::from_chars(q, lineEnd, position[i]).ptr;
+                }
+                minPosition = glm::min(minPosition, position);
+                maxPosition = glm::max(maxPosition, position);
+            }
+            else if (p[0] == 'f') {
+                uint64_t corners = 0;
+                p += 2;
+                for (;;) {
+                    while (p < lineEnd && (isObjSpace(*p) || *p == '\r')) p++;
+                    if (p >= lineEnd || *p == '#') break;
+                    corners++;
+                    while (p < lineEnd && !isObjSpace(*p) && *p != '\r') p++;
+                }
+                if (corners >= 3) indexCount += (corners - 2) * 3;
+            }
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+void streamVertex(void* user_data, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z,
+    tinyobj::real_t r, tinyobj::real_t g, tinyobj::real_t b, bool has_color) {
+    ObjStreamState* state = static_cast<ObjStreamState*>(user_data);
+
+    if (state->vertexCount >= state->expectedVertices) {
+        throw std::runtime_error("OBJ vertex count changed while streaming!");
+    }
+
+    Vertex vertex{
+        { static_cast<float>(x), static_cast<float>(y), static_cast<float>(z) },
+        { 1.0f, 1.0f, 1.0f },
+        { 0.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f }
+    };
+    if (has_color) {
+        vertex.color[0] = static_cast<float>(r);
+        vertex.color[1] = static_cast<float>(g);
+        vertex.color[2] = static_cast<float>(b);
+    }
+
+    // Normals and texcoords are per face corner in OBJ, so a streamed vertex has neither
+    GpuVertex gpuVertex = toGpuVertex(vertex, state->quantization);
+    state->ring->write(state->vertexBuffer, VkDeviceSize(state->vertexCount) * sizeof(GpuVertex), &gpuVertex, sizeof(GpuVertex));
+    state->vertexCount++;
+}
+
+// Faces arrive as raw OBJ indices (1-based, negative = relative to the last vertex read)
+// and are fan triangulated, so concave polygons are not supported.
+void streamFace(void* user_data, tinyobj::index_t* indices, int num_indices) {
+    ObjStreamState* state = static_cast<ObjStreamState*>(user_data);
+
+    if (num_indices < 3) return;
+
+    uint32_t corners[3];
+    auto resolve = [state](int index, uint32_t& out) {
+        int64_t resolved = index > 0 ? int64_t(index) - 1 : int64_t(state->vertexCount) + index;
+        if (index == 0 || resolved < 0 || resolved >= int64_t(state->expectedVertices)) return false;
+        out = static_cast<uint32_t>(resolved);
+        return true;
+    };
+
+    for (int i = 0; i < num_indices; i++) {
+        uint32_t unused;
+        if (!resolve(indices[i].vertex_index, unused)) {
+            state->skippedFaces++;
+            return;
+        }
+    }
+
+    if (state->indexCount + uint64_t(num_indices - 2) * 3 > state->expectedIndices) {
+        throw std::runtime_error("OBJ face count changed while streaming!");
+    }
+
+    resolve(indices[0].vertex_index, corners[0]);
+    for (int i = 1; i + 1 < num_indices; i++) {
+        resolve(indices[i].vertex_index, corners[1]);
+        resolve(indices[i + 1].vertex_index, corners[2]);
+
+        state->ring->write(state->indexBuffer, VkDeviceSize(state->indexCount) * sizeof(uint32_t), corners, sizeof(corners));
+        state->indexCount += 3;
+    }
+}
+
+} // namespace
+
+GpuMesh streamObjToDevice(const std::string& filename, VkDeviceSize stagingRingSize) {
+    uint64_t vertexTotal = 0;
+    uint64_t indexTotal = 0;
+    glm::vec3 minPosition;
+    glm::vec3 maxPosition;
+    // Mapped once for both passes, so even a file of several GB takes only one mapping
+    MappedFile file(filename);
+    countObjElements(file, vertexTotal, indexTotal, minPosition, maxPosition);
+
+    if (vertexTotal == 0 || indexTotal == 0) {
+        throw std::runtime_error("OBJ file has no triangles: " + filename);
+    }
+    if (vertexTotal > std::numeric_limits<uint32_t>::max() || indexTotal > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("OBJ file is too large for 32-bit indices: " + filename);
+    }
+
+    GpuMesh mesh{};
+
+    createBuffer(vertexTotal * sizeof(GpuVertex),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mesh.vertexBuffer,
+        mesh.vertexBufferMemory,
+        MemoryCategory::Vertex);
+
+    createBuffer(indexTotal * sizeof(uint32_t),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        mesh.indexBuffer,
+        mesh.indexBufferMemory,
+        MemoryCategory::Index);
+
+    std::string warn;
+    std::string err;
+    ObjStreamState state{};
+
+    try {
+        StagingRing ring(stagingRingSize);
+
+        state.ring = &ring;
+        state.vertexBuffer = mesh.vertexBuffer;
+        state.indexBuffer = mesh.indexBuffer;
+        state.expectedVertices = static_cast<uint32_t>(vertexTotal);
+        state.expectedIndices = static_cast<uint32_t>(indexTotal);
+        state.quantization = computeVertexQuantization(minPosition, maxPosition);
+
+        tinyobj::callback_t callback;
+        callback.vertex_color_cb = streamVertex;
+        callback.index_cb = streamFace;
+
+        // Materials are resolved next to the OBJ so usemtl lines do not warn; their data is not used here
+        tinyobj::MaterialFileReader materialReader(filename.substr(0, filename.find_last_of("/\\") + 1));
+
+        if (!tinyobj::LoadObjWithCallback(file.data(), file.size(), callback, &state, &materialReader, &warn, &err)) {
+            throw std::runtime_error("failed to load OBJ file: " + filename + "\n" + err);
+        }
+
+        ring.finish();
+    }
+    catch (...) {
+        // The ring has already waited for its copies while unwinding
+        destroyGpuMesh(mesh);
+        throw;
+    }
+
+    if (!warn.empty()) {
+        std::cerr << warn;
+    }
+    if (state.skippedFaces > 0) {
+        std::cerr << "Skipped " << state.skippedFaces << " faces with invalid vertex indices\n";
+    }
+
+    mesh.vertexCount = state.vertexCount;
+    mesh.indexCount = state.indexCount;
+
+    // No LOD chain or material split when streaming: one level, one subset
+    mesh.lods.push_back({ 0, mesh.indexCount, 0, 1, 0.0f });
+    glm::vec3 padding = state.quantization.scale / 65535.0f;
+    mesh.subsets.push_back({ -1, 0, mesh.indexCount, 0, minPosition - padding, maxPosition + padding });
+
+    // The box is all that is kept of the positions, so the sphere encloses the box
+    mesh.boundsCenter = (minPosition + maxPosition) * 0.5f;
+    mesh.boundsRadius = glm::length(maxPosition - minPosition) * 0.5f;
+    mesh.quantization = state.quantization;
+
+    std::cout << "Streamed " << filename << ": " << mesh.vertexCount << " vertices, "
+        << mesh.indexCount / 3 << " triangles\n";
+
+    return mesh;
+}
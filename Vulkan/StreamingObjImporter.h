@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <string>
+
+// Imports an OBJ file straight into device-local vertex and index buffers.
+// The file is parsed with tinyobj::LoadObjWithCallback: every vertex and every triangulated face is written
+// into a persistently mapped staging ring as soon as it is parsed, and full ring segments are copied to
+// the device while the parser carries on. The attrib_t/shape_t arrays are never built, so peak memory
+// stays close to stagingRingSize no matter how large the file is.
+GpuMesh streamObjToDevice(const std::string& filename, VkDeviceSize stagingRingSize = 16 * 1024 * 1024);
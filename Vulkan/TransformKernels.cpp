@@ -0,0 +1,454 @@
+#include "TransformKernels.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#if TRANSFORM_SIMD_AVX2 || TRANSFORM_SIMD_SSE
+#include <immintrin.h>
+#elif TRANSFORM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+glm::mat4 composeTrs(const TrsArrays& trs, size_t i) {
+    glm::quat rotation(trs.rotation[3][i], trs.rotation[0][i], trs.rotation[1][i], trs.rotation[2][i]);
+    glm::mat4 m = glm::mat4_cast(rotation);
+    m[0] *= trs.scale[0][i];
+    m[1] *= trs.scale[1][i];
+    m[2] *= trs.scale[2][i];
+    m[3] = glm::vec4(trs.translation[0][i], trs.translation[1][i], trs.translation[2][i], 1.0f);
+    return m;
+}
+
+Aabb transformAabb(const glm::mat4& m, const Aabb& box) {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+
+    glm::vec3 newCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+    glm::vec3 newExtent = glm::abs(glm::vec3(m[0])) * extent.x + glm::abs(glm::vec3(m[1])) * extent.y + glm::abs(glm::vec3(m[2])) * extent.z;
+    return { newCenter - newExtent, newCenter + newExtent };
+}
+
+// TRS math written once over a vector type S::V holding one component of S::width objects.
+// S::store writes the transposed columns out as S::width matrices.
+template <typename S>
+void composeTrsSimd(glm::mat4* out, const TrsArrays& trs, size_t i) {
+    using V = typename S::V;
+
+    V x = S::load(trs.rotation[0] + i);
+    V y = S::load(trs.rotation[1] + i);
+    V z = S::load(trs.rotation[2] + i);
+    V w = S::load(trs.rotation[3] + i);
+
+    V x2 = S::add(x, x);
+    V y2 = S::add(y, y);
+    V z2 = S::add(z, z);
+    V xx = S::mul(x, x2);
+    V yy = S::mul(y, y2);
+    V zz = S::mul(z, z2);
+    V xy = S::mul(x, y2);
+    V xz = S::mul(x, z2);
+    V yz = S::mul(y, z2);
+    V wx = S::mul(w, x2);
+    V wy = S::mul(w, y2);
+    V wz = S::mul(w, z2);
+
+    V one = S::set1(1.0f);
+    V sx = S::load(trs.scale[0] + i);
+    V sy = S::load(trs.scale[1] + i);
+    V sz = S::load(trs.scale[2] + i);
+
+    // columns[c][r]: row r of column c, one lane per object
+    V columns[4][4] = {
+        { S::mul(S::sub(one, S::add(yy, zz)), sx), S::mul(S::add(xy, wz), sx), S::mul(S::sub(xz, wy), sx), S::set1(0.0f) },
+        { S::mul(S::sub(xy, wz), sy), S::mul(S::sub(one, S::add(xx, zz)), sy), S::mul(S::add(yz, wx), sy), S::set1(0.0f) },
+        { S::mul(S::add(xz, wy), sz), S::mul(S::sub(yz, wx), sz), S::mul(S::sub(one, S::add(xx, yy)), sz), S::set1(0.0f) },
+        { S::load(trs.translation[0] + i), S::load(trs.translation[1] + i), S::load(trs.translation[2] + i), one },
+    };
+
+    S::store(out + i, columns);
+}
+
+#if TRANSFORM_SIMD_AVX2 || TRANSFORM_SIMD_SSE
+
+// a * b for a column b, with a's columns already in registers
+inline __m128 mulColumn(const __m128 a[4], __m128 b) {
+    __m128 r = _mm_mul_ps(a[0], _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 0, 0)));
+    r = _mm_add_ps(r, _mm_mul_ps(a[1], _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 1, 1))));
+    r = _mm_add_ps(r, _mm_mul_ps(a[2], _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 2, 2))));
+    r = _mm_add_ps(r, _mm_mul_ps(a[3], _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 3, 3))));
+    return r;
+}
+
+using Vec4 = __m128;
+
+inline __m128 loadVec4(const float* p) { return _mm_loadu_ps(p); }
+inline void storeVec4(float* p, __m128 v) { _mm_storeu_ps(p, v); }
+
+inline void loadMat4(__m128 columns[4], const glm::mat4& m) {
+    for (int c = 0; c < 4; c++) columns[c] = _mm_loadu_ps(&m[c][0]);
+}
+
+// Transposes one column of four SoA matrices into the four matrices
+inline void storeColumn(glm::mat4* out, int column, __m128 r0, __m128 r1, __m128 r2, __m128 r3) {
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(&out[0][column][0], r0);
+    _mm_storeu_ps(&out[1][column][0], r1);
+    _mm_storeu_ps(&out[2][column][0], r2);
+    _mm_storeu_ps(&out[3][column][0], r3);
+}
+
+struct Sse {
+    using V = __m128;
+    static constexpr size_t width = 4;
+
+    static V load(const float* p) { return _mm_loadu_ps(p); }
+    static V set1(float f) { return _mm_set1_ps(f); }
+    static V add(V a, V b) { return _mm_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+
+    static void store(glm::mat4* out, const V columns[4][4]) {
+        for (int c = 0; c < 4; c++) storeColumn(out, c, columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+    }
+};
+
+// xyz of a and w of b
+inline __m128 blendW(__m128 a, __m128 b) {
+#if TRANSFORM_SIMD_SSE41
+    return _mm_blend_ps(a, b, 0x8);
+#else
+    __m128 mask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+    return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+#endif
+}
+
+// One box per 128-bit vector. The six floats of a box are read and written as two overlapping
+// four-float accesses, so nothing outside the Aabb is touched.
+inline void transformAabbSse(Aabb& out, const glm::mat4& m, const Aabb& box) {
+    __m128 lo = _mm_loadu_ps(&box.min.x);    // min.x min.y min.z max.x
+    __m128 hi = _mm_loadu_ps(&box.min.z);    // min.z max.x max.y max.z
+    __m128 boxMax = _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(3, 3, 2, 1));
+
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 center = _mm_mul_ps(_mm_add_ps(lo, boxMax), half);
+    __m128 extent = _mm_mul_ps(_mm_sub_ps(boxMax, lo), half);
+
+    __m128 columns[4];
+    loadMat4(columns, m);
+    __m128 signMask = _mm_set1_ps(-0.0f);
+
+    __m128 newCenter = mulColumn(columns, blendW(center, _mm_set1_ps(1.0f)));
+    __m128 newExtent = _mm_mul_ps(_mm_andnot_ps(signMask, columns[0]), _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(0, 0, 0, 0)));
+    newExtent = _mm_add_ps(newExtent, _mm_mul_ps(_mm_andnot_ps(signMask, columns[1]), _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(1, 1, 1, 1))));
+    newExtent = _mm_add_ps(newExtent, _mm_mul_ps(_mm_andnot_ps(signMask, columns[2]), _mm_shuffle_ps(extent, extent, _MM_SHUFFLE(2, 2, 2, 2))));
+
+    __m128 newMin = _mm_sub_ps(newCenter, newExtent);
+    __m128 newMax = _mm_add_ps(newCenter, newExtent);
+
+    _mm_storeu_ps(&out.min.x, blendW(newMin, _mm_shuffle_ps(newMax, newMax, _MM_SHUFFLE(0, 0, 0, 0))));
+    _mm_storel_pi(reinterpret_cast<__m64*>(&out.max.y), _mm_shuffle_ps(newMax, newMax, _MM_SHUFFLE(3, 3, 2, 1)));
+}
+
+#endif
+
+#if TRANSFORM_SIMD_AVX2
+
+inline __m256 madd(__m256 a, __m256 b, __m256 c) {
+#if defined(__FMA__)
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+// Two columns of the product at once: a's columns are duplicated into both lanes, and each lane
+// of b01 holds one column of b
+inline __m256 mulColumnPair(const __m256 a[4], __m256 b01) {
+    __m256 r = _mm256_mul_ps(a[0], _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(0, 0, 0, 0)));
+    r = madd(a[1], _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(1, 1, 1, 1)), r);
+    r = madd(a[2], _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(2, 2, 2, 2)), r);
+    r = madd(a[3], _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(3, 3, 3, 3)), r);
+    return r;
+}
+
+inline void loadMat4Duplicated(__m256 columns[4], const glm::mat4& m) {
+    for (int c = 0; c < 4; c++) columns[c] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m[c][0]));
+}
+
+struct Avx {
+    using V = __m256;
+    static constexpr size_t width = 8;
+
+    static V load(const float* p) { return _mm256_loadu_ps(p); }
+    static V set1(float f) { return _mm256_set1_ps(f); }
+    static V add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+
+    // The lanes hold objects 0-3 and 4-7, so each half is transposed on its own
+    static void store(glm::mat4* out, const V columns[4][4]) {
+        for (int c = 0; c < 4; c++) {
+            storeColumn(out, c,
+                _mm256_castps256_ps128(columns[c][0]), _mm256_castps256_ps128(columns[c][1]),
+                _mm256_castps256_ps128(columns[c][2]), _mm256_castps256_ps128(columns[c][3]));
+            storeColumn(out + 4, c,
+                _mm256_extractf128_ps(columns[c][0], 1), _mm256_extractf128_ps(columns[c][1], 1),
+                _mm256_extractf128_ps(columns[c][2], 1), _mm256_extractf128_ps(columns[c][3], 1));
+        }
+    }
+};
+
+#endif
+
+#if TRANSFORM_SIMD_NEON
+
+inline float32x4_t mulColumn(const float32x4_t a[4], float32x4_t b) {
+    float32x4_t r = vmulq_laneq_f32(a[0], b, 0);
+    r = vfmaq_laneq_f32(r, a[1], b, 1);
+    r = vfmaq_laneq_f32(r, a[2], b, 2);
+    r = vfmaq_laneq_f32(r, a[3], b, 3);
+    return r;
+}
+
+using Vec4 = float32x4_t;
+
+inline float32x4_t loadVec4(const float* p) { return vld1q_f32(p); }
+inline void storeVec4(float* p, float32x4_t v) { vst1q_f32(p, v); }
+
+inline void loadMat4(float32x4_t columns[4], const glm::mat4& m) {
+    for (int c = 0; c < 4; c++) columns[c] = vld1q_f32(&m[c][0]);
+}
+
+inline void storeColumn(glm::mat4* out, int column, float32x4_t r0, float32x4_t r1, float32x4_t r2, float32x4_t r3) {
+    float32x4x2_t t01 = vtrnq_f32(r0, r1);
+    float32x4x2_t t23 = vtrnq_f32(r2, r3);
+    vst1q_f32(&out[0][column][0], vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])));
+    vst1q_f32(&out[1][column][0], vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])));
+    vst1q_f32(&out[2][column][0], vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])));
+    vst1q_f32(&out[3][column][0], vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])));
+}
+
+struct Neon {
+    using V = float32x4_t;
+    static constexpr size_t width = 4;
+
+    static V load(const float* p) { return vld1q_f32(p); }
+    static V set1(float f) { return vdupq_n_f32(f); }
+    static V add(V a, V b) { return vaddq_f32(a, b); }
+    static V sub(V a, V b) { return vsubq_f32(a, b); }
+    static V mul(V a, V b) { return vmulq_f32(a, b); }
+
+    static void store(glm::mat4* out, const V columns[4][4]) {
+        for (int c = 0; c < 4; c++) storeColumn(out, c, columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+    }
+};
+
+// Same overlapping access pattern as the SSE version
+inline void transformAabbNeon(Aabb& out, const glm::mat4& m, const Aabb& box) {
+    float32x4_t lo = vld1q_f32(&box.min.x);
+    float32x4_t hi = vld1q_f32(&box.min.z);
+    float32x4_t boxMax = vextq_f32(hi, hi, 1);
+
+    float32x4_t center = vmulq_n_f32(vaddq_f32(lo, boxMax), 0.5f);
+    float32x4_t extent = vmulq_n_f32(vsubq_f32(boxMax, lo), 0.5f);
+
+    float32x4_t columns[4];
+    loadMat4(columns, m);
+
+    float32x4_t newCenter = mulColumn(columns, vsetq_lane_f32(1.0f, center, 3));
+    float32x4_t newExtent = vmulq_laneq_f32(vabsq_f32(columns[0]), extent, 0);
+    newExtent = vfmaq_laneq_f32(newExtent, vabsq_f32(columns[1]), extent, 1);
+    newExtent = vfmaq_laneq_f32(newExtent, vabsq_f32(columns[2]), extent, 2);
+
+    float32x4_t newMin = vsubq_f32(newCenter, newExtent);
+    float32x4_t newMax = vaddq_f32(newCenter, newExtent);
+
+    vst1q_f32(&out.min.x, vsetq_lane_f32(vgetq_lane_f32(newMax, 0), newMin, 3));
+    vst1_f32(&out.max.y, vget_low_f32(vextq_f32(newMax, newMax, 1)));
+}
+
+#endif
+
+} // namespace
+
+const char* transformKernelPath() {
+#if TRANSFORM_SIMD_AVX2
+    return "AVX2";
+#elif TRANSFORM_SIMD_SSE && TRANSFORM_SIMD_SSE41
+    return "SSE4.1";
+#elif TRANSFORM_SIMD_SSE
+    return "SSE2";
+#elif TRANSFORM_SIMD_NEON
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+void multiplyMat4Batch(glm::mat4* out, const glm::mat4* a, const glm::mat4* b, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+#if TRANSFORM_SIMD_AVX2
+        __m256 aColumns[4];
+        loadMat4Duplicated(aColumns, a[i]);
+        __m256 r01 = mulColumnPair(aColumns, _mm256_loadu_ps(&b[i][0][0]));
+        __m256 r23 = mulColumnPair(aColumns, _mm256_loadu_ps(&b[i][2][0]));
+        _mm256_storeu_ps(&out[i][0][0], r01);
+        _mm256_storeu_ps(&out[i][2][0], r23);
+#elif TRANSFORM_SIMD_SSE || TRANSFORM_SIMD_NEON
+        Vec4 aColumns[4];
+        Vec4 bColumns[4];
+        loadMat4(aColumns, a[i]);
+        loadMat4(bColumns, b[i]);
+        for (int c = 0; c < 4; c++) storeVec4(&out[i][c][0], mulColumn(aColumns, bColumns[c]));
+#else
+        out[i] = a[i] * b[i];
+#endif
+    }
+}
+
+void multiplyMat4Batch(glm::mat4* out, const glm::mat4& a, const glm::mat4* b, size_t count) {
+#if TRANSFORM_SIMD_AVX2
+    __m256 aColumns[4];
+    loadMat4Duplicated(aColumns, a);
+    for (size_t i = 0; i < count; i++) {
+        __m256 r01 = mulColumnPair(aColumns, _mm256_loadu_ps(&b[i][0][0]));
+        __m256 r23 = mulColumnPair(aColumns, _mm256_loadu_ps(&b[i][2][0]));
+        _mm256_storeu_ps(&out[i][0][0], r01);
+        _mm256_storeu_ps(&out[i][2][0], r23);
+    }
+#elif TRANSFORM_SIMD_SSE || TRANSFORM_SIMD_NEON
+    Vec4 aColumns[4];
+    loadMat4(aColumns, a);
+    for (size_t i = 0; i < count; i++) {
+        Vec4 bColumns[4];
+        loadMat4(bColumns, b[i]);
+        for (int c = 0; c < 4; c++) storeVec4(&out[i][c][0], mulColumn(aColumns, bColumns[c]));
+    }
+#else
+    for (size_t i = 0; i < count; i++) out[i] = a * b[i];
+#endif
+}
+
+void composeTrsBatch(glm::mat4* out, const TrsArrays& trs, size_t count) {
+    size_t i = 0;
+#if TRANSFORM_SIMD_AVX2
+    for (; i + Avx::width <= count; i += Avx::width) composeTrsSimd<Avx>(out, trs, i);
+#endif
+#if TRANSFORM_SIMD_AVX2 || TRANSFORM_SIMD_SSE
+    for (; i + Sse::width <= count; i += Sse::width) composeTrsSimd<Sse>(out, trs, i);
+#elif TRANSFORM_SIMD_NEON
+    for (; i + Neon::width <= count; i += Neon::width) composeTrsSimd<Neon>(out, trs, i);
+#endif
+    for (; i < count; i++) out[i] = composeTrs(trs, i);
+}
+
+void transformAabbBatch(Aabb* out, const glm::mat4* matrices, const Aabb* boxes, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+#if TRANSFORM_SIMD_AVX2 || TRANSFORM_SIMD_SSE
+        transformAabbSse(out[i], matrices[i], boxes[i]);
+#elif TRANSFORM_SIMD_NEON
+        transformAabbNeon(out[i], matrices[i], boxes[i]);
+#else
+        out[i] = transformAabb(matrices[i], boxes[i]);
+#endif
+    }
+}
+
+namespace {
+
+float maxDifference(const float* a, const float* b, size_t count) {
+    float difference = 0.0f;
+    for (size_t i = 0; i < count; i++) difference = std::max(difference, std::abs(a[i] - b[i]));
+    return difference;
+}
+
+// Best of a few runs, in milliseconds
+template <typename F>
+double timeKernel(F&& kernel) {
+    double best = 1e30;
+    for (int run = 0; run < 5; run++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        kernel();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+void printBenchmark(const char* name, double scalarMs, double simdMs, float difference) {
+    std::cout << std::fixed << std::setprecision(3)
+        << "  " << std::left << std::setw(18) << name << std::right
+        << " glm " << std::setw(8) << scalarMs << " ms  " << transformKernelPath() << " " << std::setw(8) << simdMs << " ms"
+        << "  x" << std::setprecision(2) << scalarMs / simdMs
+        << "  max difference " << std::scientific << std::setprecision(2) << difference << "\n"
+        << std::defaultfloat;
+}
+
+} // namespace
+
+void benchmarkTransformKernels(size_t count) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<glm::mat4> a(count);
+    std::vector<glm::mat4> b(count);
+    for (size_t i = 0; i < count; i++) {
+        for (int c = 0; c < 4; c++) {
+            a[i][c] = glm::vec4(unit(rng), unit(rng), unit(rng), unit(rng));
+            b[i][c] = glm::vec4(unit(rng), unit(rng), unit(rng), unit(rng));
+        }
+    }
+
+    std::vector<float> components[10];
+    for (std::vector<float>& component : components) component.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec4 q = glm::normalize(glm::vec4(unit(rng), unit(rng), unit(rng), unit(rng)));
+        for (int k = 0; k < 4; k++) components[k][i] = q[k];
+        for (int k = 4; k < 7; k++) components[k][i] = 0.5f + unit(rng) * 0.25f;
+        for (int k = 7; k < 10; k++) components[k][i] = unit(rng) * 100.0f;
+    }
+    TrsArrays trs{
+        { components[0].data(), components[1].data(), components[2].data(), components[3].data() },
+        { components[4].data(), components[5].data(), components[6].data() },
+        { components[7].data(), components[8].data(), components[9].data() },
+    };
+
+    std::vector<Aabb> boxes(count);
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 center(unit(rng), unit(rng), unit(rng));
+        glm::vec3 extent(std::abs(unit(rng)), std::abs(unit(rng)), std::abs(unit(rng)));
+        boxes[i] = { center - extent, center + extent };
+    }
+
+    std::vector<glm::mat4> expected(count);
+    std::vector<glm::mat4> actual(count);
+    std::vector<Aabb> expectedBoxes(count);
+    std::vector<Aabb> actualBoxes(count);
+
+    std::cout << "Transform kernels, " << count << " objects (" << transformKernelPath() << "):\n";
+
+    double scalarMs = timeKernel([&] { for (size_t i = 0; i < count; i++) expected[i] = a[i] * b[i]; });
+    double simdMs = timeKernel([&] { multiplyMat4Batch(actual.data(), a.data(), b.data(), count); });
+    printBenchmark("mat4 * mat4", scalarMs, simdMs, maxDifference(&expected[0][0][0], &actual[0][0][0], count * 16));
+
+    scalarMs = timeKernel([&] { for (size_t i = 0; i < count; i++) expected[i] = a[0] * b[i]; });
+    simdMs = timeKernel([&] { multiplyMat4Batch(actual.data(), a[0], b.data(), count); });
+    printBenchmark("mat4 * mat4[]", scalarMs, simdMs, maxDifference(&expected[0][0][0], &actual[0][0][0], count * 16));
+
+    scalarMs = timeKernel([&] { for (size_t i = 0; i < count; i++) expected[i] = composeTrs(trs, i); });
+    simdMs = timeKernel([&] { composeTrsBatch(actual.data(), trs, count); });
+    printBenchmark("compose TRS", scalarMs, simdMs, maxDifference(&expected[0][0][0], &actual[0][0][0], count * 16));
+
+    scalarMs = timeKernel([&] { for (size_t i = 0; i < count; i++) expectedBoxes[i] = transformAabb(actual[i], boxes[i]); });
+    simdMs = timeKernel([&] { transformAabbBatch(actualBoxes.data(), actual.data(), boxes.data(), count); });
+    printBenchmark("transform AABB", scalarMs, simdMs, maxDifference(&expectedBoxes[0].min.x, &actualBoxes[0].min.x, count * 6));
+}
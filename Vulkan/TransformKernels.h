@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Batch versions of the per-object matrix work, for scenes with many transforms.
+// The instruction set is picked at compile time: AVX2 when the compiler targets it (/arch:AVX2, -mavx2),
+// else SSE on x86-64, else NEON on AArch64, else plain glm. The SSE path only uses SSE4.1 when the compiler
+// targets it: MSVC on x64 promises no more than SSE2 without /arch:AVX, and nothing checks the CPU at run time.
+// Every kernel gives the same result as the glm expression next to it, up to float rounding.
+
+#if defined(__AVX2__)
+#define TRANSFORM_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#define TRANSFORM_SIMD_SSE 1
+#elif (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#define TRANSFORM_SIMD_NEON 1
+#endif
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define TRANSFORM_SIMD_SSE41 1
+#endif
+
+// Name of the compiled-in path, for logs
+const char* transformKernelPath();
+
+// out[i] = a[i] * b[i]; out may alias a or b
+void multiplyMat4Batch(glm::mat4* out, const glm::mat4* a, const glm::mat4* b, size_t count);
+
+// out[i] = a * b[i], e.g. viewProj * model; out may alias b
+void multiplyMat4Batch(glm::mat4* out, const glm::mat4& a, const glm::mat4* b, size_t count);
+
+// Translation, rotation and scale of count objects, one array per component
+struct TrsArrays {
+    const float* rotation[4];      // quaternion x, y, z, w (normalized)
+    const float* scale[3];
+    const float* translation[3];
+};
+
+// out[i] = translate(t) * mat4_cast(q) * scale(s)
+void composeTrsBatch(glm::mat4* out, const TrsArrays& trs, size_t count);
+
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// out[i] = smallest box around matrices[i] applied to boxes[i] (Arvo's method); out may alias boxes
+void transformAabbBatch(Aabb* out, const glm::mat4* matrices, const Aabb* boxes, size_t count);
+
+// Runs every kernel and its glm equivalent over count random objects, printing the time of each
+// and the largest difference between them
+void benchmarkTransformKernels(size_t count);
@@ -0,0 +1,58 @@
+#include "UniformRing.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void UniformRing::create(VkDeviceSize size, uint32_t frames) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    // Both limits are powers of two, so the larger one satisfies both
+    offsetAlignment = std::max<VkDeviceSize>({ properties.limits.minUniformBufferOffsetAlignment,
+        properties.limits.minStorageBufferOffsetAlignment, 1 });
+
+    partitionSize = (size + offsetAlignment - 1) & ~(offsetAlignment - 1);
+    frameCount = frames;
+
+    createBuffer(partitionSize * frameCount,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        ringBuffer,
+        ringBufferMemory,
+        MemoryCategory::Uniform);
+
+    // Mapped once for the lifetime of the ring; coherent, so writes need no flush before submission
+    void* data;
+    vkMapMemory(device, ringBufferMemory, 0, VK_WHOLE_SIZE, 0, &data);
+    mapped = static_cast<char*>(data);
+
+    beginFrame(0);
+}
+
+void UniformRing::destroy() {
+    if (ringBuffer == VK_NULL_HANDLE) return;
+
+    vkUnmapMemory(device, ringBufferMemory);
+    vkDestroyBuffer(device, ringBuffer, hostAllocationCallbacks);
+    memoryBudget.free(ringBufferMemory);
+    ringBuffer = VK_NULL_HANDLE;
+    ringBufferMemory = VK_NULL_HANDLE;
+    mapped = nullptr;
+}
+
+void UniformRing::beginFrame(uint32_t frame) {
+    partitionBegin = (frame % frameCount) * partitionSize;
+    head = partitionBegin;
+}
+
+UniformAllocation UniformRing::allocate(VkDeviceSize size) {
+    VkDeviceSize offset = (head + offsetAlignment - 1) & ~(offsetAlignment - 1);
+    if (offset + size > partitionBegin + partitionSize) {
+        throw std::runtime_error("uniform ring partition is full!");
+    }
+
+    head = offset + size;
+    peakUsage = std::max(peakUsage, head - partitionBegin);
+
+    return { mapped + offset, offset };
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "VulkanCore.h"
+
+#include <cstring>
+
+// One sub-allocation out of the ring: write through data, bind with offset as a dynamic offset
+struct UniformAllocation {
+    void* data = nullptr;
+    VkDeviceSize offset = 0;
+};
+
+// Persistently mapped, host-visible buffer for data that changes every frame (camera, per-object constants).
+// The buffer is split into one partition per frame in flight. A frame allocates linearly out of its own
+// partition, and beginFrame() hands the partition back once that frame's fence has signalled, so
+// nothing is ever freed one allocation at a time and nothing the GPU may still be reading is overwritten.
+// Offsets are aligned for both uniform and storage buffer descriptors.
+class UniformRing {
+public:
+    void create(VkDeviceSize partitionSize, uint32_t frameCount);
+    void destroy();
+
+    // Reclaims the partition of frame. Must only be called once the fence of the last submission
+    // that used it has been waited on.
+    void beginFrame(uint32_t frame);
+
+    // Reserves size bytes in the current partition, throws if the partition is full
+    UniformAllocation allocate(VkDeviceSize size);
+
+    template <typename T>
+    UniformAllocation push(const T& value) {
+        UniformAllocation allocation = allocate(sizeof(T));
+        memcpy(allocation.data, &value, sizeof(T));
+        return allocation;
+    }
+
+    VkBuffer buffer() const { return ringBuffer; }
+    VkDeviceSize alignment() const { return offsetAlignment; }
+
+    // Largest number of bytes a single frame has used so far, for sizing the partitions
+    VkDeviceSize highWaterMark() const { return peakUsage; }
+
+private:
+    VkBuffer ringBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory ringBufferMemory = VK_NULL_HANDLE;
+    char* mapped = nullptr;
+
+    VkDeviceSize offsetAlignment = 1;
+    VkDeviceSize partitionSize = 0;
+    uint32_t frameCount = 0;
+
+    VkDeviceSize partitionBegin = 0;
+    VkDeviceSize head = 0;   // absolute offset of the next allocation
+    VkDeviceSize peakUsage = 0;
+};
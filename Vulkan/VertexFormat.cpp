@@ -0,0 +1,63 @@
+#include "VertexFormat.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Projects the unit normal onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over the upper one
+glm::vec2 encodeOctahedral(glm::vec3 normal) {
+    float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (sum == 0.0f) return glm::vec2(0.0f);
+
+    glm::vec2 encoded = glm::vec2(normal) / sum;
+    if (normal.z < 0.0f) {
+        encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) *
+            glm::vec2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return encoded;
+}
+
+uint8_t toUnorm8(float value) {
+    return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+} // namespace
+
+VertexQuantization computeVertexQuantization(glm::vec3 minPosition, glm::vec3 maxPosition) {
+    VertexQuantization quantization;
+    quantization.offset = minPosition;
+    quantization.scale = glm::max(maxPosition - minPosition, glm::vec3(0.0f));
+    return quantization;
+}
+
+PackedVertex packVertex(const Vertex& vertex, const VertexQuantization& quantization) {
+    PackedVertex packed{};
+
+    for (int i = 0; i < 3; i++) {
+        float normalized = quantization.scale[i] > 0.0f ? (vertex.pos[i] - quantization.offset[i]) / quantization.scale[i] : 0.0f;
+        packed.pos[i] = static_cast<uint16_t>(std::lround(std::clamp(normalized, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    // A missing normal is stored as +z, the octahedron's origin
+    packed.normal = glm::packSnorm2x16(encodeOctahedral(glm::vec3(vertex.normal[0], vertex.normal[1], vertex.normal[2])));
+    packed.uv = glm::packHalf2x16(glm::vec2(vertex.uv[0], vertex.uv[1]));
+
+    for (int i = 0; i < 3; i++) {
+        packed.color[i] = toUnorm8(vertex.color[i]);
+    }
+    packed.color[3] = 255;
+
+    return packed;
+}
+
+GpuVertex toGpuVertex(const Vertex& vertex, const VertexQuantization& quantization) {
+#if VERTEX_FORMAT_PACKED
+    return packVertex(vertex, quantization);
+#else
+    (void)quantization;
+    return vertex;
+#endif
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Vertex layout used in GPU vertex buffers, chosen at compile time:
+//   0 - Vertex as is, 44 bytes of floats (Shaders/shader.vert)
+//   1 - PackedVertex, 20 bytes, quantized on upload (Shaders/shader_packed.vert)
+#define VERTEX_FORMAT_PACKED 1
+
+// Full precision vertex, used for everything done on the CPU
+struct Vertex {
+    float pos[3];      // x, y, z
+    float color[3];    // r, g, b
+    float normal[3];   // x, y, z, all zero when the source has none
+    float uv[2];       // u, v
+};
+
+// Quantized vertex. Everything except the normal is expanded to float by the vertex input stage;
+// the shader only has to rescale the position and unfold the normal.
+struct PackedVertex {
+    uint16_t pos[4];     // unorm16 inside the mesh bounds, w unused
+    uint32_t normal;     // octahedral, 2 x snorm16 (glm::packSnorm2x16)
+    uint32_t uv;         // 2 x half (glm::packHalf2x16)
+    uint8_t color[4];    // unorm8 r, g, b, a
+};
+
+// ---- Vertex layout reflection ----
+// Each vertex struct lists its fields once, in shader location order, in a VertexLayout specialization.
+// The Vulkan binding and attribute descriptions are built from that list at compile time.
+
+struct VertexField {
+    uint32_t offset;
+    uint32_t size;
+    VkFormat format;
+};
+
+#define VERTEX_FIELD(type, member, format) VertexField{ offsetof(type, member), sizeof(type::member), format }
+
+template <typename T>
+struct VertexLayout;
+
+template <>
+struct VertexLayout<Vertex> {
+    static constexpr std::array fields = {
+        VERTEX_FIELD(Vertex, pos, VK_FORMAT_R32G32B32_SFLOAT),       // location 0, vec3
+        VERTEX_FIELD(Vertex, color, VK_FORMAT_R32G32B32_SFLOAT),     // location 1, vec3
+        VERTEX_FIELD(Vertex, normal, VK_FORMAT_R32G32B32_SFLOAT),    // location 2, vec3
+        VERTEX_FIELD(Vertex, uv, VK_FORMAT_R32G32_SFLOAT),           // location 3, vec2
+    };
+};
+
+template <>
+struct VertexLayout<PackedVertex> {
+    static constexpr std::array fields = {
+        VERTEX_FIELD(PackedVertex, pos, VK_FORMAT_R16G16B16A16_UNORM),  // location 0, vec4
+        VERTEX_FIELD(PackedVertex, color, VK_FORMAT_R8G8B8A8_UNORM),    // location 1, vec4
+        VERTEX_FIELD(PackedVertex, normal, VK_FORMAT_R16G16_SNORM),     // location 2, vec2 (octahedral)
+        VERTEX_FIELD(PackedVertex, uv, VK_FORMAT_R16G16_SFLOAT),        // location 3, vec2
+    };
+};
+
+// Bytes per element of the formats vertex fields may use; 0 for anything else
+constexpr uint32_t vertexFormatSize(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R16G16_UNORM:
+    case VK_FORMAT_R16G16_SNORM:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R32_SFLOAT:
+        return 4;
+    case VK_FORMAT_R16G16B16A16_UNORM:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32G32_SFLOAT:
+        return 8;
+    case VK_FORMAT_R32G32B32_SFLOAT:
+        return 12;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+// Bytes per component, which is the alignment the format needs
+constexpr uint32_t vertexFormatComponentSize(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        return 1;
+    case VK_FORMAT_R16G16_UNORM:
+    case VK_FORMAT_R16G16_SNORM:
+    case VK_FORMAT_R16G16_SFLOAT:
+    case VK_FORMAT_R16G16B16A16_UNORM:
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+// Every field has a known format of exactly its own size, sits on a component boundary
+// (and a 4 byte one, which is what the vertex fetch hardware reads), and fields do not overlap
+template <typename T>
+constexpr bool isValidVertexLayout() {
+    constexpr auto& fields = VertexLayout<T>::fields;
+
+    if (sizeof(T) % 4 != 0) return false;
+
+    for (size_t i = 0; i < fields.size(); i++) {
+        uint32_t size = vertexFormatSize(fields[i].format);
+        if (size == 0 || size != fields[i].size) return false;
+        if (fields[i].offset % vertexFormatComponentSize(fields[i].format) != 0 || fields[i].offset % 4 != 0) return false;
+        if (fields[i].offset + size > sizeof(T)) return false;
+
+        for (size_t j = 0; j < i; j++) {
+            if (fields[i].offset < fields[j].offset + fields[j].size && fields[j].offset < fields[i].offset + fields[i].size) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(isValidVertexLayout<Vertex>(), "Vertex layout does not match its fields");
+static_assert(isValidVertexLayout<PackedVertex>(), "PackedVertex layout does not match its fields");
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex should stay 20 bytes");
+
+template <typename T, uint32_t Binding = 0>
+constexpr VkVertexInputBindingDescription vertexBindingDescription = {
+    Binding,                        // binding
+    sizeof(T),                      // stride
+    VK_VERTEX_INPUT_RATE_VERTEX,    // inputRate
+};
+
+// Field i of VertexLayout<T> feeds shader location i
+template <typename T, uint32_t Binding = 0>
+constexpr auto vertexAttributeDescriptions = [] {
+    constexpr auto& fields = VertexLayout<T>::fields;
+
+    std::array<VkVertexInputAttributeDescription, fields.size()> attributes{};
+    for (size_t i = 0; i < fields.size(); i++) {
+        attributes[i].location = static_cast<uint32_t>(i);
+        attributes[i].binding = Binding;
+        attributes[i].format = fields[i].format;
+        attributes[i].offset = fields[i].offset;
+    }
+    return attributes;
+}();
+
+// Maps unorm positions back into object space: pos = quantized * scale + offset
+struct VertexQuantization {
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+#if VERTEX_FORMAT_PACKED
+using GpuVertex = PackedVertex;
+#define VERTEX_SHADER_PATH "Shaders/shader_packed.vert.spv"
+#else
+using GpuVertex = Vertex;
+#define VERTEX_SHADER_PATH "Shaders/shader.vert.spv"
+#endif
+
+// Quantization covering the box from minPosition to maxPosition
+VertexQuantization computeVertexQuantization(glm::vec3 minPosition, glm::vec3 maxPosition);
+
+PackedVertex packVertex(const Vertex& vertex, const VertexQuantization& quantization);
+
+// Converts to the compiled-in GPU layout; the quantization is ignored by the float layout
+GpuVertex toGpuVertex(const Vertex& vertex, const VertexQuantization& quantization);
@@ -9,22 +9,66 @@
 #include <set>
 #include <optional>
 #include <array>
-#include <fstream>
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "MappedFile.h"
+#include "VulkanCore.h"
+#include "Mesh.h"
+#include "StreamingObjImporter.h"
+#include "TransformKernels.h"
+#include "UniformRing.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "AssetLoader.h"
+#include "PipelineCompiler.h"
+#include "Profiler.h"
+#include "GpuProfiler.h"
+#include "MemoryBudget.h"
+#include "HostAllocator.h"
+#include "Replay.h"
+#include "Readback.h"
+#include "BatchManifest.h"
+#include "DynamicResolution.h"
+#include "HiZCuller.h"
+#include "SoftwareOcclusionCuller.h"
 
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 
+// OBJ files above this size are streamed to the GPU instead of being loaded and optimized in memory
+#define MODEL_STREAMING_THRESHOLD (256ull * 1024 * 1024)
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-struct PushConstants {
-    glm::mat4 model;
+// Pipeline cache file kept between runs, relative to the working directory
+#define PIPELINE_CACHE_PATH "pipeline_cache.bin"
+
+// Bytes of per-frame uniform data each frame in flight may allocate
+#define UNIFORM_RING_SIZE (64 * 1024)
+
+// Bytes of CPU scratch memory each frame in flight may allocate
+#define FRAME_ARENA_SIZE (1024 * 1024)
+
+// std140 uniform block Frame in the vertex shaders, written once per frame
+struct FrameUniforms {
     glm::mat4 view;
     glm::mat4 proj;
 };
 
+// std140 uniform block Object in the vertex shaders, written once per drawn mesh
+struct ObjectUniforms {
+    glm::mat4 model;
+    glm::vec4 positionScale;    // VertexQuantization of the mesh being drawn
+    glm::vec4 positionOffset;
+};
+
 void drawFrame();
 
 void initWindow();
@@ -34,21 +78,51 @@ void setupDebugMessenger();
 void createSurface();
 void pickPhysicalDevice();
 void createLogicalDevice();
+void createMemoryBudget();
 void createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
 void createImageViews();
+VkFormat findDepthFormat();
 void createDepthResources();
+void createDynamicResolution();
+void createSceneColorResources();
+void destroySceneColorResources();
+void createDescriptorSetLayout();
 void createGraphicsPipeline();
+VkPipeline buildGraphicsPipeline(uint32_t variant, VkPipelineCache cache, VkGraphicsPipelineLibraryFlagsEXT parts);
 void createVertexBuffer();
+void createAssetLoader();
+void loadModel();
+void createUniformRing();
+void createDescriptorSet();
+void writeDescriptorSet();
 void createCommandPool();
 void createCommandBuffers();
+void createGpuProfiler();
+void createHiZCuller();
+void createSoftwareOcclusionCuller();
+void createReadback();
 void createSyncObjects();
 
-uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-
 void mainLoop();
+void runBatch();
 
 void cleanup();
 
+// Worker threads for mesh processing and other CPU-heavy work; the thread running main() is its main thread
+JobSystem jobSystem;
+
+// Every device memory allocation, by category, against the heap budgets
+MemoryBudget memoryBudget;
+bool memoryBudgetEnabled = false;   // VK_EXT_memory_budget
+
+// The driver's host allocations, by allocation scope and per frame
+HostAllocator hostAllocator;
+#if HOST_ALLOCATOR_ENABLED
+const VkAllocationCallbacks* hostAllocationCallbacks = hostAllocator.callbacks();
+#else
+const VkAllocationCallbacks* hostAllocationCallbacks = nullptr;
+#endif
+
 GLFWwindow* window;
 VkInstance instance;
 
@@ -64,6 +138,7 @@ VkDevice device;
 // End up being the same queue
 VkQueue graphicsQueue;
 VkQueue presentQueue;
+VkQueue transferQueue;
 
 
 VkSwapchainKHR swapChain;
@@ -73,17 +148,82 @@ VkExtent2D swapchainExtent;
 
 std::vector<VkImageView> swapchainImageViews;
 
+VkDescriptorSetLayout descriptorSetLayout;
 VkPipelineLayout pipelineLayout;
-VkPipeline graphicsPipeline;
+
+// Graphics pipeline variants, compiled in the background through an on-disk pipeline cache
+PipelineCompiler pipelineCompiler;
+bool graphicsPipelineLibraryEnabled = false;   // VK_EXT_graphics_pipeline_library with fast linking
+VkFormat pipelineColorFormat;
+VkFormat pipelineDepthFormat;
+
+// Materials of every loaded mesh, bound once as a storage buffer
+MaterialTable materialTable;
+VkDescriptorPool descriptorPool;
+VkDescriptorSet descriptorSet;
+
+// Frame and object uniforms, bound through dynamic offsets into one persistently mapped buffer
+UniformRing uniformRing;
+
+// Debug-utils labels, timestamps and pipeline statistics per pass, read back a few frames late
+GpuProfiler gpuProfiler;
 
 VkBuffer vertexBuffer;
 VkDeviceMemory vertexBufferMemory;
+VertexQuantization vertexQuantization;
+
+// OBJ given on the command line, drawn instead of the cube once it has loaded
+const char* modelPath = nullptr;
+GpuMesh model{};
+
+// Decodes and uploads meshes on worker threads and the transfer queue
+AssetLoader assetLoader;
+MeshHandle modelHandle;
+bool modelLoading = false;
+
+// Records the inputs of every frame, or plays a recording back with a fixed timestep
+Replay replay;
+glm::vec3 cameraPosition(0.0f, 0.0f, 4.0f);
+glm::vec3 cameraTarget(0.0f);
+
+// Copies of the presented image, read back asynchronously: every frame into captureDirectory, or one on F12
+Readback readback;
+bool swapchainReadback = false;   // the swapchain images can be copied from
+const char* captureDirectory = nullptr;
+bool screenshotRequested = false;
+uint32_t screenshotCount = 0;
+uint64_t capturedFrameCount = 0;
 
 #define IMAGES_IN_FLIGHT 2
 VkImage depthImages[IMAGES_IN_FLIGHT];
 VkDeviceMemory depthImagesMemory[IMAGES_IN_FLIGHT];
 VkImageView depthImageViews[IMAGES_IN_FLIGHT];
 
+// With dynamic resolution the scene renders into the top-left corner of a swapchain-sized color target, at a scale
+// that follows the GPU time, and is upscaled into the swapchain image with a linear blit
+DynamicResolution dynamicResolution;
+bool swapchainBlit = false;            // the swapchain images can be blitted to
+double gpuBudgetMilliseconds = -1.0;   // --gpu-budget; negative for one refresh interval, 0 for no scaling
+VkImage sceneColorImages[IMAGES_IN_FLIGHT];
+VkDeviceMemory sceneColorImagesMemory[IMAGES_IN_FLIGHT];
+VkImageView sceneColorImageViews[IMAGES_IN_FLIGHT];
+
+// Two-phase occlusion culling of the model's subsets against a depth pyramid, drawn with vkCmdDrawIndexedIndirect
+HiZCuller hiZCuller;
+bool occlusionCullingEnabled = false;   // multiDrawIndirect, drawIndirectFirstInstance and a sampleable depth format
+
+// Without it, the subsets are culled on the CPU against the model's occluder, on worker threads
+SoftwareOcclusionCuller softwareOcclusionCuller;
+bool softwareOcclusionEnabled = false;
+
+// Batch mode renders the jobs of a manifest offscreen, with a hidden window, instead of running the main loop
+#define BATCH_LOAD_AHEAD 8   // meshes loading or loaded ahead of rendering
+const char* batchManifestPath = nullptr;
+const char* batchReportPath = "batch_report.csv";
+
+// Transient per-frame CPU allocations (draw lists, sort keys), rewound with the frame's fence
+FrameArena frameArena(FRAME_ARENA_SIZE, IMAGES_IN_FLIGHT);
+
 VkCommandPool commandPool;
 
 std::vector<VkCommandBuffer> commandBuffers;
@@ -98,16 +238,54 @@ uint32_t frameIndex = 0;
 
 bool updateSwapchain = false;
 
-PushConstants pc{};
+FrameUniforms frameUniforms{};
+ObjectUniforms objectUniforms{};
 
-int main()
+int main(int argc, char** argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-transforms") {
+        benchmarkTransformKernels(100000);
+        return 0;
+    }
+
+    // [--record file | --replay file] [--capture directory] [--batch manifest [--report file.csv]] [--gpu-budget ms]
+    // [model.obj]
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--record" && i + 1 < argc) recordPath = argv[++i];
+        else if (argument == "--replay" && i + 1 < argc) replayPath = argv[++i];
+        else if (argument == "--capture" && i + 1 < argc) captureDirectory = argv[++i];
+        else if (argument == "--batch" && i + 1 < argc) batchManifestPath = argv[++i];
+        else if (argument == "--report" && i + 1 < argc) batchReportPath = argv[++i];
+        else if (argument == "--gpu-budget" && i + 1 < argc) gpuBudgetMilliseconds = atof(argv[++i]);
+        else modelPath = argv[i];
+    }
+
+    // A replay loads the model it was recorded with unless told otherwise, and a recording notes the one it used
+    if (replayPath) {
+        replay.play(replayPath);
+        if (modelPath == nullptr && !replay.modelPath().empty()) modelPath = replay.modelPath().c_str();
+    }
+    else if (recordPath) {
+        replay.record(recordPath, modelPath ? modelPath : "");
+    }
+
+    PROFILE_THREAD_NAME("Main");
+    jobSystem.start();
+
 	initWindow();
 	initVulkan();
 
-	mainLoop();
+    if (batchManifestPath) runBatch();
+    else mainLoop();
 
 	cleanup();
+
+    jobSystem.stop();
+
+    PROFILE_WRITE_TRACE(PROFILER_TRACE_PATH);
 }
 
 int window_width = WINDOW_WIDTH;
@@ -119,11 +297,16 @@ void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
     window_height = height;
 }
 
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS) screenshotRequested = true;
+}
+
 void initWindow()
 {
 	glfwInit();
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    if (batchManifestPath) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Test", nullptr, nullptr);
 
@@ -132,26 +315,41 @@ void initWindow()
 	glfwMakeContextCurrent(window);
 
     glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    glfwSetKeyCallback(window, keyCallback);
 }
 
 void initVulkan()
 {
+	PROFILE_FUNCTION();
+
 	createInstance();
 	setupDebugMessenger();
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
+    createMemoryBudget();
 	createSwapchain();
 	createImageViews();
     createDepthResources();
+    createDynamicResolution();
+    createDescriptorSetLayout();
 	createGraphicsPipeline();
     createVertexBuffer();
+    createAssetLoader();
+    loadModel();
+    createUniformRing();
+    createDescriptorSet();
 	createCommandPool();
 	createCommandBuffers();
+    createGpuProfiler();
+    createHiZCuller();
+    createSoftwareOcclusionCuller();
+    createReadback();
 	createSyncObjects();
 }
 
 void createInstance() {
+	PROFILE_FUNCTION();
 
 	//Information about the application and the Vulkan API version we intend to use
     VkApplicationInfo appInfo{};
@@ -206,7 +404,7 @@ void createInstance() {
         createInfo.enabledLayerCount = 0;
     }
 
-    if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+    if (vkCreateInstance(&createInfo, hostAllocationCallbacks, &instance) != VK_SUCCESS) {
         throw std::runtime_error("failed to create Vulkan instance!");
     }
 
@@ -261,6 +459,8 @@ void DestroyDebugUtilsMessengerEXT(
 
 void setupDebugMessenger()
 {
+    PROFILE_FUNCTION();
+
 #ifdef NDEBUG
     return;
 #endif // NDEBUG
@@ -287,7 +487,7 @@ void setupDebugMessenger()
     if (CreateDebugUtilsMessengerEXT(
         instance,
         &createInfo,
-        nullptr,
+        hostAllocationCallbacks,
         &debugMessenger) != VK_SUCCESS)
     {
         throw std::runtime_error(
@@ -299,7 +499,9 @@ void setupDebugMessenger()
 
 void createSurface()
 {
-    if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
+    PROFILE_FUNCTION();
+
+    if (glfwCreateWindowSurface(instance, window, hostAllocationCallbacks, &surface) != VK_SUCCESS) {
         throw std::runtime_error("failed to create window surface!");
     }
 
@@ -309,15 +511,6 @@ void createSurface()
 
 
 
-struct QueueFamilyIndices {
-    std::optional<uint32_t> graphicsFamily;
-    std::optional<uint32_t> presentFamily;
-
-    bool isComplete() {
-        return graphicsFamily.has_value() && presentFamily.has_value();
-    }
-};
-
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
@@ -344,6 +537,20 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
     return required.empty();
 }
 
+// For optional extensions, enabled only when present
+bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* name) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for (const auto& ext : availableExtensions) {
+        if (strcmp(ext.extensionName, name) == 0) return true;
+    }
+    return false;
+}
+
 SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) {
     SwapChainSupportDetails details;
 
@@ -379,18 +586,20 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
 
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        if (!indices.graphicsFamily && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
             indices.graphicsFamily = i;
         }
 
         VkBool32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-        if (presentSupport) {
+        if (!indices.presentFamily && presentSupport) {
             indices.presentFamily = i;
         }
 
-        if (indices.isComplete()) {
-            break;
+        // Copies on a transfer-only family run on the DMA engines, alongside rendering
+        if (!indices.transferFamily && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            indices.transferFamily = i;
         }
 
         i++;
@@ -416,6 +625,8 @@ bool isDeviceSuitable(VkPhysicalDevice device) {
 
 void pickPhysicalDevice()
 {
+    PROFILE_FUNCTION();
+
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 
@@ -442,6 +653,8 @@ void pickPhysicalDevice()
 }
 
 void createLogicalDevice() {
+    PROFILE_FUNCTION();
+
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
     // 1 Describe the queues we want
@@ -450,6 +663,9 @@ void createLogicalDevice() {
         indices.graphicsFamily.value(),
         indices.presentFamily.value()
     };
+    if (indices.transferFamily) {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -461,12 +677,25 @@ void createLogicalDevice() {
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    // 2 Specify device features we want (none for now)
+    // 2 Specify device features we want (pipeline statistics queries if there are any, see below)
     VkPhysicalDeviceFeatures deviceFeatures{};
 
 
+    // Optional: graphics pipeline libraries, used only if linking them is fast
+    bool pipelineLibrarySupported =
+        isDeviceExtensionSupported(physicalDevice, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+        isDeviceExtensionSupported(physicalDevice, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+    pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.pNext = pipelineLibrarySupported ? &pipelineLibraryFeatures : nullptr;
+
     VkPhysicalDeviceSynchronization2Features sync2Features{};
     sync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+    sync2Features.pNext = &timelineFeatures;
 
     VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeature{};
     dynamicRenderingFeature.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
@@ -486,6 +715,38 @@ void createLogicalDevice() {
         throw std::runtime_error("Sync 2 not supported on this GPU!");
     }
 
+    if (!timelineFeatures.timelineSemaphore) {
+        throw std::runtime_error("Timeline semaphores not supported on this GPU!");
+    }
+
+    // Optional: per-heap budgets from the driver
+    memoryBudgetEnabled = isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    // Optional: invocation counts for GPU profiling
+    deviceFeatures.pipelineStatisticsQuery = features2.features.pipelineStatisticsQuery;
+
+    // Optional: occlusion culling draws each pipeline's run with one indirect call, the material index in firstInstance,
+    // and reads the depth image back in a compute shader
+    VkFormatProperties depthProps;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, findDepthFormat(), &depthProps);
+    occlusionCullingEnabled = HIZ_CULLING_ENABLED && features2.features.multiDrawIndirect &&
+        features2.features.drawIndirectFirstInstance &&
+        (depthProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+    deviceFeatures.multiDrawIndirect = occlusionCullingEnabled;
+    deviceFeatures.drawIndirectFirstInstance = occlusionCullingEnabled;
+
+    if (pipelineLibrarySupported && pipelineLibraryFeatures.graphicsPipelineLibrary) {
+        VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT pipelineLibraryProperties{};
+        pipelineLibraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &pipelineLibraryProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+        graphicsPipelineLibraryEnabled = pipelineLibraryProperties.graphicsPipelineLibraryFastLinking;
+    }
+
     // 3 Create the logical device
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -494,24 +755,57 @@ void createLogicalDevice() {
     createInfo.pEnabledFeatures = &deviceFeatures;
 
     // 4 Enable device extensions
-    const std::vector<const char*> deviceExtensions = {
+    std::vector<const char*> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
+    if (memoryBudgetEnabled) {
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+    if (graphicsPipelineLibraryEnabled) {
+        deviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+    }
+    else {
+        timelineFeatures.pNext = nullptr;
+    }
     createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     createInfo.ppEnabledExtensionNames = deviceExtensions.data();
     createInfo.pNext = &dynamicRenderingFeature;
 
-    if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+    if (vkCreateDevice(physicalDevice, &createInfo, hostAllocationCallbacks, &device) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device!");
     }
 
     // 6 Retrieve the queues
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    if (indices.transferFamily) {
+        vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+    }
+    else {
+        transferQueue = graphicsQueue;
+    }
 
     std::cout << "Logical device and queues created successfully!\n";
 }
 
+// Residency policy. Nothing the renderer holds can be evicted yet, so for now it only reports
+// where the memory went, which is what the next allocation failure would need to be understood.
+void onMemoryPressure(uint32_t heapIndex, const MemoryHeapStats& heap, VkDeviceSize requested) {
+    std::cerr << "Memory heap " << heapIndex << " under pressure: " << heap.usage << " of " << heap.budget << " bytes used";
+    if (requested > 0) std::cerr << ", " << requested << " more requested";
+    std::cerr << "\n";
+
+    if (jobSystem.isMainThread()) memoryBudget.report();
+}
+
+void createMemoryBudget() {
+    PROFILE_FUNCTION();
+
+    memoryBudget.create(memoryBudgetEnabled);
+    memoryBudget.setPressureCallback(onMemoryPressure);
+}
+
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
     // Prefer 8-bit SRGB color
     for (const auto& availableFormat : availableFormats) {
@@ -566,6 +860,8 @@ VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
 }
 
 void createSwapchain(VkSwapchainKHR oldSwapchain) {
+    PROFILE_FUNCTION();
+
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
     // 1 Choose the best surface format
@@ -592,6 +888,14 @@ void createSwapchain(VkSwapchainKHR oldSwapchain) {
     createInfo.imageArrayLayers = 1;  // 1 for normal images
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+    // Readback copies straight out of the swapchain image when the surface allows it
+    swapchainReadback = swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    if (swapchainReadback) createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+    // Dynamic resolution upscales into the swapchain image with a blit
+    swapchainBlit = swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (swapchainBlit) createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
     // Handle different queue families
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
     uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
@@ -613,7 +917,7 @@ void createSwapchain(VkSwapchainKHR oldSwapchain) {
     createInfo.clipped = VK_TRUE;
     createInfo.oldSwapchain = oldSwapchain;  // for resizing
 
-    if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
+    if (vkCreateSwapchainKHR(device, &createInfo, hostAllocationCallbacks, &swapChain) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
     }
 
@@ -629,6 +933,8 @@ void createSwapchain(VkSwapchainKHR oldSwapchain) {
 }
 
 void createImageViews() {
+    PROFILE_FUNCTION();
+
     swapchainImageViews.resize(swapchainImages.size());
 
     for (size_t i = 0; i < swapchainImages.size(); i++) {
@@ -651,7 +957,7 @@ void createImageViews() {
         createInfo.subresourceRange.baseArrayLayer = 0;
         createInfo.subresourceRange.layerCount = 1;
 
-        if (vkCreateImageView(device, &createInfo, nullptr, &swapchainImageViews[i]) != VK_SUCCESS) {
+        if (vkCreateImageView(device, &createInfo, hostAllocationCallbacks, &swapchainImageViews[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image views!");
         }
     }
@@ -677,6 +983,8 @@ VkFormat findDepthFormat() {
 
 void createDepthResources()
 {
+	PROFILE_FUNCTION();
+
 	VkFormat depthFormat = findDepthFormat();
 
     for (size_t i = 0; i < IMAGES_IN_FLIGHT; i++)
@@ -692,11 +1000,12 @@ void createDepthResources()
         depthImageInfo.format = depthFormat;
         depthImageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         depthImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depthImageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        depthImageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+            (occlusionCullingEnabled ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
         depthImageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         depthImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        vkCreateImage(device, &depthImageInfo, nullptr, &depthImages[i]);
+        vkCreateImage(device, &depthImageInfo, hostAllocationCallbacks, &depthImages[i]);
 
         VkMemoryRequirements memRequirements;
         vkGetImageMemoryRequirements(device, depthImages[i], &memRequirements);
@@ -707,7 +1016,7 @@ void createDepthResources()
         allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-        vkAllocateMemory(device, &allocInfo, nullptr, &depthImagesMemory[i]);
+        depthImagesMemory[i] = memoryBudget.allocate(allocInfo, MemoryCategory::Attachment);
         vkBindImageMemory(device, depthImages[i], depthImagesMemory[i], 0);
 
         VkImageViewCreateInfo depthImageViewInfo{};
@@ -721,60 +1030,101 @@ void createDepthResources()
         depthImageViewInfo.subresourceRange.baseArrayLayer = 0;
         depthImageViewInfo.subresourceRange.layerCount = 1;
 
-        VkResult result = vkCreateImageView(device, &depthImageViewInfo, nullptr, &depthImageViews[i]);
+        VkResult result = vkCreateImageView(device, &depthImageViewInfo, hostAllocationCallbacks, &depthImageViews[i]);
     }
     std::cout << "Depth resources created successfully!\n";
 }
 
+void createDynamicResolution() {
+    PROFILE_FUNCTION();
 
-std::vector<char> readFile(const std::string& filename) {
-    // Open file at the end to get size
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    // Batch jobs and replays render at full resolution unless a budget is given: their images and GPU timings
+    // should not depend on how fast the machine is
+    double budget = gpuBudgetMilliseconds;
+    if (budget < 0.0) {
+        const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+        bool fixedResolution = batchManifestPath || replay.mode() == ReplayMode::Replay;
+        budget = fixedResolution || !mode || mode->refreshRate <= 0 ? 0.0 : 1000.0 / mode->refreshRate;
+    }
 
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file: " + filename);
+    // The blit reads the scene color target and writes the swapchain image, both in the swapchain format
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, swapchainImageFormat, &props);
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT;
+    if (budget > 0.0 && (!swapchainBlit || (props.optimalTilingFeatures & required) != required)) {
+        std::cerr << "The swapchain images cannot be blitted to; dynamic resolution is disabled\n";
+        budget = 0.0;
     }
 
-    size_t fileSize = (size_t)file.tellg();  // current position = size
-    std::vector<char> buffer(fileSize);
+    dynamicResolution.create(budget);
+    if (dynamicResolution.enabled()) createSceneColorResources();
+}
 
-    file.seekg(0);                            // go back to beginning
-    file.read(buffer.data(), fileSize);
+void createSceneColorResources() {
+    PROFILE_FUNCTION();
 
-    file.close();
-    return buffer;
-}
+    for (size_t i = 0; i < IMAGES_IN_FLIGHT; i++)
+    {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = swapchainExtent.width;
+        imageInfo.extent.height = swapchainExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = swapchainImageFormat;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(device, &imageInfo, hostAllocationCallbacks, &sceneColorImages[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create scene color image!");
+        }
 
-struct Vertex {
-    float pos[3];      // x, y
-    float color[3];    // r, g, b
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, sceneColorImages[i], &memRequirements);
 
-    static VkVertexInputBindingDescription getBindingDescription() {
-        VkVertexInputBindingDescription binding{};
-        binding.binding = 0;                  // Vertex buffer binding index
-        binding.stride = sizeof(Vertex);     // Size of one vertex
-        binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        return binding;
-    }
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 2> attributes{};
+        sceneColorImagesMemory[i] = memoryBudget.allocate(allocInfo, MemoryCategory::Attachment);
+        vkBindImageMemory(device, sceneColorImages[i], sceneColorImagesMemory[i], 0);
 
-        // Position
-        attributes[0].binding = 0;
-        attributes[0].location = 0;                 // matches shader location
-        attributes[0].format = VK_FORMAT_R32G32B32_SFLOAT; // vec2
-        attributes[0].offset = offsetof(Vertex, pos);
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = sceneColorImages[i];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = swapchainImageFormat;
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
-        // Color
-        attributes[1].binding = 0;
-        attributes[1].location = 1;                 // matches shader location
-        attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT; // vec3
-        attributes[1].offset = offsetof(Vertex, color);
+        if (vkCreateImageView(device, &viewInfo, hostAllocationCallbacks, &sceneColorImageViews[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create scene color image view!");
+        }
+    }
+    std::cout << "Scene color resources created successfully!\n";
+}
 
-        return attributes;
+void destroySceneColorResources() {
+    for (size_t i = 0; i < IMAGES_IN_FLIGHT; i++)
+    {
+        vkDestroyImageView(device, sceneColorImageViews[i], hostAllocationCallbacks);
+        vkDestroyImage(device, sceneColorImages[i], hostAllocationCallbacks);
+        memoryBudget.free(sceneColorImagesMemory[i]);
     }
-};
+}
+
+
+MappedFile readFile(const std::string& filename) {
+    // Map the file instead of copying it into a buffer
+    return MappedFile(filename);
+}
 
 
 std::vector<Vertex> vertices = {
@@ -822,43 +1172,113 @@ std::vector<Vertex> vertices = {
     {{ -1.0f,  1.0f, -1.0f, }, 	{0.0f, 1.f, 1.0f}},
 };
 
-VkShaderModule createShaderModule(const std::vector<char>& code) {
+VkShaderModule createShaderModule(const MappedFile& code) {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     createInfo.codeSize = code.size();
     createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
     VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+    if (vkCreateShaderModule(device, &createInfo, hostAllocationCallbacks, &shaderModule) != VK_SUCCESS) {
         throw std::runtime_error("failed to create shader module!");
     }
     return shaderModule;
 }
 
+void createDescriptorSetLayout() {
+    PROFILE_FUNCTION();
+
+    // Binding 0: the material table, indexed with the instance index
+    VkDescriptorSetLayoutBinding materialBinding{};
+    materialBinding.binding = 0;
+    materialBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    materialBinding.descriptorCount = 1;
+    materialBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // Bindings 1 and 2: frame and object uniforms in the uniform ring, located by dynamic offsets at bind time
+    VkDescriptorSetLayoutBinding frameBinding{};
+    frameBinding.binding = 1;
+    frameBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    frameBinding.descriptorCount = 1;
+    frameBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding objectBinding = frameBinding;
+    objectBinding.binding = 2;
+
+    VkDescriptorSetLayoutBinding bindings[] = { materialBinding, frameBinding, objectBinding };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocationCallbacks, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    std::cout << "Descriptor set layout created successfully!\n";
+}
+
 void createGraphicsPipeline() {
-    auto vertShaderCode = readFile("Shaders/shader.vert.spv"); // load compiled SPIR-V
-    auto fragShaderCode = readFile("Shaders/shader.frag.spv");
+    PROFILE_FUNCTION();
 
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+    // Pipeline layout (material table + frame and object uniforms)
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
 
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocationCallbacks, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    // Swapchain recreation rewrites swapchainImageFormat, so the compile jobs read a copy
+    pipelineColorFormat = swapchainImageFormat;
+    pipelineDepthFormat = findDepthFormat();
+
+    // The pipelines themselves compile on worker threads; frames skip draws until theirs is ready
+    pipelineCompiler.create(buildGraphicsPipeline, pipelineLayout, PIPELINE_CACHE_PATH, graphicsPipelineLibraryEnabled);
+    pipelineCompiler.request(0);
+    pipelineCompiler.request(PIPELINE_VARIANT_BLEND);
 
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
+    std::cout << "Graphics pipeline compilation started!\n";
+}
+
+// Runs on a worker thread, so it reads nothing the main thread writes while pipelines compile
+VkPipeline buildGraphicsPipeline(uint32_t variant, VkPipelineCache cache, VkGraphicsPipelineLibraryFlagsEXT parts) {
+    // A pipeline library only carries the shader stages of its own parts; a complete pipeline (parts 0) has both
+    bool withVertexShader = parts == 0 || (parts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+    bool withFragmentShader = parts == 0 || (parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+
+    VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+
+    if (withVertexShader) {
+        vertShaderModule = createShaderModule(readFile(VERTEX_SHADER_PATH)); // load compiled SPIR-V
+
+        VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vertShaderStageInfo.module = vertShaderModule;
+        vertShaderStageInfo.pName = "main";
+        shaderStages.push_back(vertShaderStageInfo);
+    }
 
-    VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+    if (withFragmentShader) {
+        fragShaderModule = createShaderModule(readFile("Shaders/shader.frag.spv"));
+
+        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        fragShaderStageInfo.module = fragShaderModule;
+        fragShaderStageInfo.pName = "main";
+        shaderStages.push_back(fragShaderStageInfo);
+    }
 
     // Vertex input
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    auto bindingDescription = vertexBindingDescription<GpuVertex>;
+    auto attributeDescriptions = vertexAttributeDescriptions<GpuVertex>;
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -883,25 +1303,13 @@ void createGraphicsPipeline() {
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
-    // Viewport / scissor
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(swapchainExtent.width);
-    viewport.height = static_cast<float>(swapchainExtent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = swapchainExtent;
-
+    // Viewport / scissor, both dynamic
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-	viewportState.pViewports = nullptr; //&viewport; using dynamic viewport
+	viewportState.pViewports = nullptr; // using dynamic viewport
     viewportState.scissorCount = 1;
-    viewportState.pScissors = nullptr; //&scissor; using dynamic scissor
+    viewportState.pScissors = nullptr; // using dynamic scissor
 
     // Rasterizer
     VkPipelineRasterizationStateCreateInfo rasterizer{};
@@ -928,6 +1336,17 @@ void createGraphicsPipeline() {
         VK_COLOR_COMPONENT_A_BIT;
     colorBlendAttachment.blendEnable = VK_FALSE;
 
+    // Transparent materials blend over what is behind them instead of hiding it
+    if (variant & PIPELINE_VARIANT_BLEND) {
+        colorBlendAttachment.blendEnable = VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+
     VkPipelineColorBlendStateCreateInfo colorBlending{};
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
@@ -944,27 +1363,15 @@ void createGraphicsPipeline() {
     depthStencil.depthBoundsTestEnable = VK_FALSE;
     depthStencil.stencilTestEnable = VK_FALSE;
 
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // stage(s) using the push constant
-    pushConstantRange.offset = 0;                               // start byte in the block
-    pushConstantRange.size = sizeof(PushConstants);
-
-    // Pipeline layout (no uniforms for now)
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
+    if (variant & PIPELINE_VARIANT_BLEND) {
+        depthStencil.depthWriteEnable = VK_FALSE;
     }
 
     // Create graphics pipeline
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &inputAssembly;
     pipelineInfo.pViewportState = &viewportState;
@@ -981,84 +1388,171 @@ void createGraphicsPipeline() {
     VkPipelineRenderingCreateInfo pipelineRenderingInfo{};
     pipelineRenderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
     pipelineRenderingInfo.colorAttachmentCount = 1;
-    pipelineRenderingInfo.pColorAttachmentFormats = &swapchainImageFormat;
-    pipelineRenderingInfo.depthAttachmentFormat = findDepthFormat();
+    pipelineRenderingInfo.pColorAttachmentFormats = &pipelineColorFormat;
+    pipelineRenderingInfo.depthAttachmentFormat = pipelineDepthFormat;
     //pipelineRenderingInfo.stencilAttachmentFormat = findDepthFormat();
 
     pipelineInfo.pNext = &pipelineRenderingInfo;
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
-    }
+    // State outside the requested parts is ignored when building a library
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+    libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+    libraryInfo.flags = parts;
 
-    // Cleanup shader modules
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    if (parts != 0) {
+        pipelineRenderingInfo.pNext = &libraryInfo;
+        pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+    }
 
-    std::cout << "Graphics pipeline created successfully!\n";
-}
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, hostAllocationCallbacks, &pipeline);
 
-uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    // Cleanup shader modules
+    vkDestroyShaderModule(device, fragShaderModule, hostAllocationCallbacks);
+    vkDestroyShaderModule(device, vertShaderModule, hostAllocationCallbacks);
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
     }
 
-    throw std::runtime_error("failed to find suitable memory type!");
+    return pipeline;
 }
 
-void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-    VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = usage;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+void createVertexBuffer() {
+    PROFILE_FUNCTION();
 
-    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create buffer!");
-    }
+    vertexQuantization = computeVertexQuantization(glm::vec3(-1.0f), glm::vec3(1.0f));
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate buffer memory!");
+    std::vector<GpuVertex> gpuVertices;
+    for (const Vertex& vertex : vertices) {
+        gpuVertices.push_back(toGpuVertex(vertex, vertexQuantization));
     }
 
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
-}
-
-void createVertexBuffer() {
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+    VkDeviceSize bufferSize = sizeof(gpuVertices[0]) * gpuVertices.size();
 
     // Create buffer with vertex usage and CPU-visible memory
     createBuffer(bufferSize,
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
         vertexBuffer,
-        vertexBufferMemory);
+        vertexBufferMemory,
+        MemoryCategory::Vertex);
 
     // Map memory and copy data
     void* data;
     vkMapMemory(device, vertexBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
+    memcpy(data, gpuVertices.data(), static_cast<size_t>(bufferSize));
     vkUnmapMemory(device, vertexBufferMemory);
 
     std::cout << "Vertex buffer created and triangle data uploaded!\n";
 }
 
+void loadModel() {
+    PROFILE_FUNCTION();
+
+    if (modelPath == nullptr) return;
+
+    if (std::filesystem::file_size(modelPath) > MODEL_STREAMING_THRESHOLD) {
+        // Streamed through a staging ring straight into device-local memory
+        model = streamObjToDevice(modelPath);
+    }
+    else {
+        // Loaded in the background; the cube is drawn until it is ready
+        modelHandle = assetLoader.loadMesh(modelPath);
+        modelLoading = true;
+    }
+}
+
+void createAssetLoader() {
+    PROFILE_FUNCTION();
+
+    assetLoader.create();
+
+    QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    if (indices.transferFamily) {
+        std::cout << "Asset loader created successfully (transfer queue family " << indices.transferFamily.value() << ")!\n";
+    }
+    else {
+        std::cout << "Asset loader created successfully (no transfer-only queue family, uploading on the graphics queue)!\n";
+    }
+}
+
+void createUniformRing() {
+    PROFILE_FUNCTION();
+
+    uniformRing.create(UNIFORM_RING_SIZE, IMAGES_IN_FLIGHT);
+
+    std::cout << "Uniform ring created successfully (" << IMAGES_IN_FLIGHT << " x " << UNIFORM_RING_SIZE
+        << " bytes, " << uniformRing.alignment() << " byte alignment)!\n";
+}
+
+void createDescriptorSet() {
+    PROFILE_FUNCTION();
+
+    materialTable.upload();
+
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = 1;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[1].descriptorCount = 2;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, hostAllocationCallbacks, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor set!");
+    }
+
+    writeDescriptorSet();
+
+    std::cout << "Material table uploaded (" << materialTable.size() << " materials)!\n";
+}
+
+// Points descriptorSet at the material table and the uniform ring; again whenever the table is reallocated
+void writeDescriptorSet() {
+    VkDescriptorBufferInfo bufferInfos[3]{};
+    bufferInfos[0].buffer = materialTable.buffer();
+    bufferInfos[0].offset = 0;
+    bufferInfos[0].range = VK_WHOLE_SIZE;
+
+    // The ring descriptors start at 0 and cover one block; the dynamic offsets pick the allocation
+    bufferInfos[1].buffer = uniformRing.buffer();
+    bufferInfos[1].offset = 0;
+    bufferInfos[1].range = sizeof(FrameUniforms);
+    bufferInfos[2].buffer = uniformRing.buffer();
+    bufferInfos[2].offset = 0;
+    bufferInfos[2].range = sizeof(ObjectUniforms);
+
+    VkWriteDescriptorSet writes[3]{};
+    for (uint32_t i = 0; i < 3; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+}
+
 void createCommandPool() {
+    PROFILE_FUNCTION();
+
     QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
     VkCommandPoolCreateInfo poolInfo{};
@@ -1066,7 +1560,7 @@ void createCommandPool() {
     poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    if (vkCreateCommandPool(device, &poolInfo, hostAllocationCallbacks, &commandPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
 
@@ -1074,6 +1568,8 @@ void createCommandPool() {
 }
 
 void createCommandBuffers() {
+    PROFILE_FUNCTION();
+
     commandBuffers.resize(IMAGES_IN_FLIGHT);
 
     VkCommandBufferAllocateInfo allocInfo{};
@@ -1087,8 +1583,132 @@ void createCommandBuffers() {
     }
 }
 
+// Steps 3 and 4 of recordCommandBuffer: viewport, vertex buffer and uniforms for mesh, or the cube while it has
+// no indices, with frameUniforms and objectUniforms. Stays bound across rendering instances and compute dispatches.
+void bindSceneState(VkCommandBuffer commandBuffer, const GpuMesh& mesh, VkExtent2D extent)
+{
+    // ---- 3 Dynamic State (pipelines are bound per draw batch below) ----
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = { 0, 0 };
+    scissor.extent = extent;
+
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // ---- 4 Bind Vertex Buffer ----
+    VkBuffer vertexBuffers[] = { mesh.indexCount > 0 ? mesh.vertexBuffer : vertexBuffer };
+    VkDeviceSize offsets[] = { 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    if (mesh.indexCount > 0) vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+    const VertexQuantization& quantization = mesh.indexCount > 0 ? mesh.quantization : vertexQuantization;
+    objectUniforms.positionScale = glm::vec4(quantization.scale, 0.0f);
+    objectUniforms.positionOffset = glm::vec4(quantization.offset, 0.0f);
+
+    // One memcpy each into this frame's partition of the ring
+    uint32_t dynamicOffsets[] = {
+        static_cast<uint32_t>(uniformRing.push(frameUniforms).offset),
+        static_cast<uint32_t>(uniformRing.push(objectUniforms).offset)
+    };
+
+    vkCmdBindDescriptorSets(commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        pipelineLayout,
+        0,
+        1,
+        &descriptorSet,
+        2,
+        dynamicOffsets);
+}
+
+// The subsets of the LOD mesh needs at this extent, less those the software culler found hidden, sorted. The
+// pipeline variant leads the sort key, so the opaque draws come first and each variant is bound once.
+void buildSceneDrawItems(const GpuMesh& mesh, VkExtent2D extent, FrameVector<DrawItem>& drawItems)
+{
+    const MeshLod& lod = mesh.lods[selectMeshLod(mesh, objectUniforms.model, frameUniforms.view, frameUniforms.proj,
+        (float)extent.height)];
+    glm::mat4 modelView = frameUniforms.view * objectUniforms.model;
+
+    drawItems.reserve(lod.subsetCount);
+    for (uint32_t i = 0; i < lod.subsetCount; i++) {
+        if (!softwareOcclusionCuller.visible(mesh, lod.firstSubset + i)) continue;
+
+        const MeshSubset& subset = mesh.subsets[lod.firstSubset + i];
+        uint32_t variant = materialTable[subset.materialIndex].diffuse.a < 1.0f ? PIPELINE_VARIANT_BLEND : 0;
+        float viewDepth = -(modelView * glm::vec4((subset.boundsMin + subset.boundsMax) * 0.5f, 1.0f)).z;
+        drawItems.push_back({ makeDrawSortKey(variant, subset.materialIndex, viewDepth),
+            subset.indexOffset, subset.indexCount, subset.materialIndex, lod.firstSubset + i });
+    }
+    sortDrawItems(drawItems.data(), drawItems.size());
+}
+
+// ---- 5 Draw ----
+// Binds each pipeline once per run of draws. Without an indirect buffer every item is drawn directly; with one,
+// item i draws the VkDrawIndexedIndirectCommand at indirectOffset + i * its size, a whole run per call.
+void recordDrawItems(VkCommandBuffer commandBuffer, const DrawItem* drawItems, uint32_t count,
+    VkBuffer indirectBuffer = VK_NULL_HANDLE, VkDeviceSize indirectOffset = 0)
+{
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    uint32_t i = 0;
+    while (i < count) {
+        // A variant still compiling falls back to the opaque pipeline; with neither ready the draw is skipped
+        VkPipeline pipeline = pipelineCompiler.get(static_cast<uint32_t>(drawItems[i].sortKey >> 56));
+        if (pipeline == VK_NULL_HANDLE) pipeline = pipelineCompiler.get(0);
+        if (pipeline == VK_NULL_HANDLE) {
+            i++;
+            continue;
+        }
+
+        uint32_t runEnd = i + 1;
+        while (runEnd < count && drawItems[runEnd].sortKey >> 56 == drawItems[i].sortKey >> 56) runEnd++;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        if (indirectBuffer != VK_NULL_HANDLE) {
+            vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, indirectOffset + VkDeviceSize(i) * stride, runEnd - i, stride);
+        }
+        else {
+            for (uint32_t j = i; j < runEnd; j++) {
+                // firstInstance carries the material index to the shaders as gl_InstanceIndex
+                vkCmdDrawIndexed(commandBuffer, drawItems[j].indexCount, 1, drawItems[j].indexOffset, 0, drawItems[j].materialIndex);
+            }
+        }
+        i = runEnd;
+    }
+}
+
+// Steps 3 to 5 of recordCommandBuffer without GPU culling, inside rendering to an extent-sized target
+void recordSceneDraws(VkCommandBuffer commandBuffer, const GpuMesh& mesh, VkExtent2D extent)
+{
+    bindSceneState(commandBuffer, mesh, extent);
+
+    if (mesh.indexCount > 0) {
+        FrameVector<DrawItem> drawItems{ FrameAllocator<DrawItem>(frameArena) };
+        buildSceneDrawItems(mesh, extent, drawItems);
+        recordDrawItems(commandBuffer, drawItems.data(), static_cast<uint32_t>(drawItems.size()));
+    }
+    else if (VkPipeline pipeline = pipelineCompiler.get(0)) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        vkCmdDraw(commandBuffer,
+            static_cast<uint32_t>(vertices.size()),
+            1,
+            0,
+            0);
+    }
+}
+
 void recordCommandBuffer(int image_Index, int frame_Index)
 {
+    PROFILE_FUNCTION();
 
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -1097,6 +1717,72 @@ void recordCommandBuffer(int image_Index, int frame_Index)
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
+    // Results of this frame slot's previous use come back here, IMAGES_IN_FLIGHT frames late
+    gpuProfiler.beginFrame(commandBuffers[frame_Index], frame_Index);
+    gpuProfiler.beginPass(commandBuffers[frame_Index], "Uploads");
+
+    // The scene renders into the corner of its own target at the scale the latest GPU time calls for, or without
+    // dynamic resolution straight into the swapchain image
+    bool upscale = dynamicResolution.enabled();
+    if (upscale) dynamicResolution.update(gpuProfiler.frameMilliseconds());
+    VkExtent2D renderExtent = upscale ? dynamicResolution.renderExtent(swapchainExtent) : swapchainExtent;
+    VkImage colorImage = upscale ? sceneColorImages[frame_Index] : swapchainImages[image_Index];
+
+    // ---- 0 Pick up meshes whose background upload has finished ----
+    // The software culler reads the model until it has finished
+    softwareOcclusionCuller.finish();
+
+    // A replay swaps the model in on the frame the recording did, waiting for its upload if it is not there yet
+    assetLoader.update(commandBuffers[frame_Index], materialTable);
+    bool replaying = replay.mode() == ReplayMode::Replay;
+    bool replayModelReady = replaying && (replay.frame().events & REPLAY_EVENT_MODEL_READY);
+    if (modelLoading && replayModelReady) {
+        PROFILE_SCOPE("waitForReplayModel");
+        while (assetLoader.loading(modelHandle)) {
+            std::this_thread::yield();
+            assetLoader.update(commandBuffers[frame_Index], materialTable);
+        }
+    }
+    if (modelLoading && (!replaying || replayModelReady) && assetLoader.takeMesh(modelHandle, model)) {
+        modelLoading = false;
+        hiZCuller.resetVisibility();
+        softwareOcclusionCuller.discard();
+    }
+
+    if (!materialTable.recordUpdate(commandBuffers[frame_Index])) {
+        // The new materials outgrew the buffer: reallocating it is the one step that still stalls
+        vkDeviceWaitIdle(device);
+        materialTable.upload();
+        writeDescriptorSet();
+    }
+
+    gpuProfiler.endPass(commandBuffers[frame_Index]);
+
+    // ---- 0 Cull the subsets for the first phase ----
+    // The depth those drawn leave behind is what the others are tested against, in a second phase
+    bool occlusionCull = occlusionCullingEnabled && model.indexCount > 0;
+    FrameVector<DrawItem> drawItems{ FrameAllocator<DrawItem>(frameArena) };
+    uint32_t opaqueCount = 0;
+    if (occlusionCull) {
+        buildSceneDrawItems(model, renderExtent, drawItems);
+
+        FrameVector<CullObject> cullObjects{ FrameAllocator<CullObject>(frameArena) };
+        cullObjects.reserve(drawItems.size());
+        for (const DrawItem& draw : drawItems) {
+            const MeshSubset& subset = model.subsets[draw.subsetIndex];
+            bool opaque = (draw.sortKey >> 56) == 0;
+            if (opaque) opaqueCount++;
+            cullObjects.push_back({ subset.boundsMin, draw.subsetIndex, subset.boundsMax, opaque ? CULL_OBJECT_OPAQUE : 0u,
+                draw.indexCount, draw.indexOffset, draw.materialIndex, 0 });
+        }
+
+        gpuProfiler.beginPass(commandBuffers[frame_Index], "Early cull");
+        hiZCuller.cullEarly(commandBuffers[frame_Index], frame_Index,
+            frameUniforms.proj * frameUniforms.view * objectUniforms.model, renderExtent,
+            cullObjects.data(), static_cast<uint32_t>(cullObjects.size()), static_cast<uint32_t>(model.subsets.size()));
+        gpuProfiler.endPass(commandBuffers[frame_Index]);
+    }
+
     VkImageMemoryBarrier2 barriers[2];
     // ---- 1 Transition swapchain image layout ----
     VkImageMemoryBarrier2 swapchainbarrier{};
@@ -1105,7 +1791,7 @@ void recordCommandBuffer(int image_Index, int frame_Index)
     swapchainbarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     swapchainbarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     swapchainbarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    swapchainbarrier.image = swapchainImages[image_Index];
+    swapchainbarrier.image = colorImage;
     swapchainbarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     swapchainbarrier.subresourceRange.baseMipLevel = 0;
     swapchainbarrier.subresourceRange.levelCount = 1;
@@ -1148,7 +1834,7 @@ void recordCommandBuffer(int image_Index, int frame_Index)
 
     VkRenderingAttachmentInfo colorAttachment{};
     colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-    colorAttachment.imageView = swapchainImageViews[image_Index];
+    colorAttachment.imageView = upscale ? sceneColorImageViews[frame_Index] : swapchainImageViews[image_Index];
     colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
@@ -1165,63 +1851,128 @@ void recordCommandBuffer(int image_Index, int frame_Index)
     VkRenderingInfo renderingInfo{};
     renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
     renderingInfo.renderArea.offset = { 0, 0 };
-    renderingInfo.renderArea.extent = swapchainExtent;
+    renderingInfo.renderArea.extent = renderExtent;
     renderingInfo.layerCount = 1;
     renderingInfo.colorAttachmentCount = 1;
     renderingInfo.pColorAttachments = &colorAttachment;
 	renderingInfo.pDepthAttachment = &depthAttachment;
 
+    gpuProfiler.beginPass(commandBuffers[frame_Index], "Main pass");
     vkCmdBeginRendering(commandBuffers[frame_Index], &renderingInfo);
 
-    // ---- 3 Bind Pipeline ----
-    vkCmdBindPipeline(
-        commandBuffers[frame_Index],
-        VK_PIPELINE_BIND_POINT_GRAPHICS,
-        graphicsPipeline
-    );
-
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)swapchainExtent.width;
-    viewport.height = (float)swapchainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    vkCmdSetViewport(commandBuffers[frame_Index], 0, 1, &viewport);
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = swapchainExtent;
-
-    vkCmdSetScissor(commandBuffers[frame_Index], 0, 1, &scissor);
-
-    // ---- 4 Bind Vertex Buffer ----
-    VkBuffer vertexBuffers[] = { vertexBuffer };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(commandBuffers[frame_Index], 0, 1, vertexBuffers, offsets);
-
-    vkCmdPushConstants(commandBuffers[frame_Index],
-        pipelineLayout,
-        VK_SHADER_STAGE_VERTEX_BIT,
-        0,
-        sizeof(pc),
-        &pc);
-
-    // ---- 5 Draw Triangle ----
-    vkCmdDraw(commandBuffers[frame_Index],
-        static_cast<uint32_t>(vertices.size()),
-        1,
-        0,
-        0);
+    if (occlusionCull) {
+        // First phase: the opaque subsets that were visible last frame
+        bindSceneState(commandBuffers[frame_Index], model, renderExtent);
+        recordDrawItems(commandBuffers[frame_Index], drawItems.data(), opaqueCount,
+            hiZCuller.drawCommands(), hiZCuller.drawCommandOffset(0, 0));
+
+        vkCmdEndRendering(commandBuffers[frame_Index]);
+        gpuProfiler.endPass(commandBuffers[frame_Index]);
+
+        gpuProfiler.beginPass(commandBuffers[frame_Index], "Late cull");
+        hiZCuller.cullLate(commandBuffers[frame_Index], depthImages[frame_Index]);
+        gpuProfiler.endPass(commandBuffers[frame_Index]);
+
+        // Second phase: every other subset that passed, on top of the first. The depth was handed back by cullLate,
+        // and the graphics state bound above is untouched by the dispatches.
+        VkMemoryBarrier2 colorBarrier{};
+        colorBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+        colorBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        colorBarrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+        colorBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        colorBarrier.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+
+        VkDependencyInfo colorDepInfo{};
+        colorDepInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        colorDepInfo.memoryBarrierCount = 1;
+        colorDepInfo.pMemoryBarriers = &colorBarrier;
+        vkCmdPipelineBarrier2(commandBuffers[frame_Index], &colorDepInfo);
+
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+        gpuProfiler.beginPass(commandBuffers[frame_Index], "Late pass");
+        vkCmdBeginRendering(commandBuffers[frame_Index], &renderingInfo);
+        recordDrawItems(commandBuffers[frame_Index], drawItems.data(), static_cast<uint32_t>(drawItems.size()),
+            hiZCuller.drawCommands(), hiZCuller.drawCommandOffset(1, 0));
+    }
+    else {
+        recordSceneDraws(commandBuffers[frame_Index], model, renderExtent);
+    }
 
     // ---- 6 End Rendering ----
     vkCmdEndRendering(commandBuffers[frame_Index]);
+    gpuProfiler.endPass(commandBuffers[frame_Index]);
+
+    // ---- 7 Upscale into the swapchain image ----
+    VkImageLayout swapchainLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    if (upscale) {
+        gpuProfiler.beginPass(commandBuffers[frame_Index], "Upscale");
+
+        VkImageMemoryBarrier2 blitBarriers[2]{};
+        blitBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        blitBarriers[0].srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        blitBarriers[0].srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+        blitBarriers[0].dstStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT;
+        blitBarriers[0].dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+        blitBarriers[0].oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        blitBarriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        blitBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        blitBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        blitBarriers[0].image = colorImage;
+        blitBarriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        // The acquire semaphore is waited on at the transfer stage, which this barrier chains onto
+        blitBarriers[1] = blitBarriers[0];
+        blitBarriers[1].srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+        blitBarriers[1].srcAccessMask = VK_ACCESS_2_NONE;
+        blitBarriers[1].dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        blitBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        blitBarriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        blitBarriers[1].image = swapchainImages[image_Index];
+
+        VkDependencyInfo blitDepInfo{};
+        blitDepInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        blitDepInfo.imageMemoryBarrierCount = 2;
+        blitDepInfo.pImageMemoryBarriers = blitBarriers;
+        vkCmdPipelineBarrier2(commandBuffers[frame_Index], &blitDepInfo);
+
+        VkImageBlit region{};
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.srcOffsets[1] = { (int32_t)renderExtent.width, (int32_t)renderExtent.height, 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.dstOffsets[1] = { (int32_t)swapchainExtent.width, (int32_t)swapchainExtent.height, 1 };
+        vkCmdBlitImage(commandBuffers[frame_Index], colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            swapchainImages[image_Index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+
+        gpuProfiler.endPass(commandBuffers[frame_Index]);
+        swapchainLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    }
 
-    // ---- 7 Transition for Presentation ----
+    // ---- 8 Capture the image, if asked to ----
+    if (swapchainReadback && (captureDirectory || screenshotRequested)) {
+        // Numbers are only used up by captures the readback accepted, so a dropped frame leaves no gap in the sequence
+        bool screenshot = screenshotRequested;
+        screenshotRequested = false;
+
+        char path[512];
+        if (screenshot) {
+            snprintf(path, sizeof(path), "screenshot_%u.png", screenshotCount);
+        }
+        else {
+            snprintf(path, sizeof(path), "%s/frame_%06llu.ppm", captureDirectory, static_cast<unsigned long long>(capturedFrameCount));
+        }
+        if (readback.captureToFile(commandBuffers[frame_Index], frame_Index, swapchainImages[image_Index], swapchainImageFormat,
+            swapchainExtent, swapchainLayout, path)) {
+            if (screenshot) screenshotCount++;
+            else capturedFrameCount++;
+        }
+    }
+
+    // ---- 9 Transition for Presentation ----
     VkImageMemoryBarrier presentBarrier{};
     presentBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    presentBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    presentBarrier.oldLayout = swapchainLayout;
     presentBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
     presentBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     presentBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
@@ -1231,12 +1982,12 @@ void recordCommandBuffer(int image_Index, int frame_Index)
     presentBarrier.subresourceRange.levelCount = 1;
     presentBarrier.subresourceRange.baseArrayLayer = 0;
     presentBarrier.subresourceRange.layerCount = 1;
-    presentBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    presentBarrier.srcAccessMask = upscale ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     presentBarrier.dstAccessMask = 0;
 
     vkCmdPipelineBarrier(
         commandBuffers[frame_Index],
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        upscale ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
         0,
         0, nullptr,
@@ -1249,7 +2000,51 @@ void recordCommandBuffer(int image_Index, int frame_Index)
     }
 }
 
+void createGpuProfiler() {
+    PROFILE_FUNCTION();
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+    gpuProfiler.create(IMAGES_IN_FLIGHT, features.pipelineStatisticsQuery);
+}
+
+void createHiZCuller() {
+    PROFILE_FUNCTION();
+
+    if (!occlusionCullingEnabled) {
+        std::cerr << "Indirect draws or depth sampling are not supported; occlusion culling falls back to the CPU\n";
+        return;
+    }
+
+    VkShaderModule reduceShaderModule = createShaderModule(readFile("Shaders/hiz_reduce.comp.spv"));
+    VkShaderModule cullShaderModule = createShaderModule(readFile("Shaders/hiz_cull.comp.spv"));
+
+    hiZCuller.create(IMAGES_IN_FLIGHT, reduceShaderModule, cullShaderModule);
+    hiZCuller.resize(swapchainExtent, depthImageViews);
+
+    vkDestroyShaderModule(device, reduceShaderModule, hostAllocationCallbacks);
+    vkDestroyShaderModule(device, cullShaderModule, hostAllocationCallbacks);
+}
+
+void createSoftwareOcclusionCuller() {
+    PROFILE_FUNCTION();
+
+    softwareOcclusionEnabled = SOFTWARE_OCCLUSION_ENABLED && !occlusionCullingEnabled;
+    if (softwareOcclusionEnabled) softwareOcclusionCuller.create();
+}
+
+void createReadback() {
+    PROFILE_FUNCTION();
+
+    if (!swapchainReadback) {
+        std::cerr << "The surface does not allow copies from swapchain images; captures are disabled\n";
+    }
+    readback.create();
+}
+
 void createSyncObjects() {
+    PROFILE_FUNCTION();
 
     imageAvailableSemaphores.resize(swapchainImages.size());
     renderFinishedSemaphores.resize(swapchainImages.size());
@@ -1264,9 +2059,9 @@ void createSyncObjects() {
 
     for (size_t i = 0; i < swapchainImages.size(); i++) {
 
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+        if (vkCreateSemaphore(device, &semaphoreInfo, hostAllocationCallbacks, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, hostAllocationCallbacks, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
+            vkCreateFence(device, &fenceInfo, hostAllocationCallbacks, &inFlightFences[i]) != VK_SUCCESS) {
 
             throw std::runtime_error("failed to create synchronization objects!");
         }
@@ -1276,19 +2071,39 @@ void createSyncObjects() {
 }
 
 void drawFrame() {
+    PROFILE_FUNCTION();
+
+    // The occluder is rasterized on the workers while the fence below waits for the GPU
+    if (softwareOcclusionEnabled && model.indexCount > 0) {
+        softwareOcclusionCuller.begin(model, frameUniforms.proj * frameUniforms.view * objectUniforms.model);
+    }
 
-    vkWaitForFences(device, 1, &inFlightFences[frameIndex], VK_TRUE, UINT64_MAX);
+    {
+        PROFILE_SCOPE("waitForFrameFence");
+        vkWaitForFences(device, 1, &inFlightFences[frameIndex], VK_TRUE, UINT64_MAX);
+    }
     vkResetFences(device, 1, &inFlightFences[frameIndex]);
 
+    // The fence covers everything this frame's partition was used for last time round
+    uniformRing.beginFrame(frameIndex);
+    frameArena.beginFrame(frameIndex);
+    memoryBudget.update();
+    hostAllocator.beginFrame();
+    readback.beginFrame(frameIndex);
+
     // 1 Acquire next swapchain image
-    VkResult result = vkAcquireNextImageKHR(
-        device,
-        swapChain,
-        UINT64_MAX,                         // timeout
-        imageAvailableSemaphores[frameIndex], // semaphore signaled when image is ready
-        VK_NULL_HANDLE,
-        &imageIndex
-    );
+    VkResult result;
+    {
+        PROFILE_SCOPE("vkAcquireNextImageKHR");
+        result = vkAcquireNextImageKHR(
+            device,
+            swapChain,
+            UINT64_MAX,                         // timeout
+            imageAvailableSemaphores[frameIndex], // semaphore signaled when image is ready
+            VK_NULL_HANDLE,
+            &imageIndex
+        );
+    }
 
 
     if (result < VK_SUCCESS) {
@@ -1305,19 +2120,34 @@ void drawFrame() {
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &imageAvailableSemaphores[frameIndex];
+    // Meshes acquired in this command buffer must wait for their transfer-queue copies
+    VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[frameIndex], assetLoader.timelineSemaphore() };
+    // The swapchain image is first written by the upscale blit with dynamic resolution, by the main pass without
+    VkPipelineStageFlags waitStages[] = {
+        dynamicResolution.enabled() ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT };
+    uint64_t waitValues[] = { 0, assetLoader.frameWaitValue() };
+    submitInfo.waitSemaphoreCount = waitValues[1] > 0 ? 2 : 1;
+    submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
 
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    submitInfo.pNext = &timelineInfo;
+
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffers[frameIndex];
 
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = &renderFinishedSemaphores[imageIndex];
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[frameIndex]) != VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
+    {
+        PROFILE_SCOPE("vkQueueSubmit");
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[frameIndex]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
     }
 
     // 3 Present
@@ -1329,7 +2159,10 @@ void drawFrame() {
     presentInfo.pSwapchains = &swapChain;
     presentInfo.pImageIndices = &imageIndex;
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    {
+        PROFILE_SCOPE("vkQueuePresentKHR");
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
         updateSwapchain = true;
@@ -1341,12 +2174,50 @@ void drawFrame() {
     frameIndex = (frameIndex + 1) % IMAGES_IN_FLIGHT;
 }
 
+void recreateSwapchain()
+{
+    PROFILE_FUNCTION();
+    updateSwapchain = false;
+    vkDeviceWaitIdle(device);
+
+    VkSwapchainKHR oldSwapchain = swapChain;
+    createSwapchain(swapChain);
+    vkDestroySwapchainKHR(device, oldSwapchain, hostAllocationCallbacks);
+    for (auto i = 0; i < swapchainImageViews.size(); i++) {
+        vkDestroyImageView(device, swapchainImageViews[i], hostAllocationCallbacks);
+    }
+
+    createImageViews();
+
+    for (size_t i = 0; i < IMAGES_IN_FLIGHT; i++)
+    {
+        vkDestroyImageView(device, depthImageViews[i], hostAllocationCallbacks);
+        vkDestroyImage(device, depthImages[i], hostAllocationCallbacks);
+        memoryBudget.free(depthImagesMemory[i]);
+    }
+
+    createDepthResources();
+    if (occlusionCullingEnabled) hiZCuller.resize(swapchainExtent, depthImageViews);
+
+    // Reallocated at the new full size; changes of scale alone never reallocate
+    if (dynamicResolution.enabled()) {
+        destroySceneColorResources();
+        createSceneColorResources();
+    }
+}
+
 void mainLoop()
 {
     double time = glfwGetTime();
     double previousTime = time;
 	double deltatime = 0;
 
+    // A replay owns the window size, so the user cannot change it underneath the recorded frames
+    bool replaying = replay.mode() == ReplayMode::Replay;
+    if (replaying) glfwSetWindowAttrib(window, GLFW_RESIZABLE, GLFW_FALSE);
+    int recordedWidth = 0;
+    int recordedHeight = 0;
+
     float angle = 0.4f;
     while (!glfwWindowShouldClose(window)) {
 
@@ -1354,102 +2225,463 @@ void mainLoop()
 		deltatime = time - previousTime;
         previousTime = time;
 
+        ReplayFrame inputs{};
+        int width, height;
+        glfwGetWindowSize(window, &width, &height);
+
+        if (replaying) {
+            if (!replay.nextFrame()) break;
+            inputs = replay.frame();
+
+            deltatime = REPLAY_TIMESTEP;
+            cameraPosition = inputs.cameraPosition;
+            cameraTarget = inputs.cameraTarget;
+            if (width != inputs.width || height != inputs.height) {
+                // The window system applies the size asynchronously: wait for it, then recreate the swapchain so
+                // that this frame already renders at the recorded size
+                PROFILE_SCOPE("replayResize");
+                glfwSetWindowSize(window, inputs.width, inputs.height);
+                double deadline = glfwGetTime() + REPLAY_RESIZE_TIMEOUT;
+                while ((width != inputs.width || height != inputs.height) && glfwGetTime() < deadline) {
+                    glfwWaitEventsTimeout(0.01);
+                    glfwGetWindowSize(window, &width, &height);
+                }
+                if (width != inputs.width || height != inputs.height) {
+                    std::cerr << "replay: the window could not be resized to " << inputs.width << "x" << inputs.height << "\n";
+                }
+                glfwGetFramebufferSize(window, &window_width, &window_height);
+                recreateSwapchain();
+            }
+        }
+        else if (replay.mode() == ReplayMode::Record) {
+            inputs.deltaTime = static_cast<float>(deltatime);
+            inputs.cameraPosition = cameraPosition;
+            inputs.cameraTarget = cameraTarget;
+            inputs.width = static_cast<uint16_t>(width);
+            inputs.height = static_cast<uint16_t>(height);
+            if (width != recordedWidth || height != recordedHeight) inputs.events |= REPLAY_EVENT_RESIZE;
+            recordedWidth = width;
+            recordedHeight = height;
+        }
+
 		angle += 0.4f * deltatime; // rotate 0.4 radians per second
 
         glm::mat4 model = glm::mat4(1.f);
         model = glm::rotate(model, angle, glm::vec3(0.f, 1.f, 0.f));
-        pc.model = model; 
+        objectUniforms.model = model;
 
-        glm::mat4 view = glm::mat4(1.f);
-        view = glm::translate(view, -glm::vec3(0.0f, 0.0f, 4.0f));
-        pc.view = view;
+        glm::mat4 view = glm::lookAt(cameraPosition, cameraTarget, glm::vec3(0.f, 1.f, 0.f));
+        frameUniforms.view = view;
 
         glm::mat4 projection = glm::mat4(1.f);
         projection = glm::perspectiveRH_ZO(glm::radians(45.f),  (float)window_width / (float)window_height, 1.f, 10.f);
-        pc.proj = projection;
+        frameUniforms.proj = projection;
 
 
+        bool wasLoading = modelLoading;
         drawFrame();
-        glfwPollEvents();
-        if (updateSwapchain)
+        if (wasLoading && !modelLoading) inputs.events |= REPLAY_EVENT_MODEL_READY;
+
+        {
+            PROFILE_SCOPE("glfwPollEvents");
+            glfwPollEvents();
+        }
+
+        // Work that jobs handed back to the main thread, e.g. anything touching GLFW
+        jobSystem.pumpMainThread();
+        if (updateSwapchain) recreateSwapchain();
+
+        if (replay.mode() == ReplayMode::Record) {
+            replay.recordFrame(inputs);
+        }
+        else if (replaying) {
+            replay.frameTimed(glfwGetTime() - time, gpuProfiler.frameMilliseconds());
+        }
+    }
+}
+
+// Offscreen color and depth target of one frame in flight in batch mode
+struct BatchTarget {
+    VkImage colorImage = VK_NULL_HANDLE;
+    VkDeviceMemory colorMemory = VK_NULL_HANDLE;
+    VkImageView colorView = VK_NULL_HANDLE;
+    VkImage depthImage = VK_NULL_HANDLE;
+    VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+    VkImageView depthView = VK_NULL_HANDLE;
+
+    // Job rendered by the target's last submission, whose mesh is destroyed once that submission's fence has signalled
+    int64_t job = -1;
+    GpuMesh mesh{};
+};
+
+void createBatchImage(VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+    VkImage& image, VkDeviceMemory& memory, VkImageView& view)
+{
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { extent.width, extent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(device, &imageInfo, hostAllocationCallbacks, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create batch target image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    memory = memoryBudget.allocate(allocInfo, MemoryCategory::Attachment);
+    vkBindImageMemory(device, image, memory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = { aspect, 0, 1, 0, 1 };
+
+    if (vkCreateImageView(device, &viewInfo, hostAllocationCallbacks, &view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create batch target image view!");
+    }
+}
+
+// Camera of a batch job, into frameUniforms and objectUniforms. The clip planes hug the mesh's bounding sphere.
+void setBatchCamera(const BatchJob& job, const GpuMesh& mesh)
+{
+    float fov = glm::radians(job.fovDegrees);
+    float aspect = (float)job.width / (float)job.height;
+    glm::vec3 eye = job.eye;
+    glm::vec3 target = job.target;
+
+    if (job.autoCamera) {
+        // Back off along a three-quarter view until the bounding sphere fits the narrower field of view
+        float halfFov = aspect < 1.0f ? std::atan(std::tan(0.5f * fov) * aspect) : 0.5f * fov;
+        float distance = mesh.boundsRadius / std::sin(halfFov);
+        target = mesh.boundsCenter;
+        eye = target + glm::normalize(glm::vec3(0.6f, 0.5f, 1.0f)) * distance;
+    }
+
+    float distance = glm::length(eye - mesh.boundsCenter);
+    float nearPlane = std::max(distance - mesh.boundsRadius * 1.01f, distance * 0.001f);
+    float farPlane = distance + mesh.boundsRadius * 1.01f;
+
+    objectUniforms.model = glm::mat4(1.f);
+    frameUniforms.view = glm::lookAt(eye, target, glm::vec3(0.f, 1.f, 0.f));
+    frameUniforms.proj = glm::perspectiveRH_ZO(fov, aspect, nearPlane, farPlane);
+}
+
+// Renders every job of the manifest at batchManifestPath and writes batchReportPath. The stages overlap: meshes
+// decode on worker threads and upload on the transfer queue up to BATCH_LOAD_AHEAD jobs ahead, IMAGES_IN_FLIGHT
+// jobs render at once, each into its own target, and finished images go through the readback ring to its
+// encoder thread. Jobs render in the order their meshes become ready, not manifest order.
+void runBatch()
+{
+    PROFILE_FUNCTION();
+
+    std::vector<BatchJob> jobs = loadBatchManifest(batchManifestPath);
+    std::vector<BatchJobTiming> timings(jobs.size());
+    std::vector<MeshHandle> handles(jobs.size());
+
+    // Targets are sized for the largest job; smaller ones render into their top-left corner
+    VkExtent2D targetExtent = { 1, 1 };
+    for (const BatchJob& job : jobs) {
+        targetExtent.width = std::max(targetExtent.width, job.width);
+        targetExtent.height = std::max(targetExtent.height, job.height);
+    }
+
+    BatchTarget targets[IMAGES_IN_FLIGHT];
+    for (BatchTarget& target : targets) {
+        createBatchImage(targetExtent, pipelineColorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT, target.colorImage, target.colorMemory, target.colorView);
+        createBatchImage(targetExtent, pipelineDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            VK_IMAGE_ASPECT_DEPTH_BIT, target.depthImage, target.depthMemory, target.depthView);
+    }
+
+    // Every image is written, however far the encoder falls behind
+    readback.setLossless(true);
+    std::cout << "Rendering " << jobs.size() << " batch jobs into " << targetExtent.width << "x" << targetExtent.height << " targets\n";
+
+    double start = glfwGetTime();
+    size_t nextLoad = 0;
+    size_t finished = 0;
+    std::vector<size_t> loading;   // jobs queued on the asset loader and not rendered yet
+
+    while (finished < jobs.size()) {
+        while (nextLoad < jobs.size() && loading.size() < BATCH_LOAD_AHEAD) {
+            handles[nextLoad] = assetLoader.loadMesh(jobs[nextLoad].meshPath);
+            timings[nextLoad].requested = glfwGetTime() - start;
+            loading.push_back(nextLoad++);
+        }
+
         {
-            updateSwapchain = false;
+            PROFILE_SCOPE("waitForFrameFence");
+            vkWaitForFences(device, 1, &inFlightFences[frameIndex], VK_TRUE, UINT64_MAX);
+        }
+        vkResetFences(device, 1, &inFlightFences[frameIndex]);
+
+        uniformRing.beginFrame(frameIndex);
+        frameArena.beginFrame(frameIndex);
+        memoryBudget.update();
+        hostAllocator.beginFrame();
+        readback.beginFrame(frameIndex);
+
+        // The target's last job has been copied out and handed to the encoder
+        BatchTarget& target = targets[frameIndex];
+        if (target.job >= 0) {
+            timings[target.job].completed = glfwGetTime() - start;
+            destroyGpuMesh(target.mesh);
+            target.mesh = {};
+            target.job = -1;
+            finished++;
+        }
+
+        VkCommandBuffer commandBuffer = commandBuffers[frameIndex];
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+
+        assetLoader.update(commandBuffer, materialTable);
+        if (!materialTable.recordUpdate(commandBuffer)) {
             vkDeviceWaitIdle(device);
+            materialTable.upload();
+            writeDescriptorSet();
+        }
+
+        // Take the first mesh that is ready, once both pipeline variants are so that every image comes out the same;
+        // meshes that failed to load (the asset loader reports why) finish their jobs right away
+        bool pipelinesReady = pipelineCompiler.get(0) != VK_NULL_HANDLE && pipelineCompiler.get(PIPELINE_VARIANT_BLEND) != VK_NULL_HANDLE;
+        for (size_t i = 0; pipelinesReady && i < loading.size(); ) {
+            size_t job = loading[i];
+            if (assetLoader.loading(handles[job])) {
+                i++;
+                continue;
+            }
 
-			VkSwapchainKHR oldSwapchain = swapChain;
-            createSwapchain(swapChain);
-            vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
-            for (auto i = 0; i < swapchainImageViews.size(); i++) {
-                vkDestroyImageView(device, swapchainImageViews[i], nullptr);
+            loading.erase(loading.begin() + i);
+            timings[job].loaded = glfwGetTime() - start;
+            if (assetLoader.takeMesh(handles[job], target.mesh)) {
+                target.job = static_cast<int64_t>(job);
+                timings[job].triangles = target.mesh.lods[0].indexCount / 3;
+                break;
             }
 
-            createImageViews();
+            timings[job].failed = true;
+            timings[job].submitted = timings[job].completed = timings[job].loaded;
+            finished++;
+        }
 
-            for (size_t i = 0; i < IMAGES_IN_FLIGHT; i++)
-            {
-                vkDestroyImageView(device, depthImageViews[i], nullptr);
-                vkDestroyImage(device, depthImages[i], nullptr);
-                vkFreeMemory(device, depthImagesMemory[i], nullptr);
+        if (target.job >= 0) {
+            const BatchJob& job = jobs[target.job];
+            VkExtent2D extent = { job.width, job.height };
+            setBatchCamera(job, target.mesh);
+
+            VkImageMemoryBarrier2 barriers[2]{};
+            barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            barriers[0].srcStageMask = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
+            barriers[0].dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+            barriers[0].dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+            barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barriers[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barriers[0].image = target.colorImage;
+            barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+            barriers[1] = barriers[0];
+            barriers[1].dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT;
+            barriers[1].dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            barriers[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+            barriers[1].image = target.depthImage;
+            barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+            VkDependencyInfo depInfo{};
+            depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            depInfo.imageMemoryBarrierCount = 2;
+            depInfo.pImageMemoryBarriers = barriers;
+            vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+
+            VkRenderingAttachmentInfo colorAttachment{};
+            colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            colorAttachment.imageView = target.colorView;
+            colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            colorAttachment.clearValue = { {{0.1f, 0.1f, 0.1f, 1.0f}} };
+
+            VkRenderingAttachmentInfo depthAttachment{};
+            depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            depthAttachment.imageView = target.depthView;
+            depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+            VkRenderingInfo renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+            renderingInfo.renderArea.extent = extent;
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachments = &colorAttachment;
+            renderingInfo.pDepthAttachment = &depthAttachment;
+
+            vkCmdBeginRendering(commandBuffer, &renderingInfo);
+            recordSceneDraws(commandBuffer, target.mesh, extent);
+            vkCmdEndRendering(commandBuffer);
+
+            // An unsupported format or no free readback buffer writes nothing, so the job must not count as done
+            if (!readback.captureToFile(commandBuffer, frameIndex, target.colorImage, pipelineColorFormat, extent,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, job.outputPath)) {
+                timings[target.job].failed = true;
             }
+        }
 
-            createDepthResources();
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
         }
+
+        // Meshes acquired in this command buffer must wait for their transfer-queue copies
+        VkSemaphore waitSemaphore = assetLoader.timelineSemaphore();
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        uint64_t waitValue = assetLoader.frameWaitValue();
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = &waitValue;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = waitValue > 0 ? &timelineInfo : nullptr;
+        submitInfo.waitSemaphoreCount = waitValue > 0 ? 1 : 0;
+        submitInfo.pWaitSemaphores = &waitSemaphore;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[frameIndex]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit batch command buffer!");
+        }
+        if (target.job >= 0) {
+            timings[target.job].submitted = glfwGetTime() - start;
+        }
+        else {
+            // Nothing was ready: give the loader's jobs the core instead of spinning
+            std::this_thread::yield();
+        }
+
+        frameIndex = (frameIndex + 1) % IMAGES_IN_FLIGHT;
+        jobSystem.pumpMainThread();
+    }
+
+    // Images per second counts until the last one is on disk
+    readback.finish();
+    readback.setLossless(false);
+    writeBatchReport(batchReportPath, jobs, timings, glfwGetTime() - start);
+
+    vkDeviceWaitIdle(device);
+    for (BatchTarget& target : targets) {
+        vkDestroyImageView(device, target.colorView, hostAllocationCallbacks);
+        vkDestroyImage(device, target.colorImage, hostAllocationCallbacks);
+        memoryBudget.free(target.colorMemory);
+        vkDestroyImageView(device, target.depthView, hostAllocationCallbacks);
+        vkDestroyImage(device, target.depthImage, hostAllocationCallbacks);
+        memoryBudget.free(target.depthMemory);
     }
 }
 
 void cleanup()
 {
+    PROFILE_FUNCTION();
+
     vkDeviceWaitIdle(device);
 
+    // Peak per-frame usage, to size FRAME_ARENA_SIZE and UNIFORM_RING_SIZE
+    std::cout << "Frame arena high-water mark: " << frameArena.highWaterMark() << " of " << frameArena.capacity()
+        << " bytes (" << frameArena.totalAllocated() << " bytes allocated in total)\n";
+    std::cout << "Uniform ring high-water mark: " << uniformRing.highWaterMark() << " of " << UNIFORM_RING_SIZE << " bytes\n";
+    memoryBudget.report();
+    hostAllocator.report();
+    replay.destroy();
+
     // Destroy sync objects
     for (size_t i = 0; i < swapchainImages.size(); i++) {
-        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
+        vkDestroySemaphore(device, renderFinishedSemaphores[i], hostAllocationCallbacks);
+        vkDestroySemaphore(device, imageAvailableSemaphores[i], hostAllocationCallbacks);
+        vkDestroyFence(device, inFlightFences[i], hostAllocationCallbacks);
     }
 
     // Destroy command pool
-    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyCommandPool(device, commandPool, hostAllocationCallbacks);
 
 
     // Destroy vertex buffers
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
-
-    // Destroy graphics pipeline
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyBuffer(device, vertexBuffer, hostAllocationCallbacks);
+    memoryBudget.free(vertexBufferMemory);
+    softwareOcclusionCuller.destroy();
+    destroyGpuMesh(model);
+    assetLoader.destroy();
+
+    // Destroy material table, GPU profiler and uniform ring
+    vkDestroyDescriptorPool(device, descriptorPool, hostAllocationCallbacks);
+    materialTable.destroy();
+    gpuProfiler.destroy();
+    hiZCuller.destroy();
+    readback.destroy();
+    dynamicResolution.destroy();
+    uniformRing.destroy();
+
+    // Destroy graphics pipelines, once any still compiling have finished
+    pipelineCompiler.destroy();
+    vkDestroyPipelineLayout(device, pipelineLayout, hostAllocationCallbacks);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostAllocationCallbacks);
 
     for (size_t i = 0; i < IMAGES_IN_FLIGHT; i++)
     {
-        vkDestroyImageView(device, depthImageViews[i], nullptr);
-        vkDestroyImage(device, depthImages[i], nullptr);
-		vkFreeMemory(device, depthImagesMemory[i], nullptr);
+        vkDestroyImageView(device, depthImageViews[i], hostAllocationCallbacks);
+        vkDestroyImage(device, depthImages[i], hostAllocationCallbacks);
+		memoryBudget.free(depthImagesMemory[i]);
     }
+    if (dynamicResolution.enabled()) destroySceneColorResources();
     
 
     // Destroy swapchain image views
     for (auto imageView : swapchainImageViews) {
-        vkDestroyImageView(device, imageView, nullptr);
+        vkDestroyImageView(device, imageView, hostAllocationCallbacks);
     }
 
 	// Destroy swapchain
-    vkDestroySwapchainKHR(device, swapChain, nullptr);
+    vkDestroySwapchainKHR(device, swapChain, hostAllocationCallbacks);
 
     
-	// Destroy logical device
-    vkDestroyDevice(device, nullptr);
+	// Destroy logical device, after reporting any device memory that was never freed
+    memoryBudget.destroy();
+    vkDestroyDevice(device, hostAllocationCallbacks);
 
     // Destroy surface
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    vkDestroySurfaceKHR(instance, surface, hostAllocationCallbacks);
 
 	// Destroy debug messenger if it was created
 #ifndef NDEBUG
-    DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+    DestroyDebugUtilsMessengerEXT(instance, debugMessenger, hostAllocationCallbacks);
 #endif // !NDEBUG
 
 	// Destroy Vulkan instance
-	vkDestroyInstance(instance, nullptr);
+	vkDestroyInstance(instance, hostAllocationCallbacks);
 
 	glfwDestroyWindow(window);
 	glfwTerminate();
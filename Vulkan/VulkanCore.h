@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "HostAllocator.h"
+#include "MemoryBudget.h"
+#include "VertexFormat.h"
+
+// Renderer state shared between translation units (defined in Vulkan.cpp)
+extern VkInstance instance;
+extern VkPhysicalDevice physicalDevice;
+extern VkDevice device;
+extern VkQueue graphicsQueue;
+extern VkQueue transferQueue;   // graphicsQueue unless the device has a transfer-only queue family
+
+// Passed to every vkCreate*, vkDestroy*, vkAllocateMemory and vkFreeMemory call; nullptr without HOST_ALLOCATOR_ENABLED
+extern const VkAllocationCallbacks* hostAllocationCallbacks;
+
+struct QueueFamilyIndices {
+    std::optional<uint32_t> graphicsFamily;
+    std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily;   // transfer-only (DMA) family, if there is one
+
+    bool isComplete() {
+        return graphicsFamily.has_value() && presentFamily.has_value();
+    }
+};
+
+QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
+
+uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+// The memory comes from memoryBudget.allocate() and goes back through memoryBudget.free()
+void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    VkBuffer& buffer, VkDeviceMemory& bufferMemory, MemoryCategory category);
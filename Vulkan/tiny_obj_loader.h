@@ -609,6 +609,8 @@ namespace tinyobj {
     /// or not.
     /// Option 'default_vcols_fallback' specifies whether vertex colors should
     /// always be defined, even if no colors are given (fallback to white).
+    /// The .obj and .mtl files are memory mapped and parsed in place(unless
+    /// TINYOBJLOADER_DISABLE_MMAP is defined).
     bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes,
         std::vector<material_t>* materials, std::string* warn,
         std::string* err, const char* filename,
@@ -626,6 +628,20 @@ namespace tinyobj {
         MaterialReader* readMatFn = NULL,
         std::string* warn = NULL, std::string* err = NULL);
 
+    /// Same as above, but reads the .obj from a file. The file is memory mapped
+    /// and parsed in place(unless TINYOBJLOADER_DISABLE_MMAP is defined).
+    bool LoadObjWithCallback(const char* filename, const callback_t& callback,
+        void* user_data = NULL,
+        MaterialReader* readMatFn = NULL,
+        std::string* warn = NULL, std::string* err = NULL);
+
+    /// Same as above, but parses .obj text already in memory, e.g. a file the
+    /// caller has mapped itself. `data` must stay valid until this returns.
+    bool LoadObjWithCallback(const char* data, size_t size,
+        const callback_t& callback, void* user_data = NULL,
+        MaterialReader* readMatFn = NULL,
+        std::string* warn = NULL, std::string* err = NULL);
+
     /// Loads object from a std::istream, uses `readMatFn` to retrieve
     /// std::istream for materials.
     /// Returns true when loading .obj become success.
@@ -667,10 +683,28 @@ namespace tinyobj {
 #include <cstring>
 #include <fstream>
 #include <limits>
+#include <new>
 #include <set>
 #include <sstream>
 #include <utility>
 
+#ifndef TINYOBJLOADER_DISABLE_MMAP
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#endif  // TINYOBJLOADER_DISABLE_MMAP
+
 #ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
 
 #ifdef TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
@@ -707,15 +741,137 @@ namespace tinyobj {
         }
     };
 
+    //
+    // Bump allocator for the temporaries built while parsing.
+    // Small blocks are carved out of large chunks, and everything is released in
+    // one shot when the arena goes out of scope(i.e. when LoadObj returns).
+    // Blocks larger than a quarter chunk(e.g. the flat index array of a big mesh)
+    // come from the heap, so growing vectors do not leave dead copies behind.
+    // Define TINYOBJLOADER_DISABLE_ARENA to route everything to the heap.
+    //
+    class arena_t {
+    public:
+        explicit arena_t(size_t chunk_size = 256 * 1024)
+            : chunk_size_(chunk_size), cur_(NULL), end_(NULL) {
+        }
+
+        ~arena_t() {
+            for (size_t i = 0; i < chunks_.size(); i++) {
+                ::operator delete(chunks_[i]);
+            }
+        }
+
+        void* allocate(size_t n) {
+            n = align(n);
+#ifndef TINYOBJLOADER_DISABLE_ARENA
+            if (n <= chunk_size_ / 4) {
+                if (static_cast<size_t>(end_ - cur_) < n) {
+                    cur_ = static_cast<char*>(::operator new(chunk_size_));
+                    end_ = cur_ + chunk_size_;
+                    chunks_.push_back(cur_);
+                }
+                void* p = cur_;
+                cur_ += n;
+                return p;
+            }
+#endif
+            return ::operator new(n);
+        }
+
+        void deallocate(void* p, size_t n) {
+            n = align(n);
+#ifndef TINYOBJLOADER_DISABLE_ARENA
+            if (n <= chunk_size_ / 4) {
+                // Only the most recent block can be given back; the rest is
+                // reclaimed when the arena dies.
+                if (static_cast<char*>(p) + n == cur_) {
+                    cur_ = static_cast<char*>(p);
+                }
+                return;
+            }
+#endif
+            ::operator delete(p);
+        }
+
+    private:
+        arena_t(const arena_t&);
+        arena_t& operator=(const arena_t&);
+
+        static size_t align(size_t n) {
+            const size_t alignment = 16;
+            return (n + alignment - 1) & ~(alignment - 1);
+        }
+
+        size_t chunk_size_;
+        char* cur_;
+        char* end_;
+        std::vector<char*> chunks_;
+    };
+
+    // STL allocator adapter for arena_t.
+    template <typename T>
+    class arena_allocator {
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef const T* const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        template <typename U>
+        struct rebind {
+            typedef arena_allocator<U> other;
+        };
+
+        explicit arena_allocator(arena_t* arena) : arena_(arena) {}
+        template <typename U>
+        arena_allocator(const arena_allocator<U>& other) : arena_(other.arena()) {}
+
+        pointer allocate(size_type n, const void* hint = 0) {
+            (void)hint;
+            return static_cast<pointer>(arena_->allocate(n * sizeof(T)));
+        }
+        void deallocate(pointer p, size_type n) {
+            arena_->deallocate(p, n * sizeof(T));
+        }
+
+        pointer address(reference x) const { return &x; }
+        const_pointer address(const_reference x) const { return &x; }
+        size_type max_size() const { return size_type(-1) / sizeof(T); }
+        void construct(pointer p, const T& val) { new (static_cast<void*>(p)) T(val); }
+        void destroy(pointer p) { p->~T(); }
+
+        arena_t* arena() const { return arena_; }
+
+    private:
+        arena_t* arena_;
+    };
+
+    template <typename T, typename U>
+    inline bool operator==(const arena_allocator<T>& a,
+        const arena_allocator<U>& b) {
+        return a.arena() == b.arena();
+    }
+
+    template <typename T, typename U>
+    inline bool operator!=(const arena_allocator<T>& a,
+        const arena_allocator<U>& b) {
+        return a.arena() != b.arena();
+    }
+
     // Internal data structure for face representation
     // index + smoothing group.
+    // Vertex indices of all faces in a PrimGroup are stored back to back in
+    // `PrimGroup::faceVertices`, so a face does not own an allocation.
     struct face_t {
         unsigned int
             smoothing_group_id;  // smoothing group id. 0 = smoothing groupd is off.
-        int pad_;
-        std::vector<vertex_index_t> vertex_indices;  // face vertex indices.
+        unsigned int num_vertices;
+        size_t vertex_offset;  // first vertex index in `PrimGroup::faceVertices`.
 
-        face_t() : smoothing_group_id(0), pad_(0) {}
+        face_t() : smoothing_group_id(0), num_vertices(0), vertex_offset(0) {}
     };
 
     // Internal data structure for line representation
@@ -723,7 +879,8 @@ namespace tinyobj {
         // l v1/vt1 v2/vt2 ...
         // In the specification, line primitrive does not have normal index, but
         // TinyObjLoader allow it
-        std::vector<vertex_index_t> vertex_indices;
+        size_t vertex_offset;  // first vertex index in `PrimGroup::lineVertices`.
+        size_t num_vertices;
     };
 
     // Internal data structure for points representation
@@ -731,7 +888,8 @@ namespace tinyobj {
         // p v1 v2 ...
         // In the specification, point primitrive does not have normal index and
         // texture coord index, but TinyObjLoader allow it.
-        std::vector<vertex_index_t> vertex_indices;
+        size_t vertex_offset;  // first vertex index in `PrimGroup::pointsVertices`.
+        size_t num_vertices;
     };
 
     struct tag_sizes {
@@ -750,14 +908,36 @@ namespace tinyobj {
     //
     // Manages group of primitives(face, line, points, ...)
     struct PrimGroup {
-        std::vector<face_t> faceGroup;
-        std::vector<__line_t> lineGroup;
-        std::vector<__points_t> pointsGroup;
+        typedef std::vector<vertex_index_t, arena_allocator<vertex_index_t> >
+            index_array;
+
+        explicit PrimGroup(arena_t* arena)
+            : faceGroup(arena_allocator<face_t>(arena)),
+            faceVertices(arena_allocator<vertex_index_t>(arena)),
+            lineGroup(arena_allocator<__line_t>(arena)),
+            lineVertices(arena_allocator<vertex_index_t>(arena)),
+            pointsGroup(arena_allocator<__points_t>(arena)),
+            pointsVertices(arena_allocator<vertex_index_t>(arena)) {
+        }
+
+        std::vector<face_t, arena_allocator<face_t> > faceGroup;
+        index_array faceVertices;
+        std::vector<__line_t, arena_allocator<__line_t> > lineGroup;
+        index_array lineVertices;
+        std::vector<__points_t, arena_allocator<__points_t> > pointsGroup;
+        index_array pointsVertices;
+
+        void clearFaces() {
+            faceGroup.clear();
+            faceVertices.clear();
+        }
 
         void clear() {
-            faceGroup.clear();
+            clearFaces();
             lineGroup.clear();
+            lineVertices.clear();
             pointsGroup.clear();
+            pointsVertices.clear();
         }
 
         bool IsEmpty() const {
@@ -826,6 +1006,206 @@ namespace tinyobj {
         return input;
     }
 
+    static inline void skipUtf8Bom(const char** begin, const char* end) {
+        if (end - (*begin) >= 3 &&
+            static_cast<unsigned char>((*begin)[0]) == 0xEF &&
+            static_cast<unsigned char>((*begin)[1]) == 0xBB &&
+            static_cast<unsigned char>((*begin)[2]) == 0xBF) {
+            (*begin) += 3;
+        }
+    }
+
+    //
+    // Read-only view of a whole file.
+    // By default the file is memory mapped and hinted for sequential access, so
+    // the parsers read straight out of the page cache without an intermediate
+    // copy. Define TINYOBJLOADER_DISABLE_MMAP to read into a heap buffer instead.
+    //
+    class mapped_file_t {
+    public:
+        mapped_file_t() : data_(NULL), size_(0) {}
+        ~mapped_file_t() { close(); }
+
+        bool open(const char* filename) {
+            close();
+#if defined(TINYOBJLOADER_DISABLE_MMAP)
+            std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+            if (!ifs) {
+                return false;
+            }
+            buffer_.resize(static_cast<size_t>(ifs.tellg()));
+            ifs.seekg(0);
+            if (!buffer_.empty()) {
+                ifs.read(&buffer_.at(0), static_cast<std::streamsize>(buffer_.size()));
+                data_ = &buffer_.at(0);
+            }
+            size_ = buffer_.size();
+            return true;
+#elif defined(_WIN32)
+            // FILE_FLAG_SEQUENTIAL_SCAN is the Win32 counterpart of
+            // MADV_SEQUENTIAL: it enables aggressive read-ahead for the file.
+            HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            LARGE_INTEGER file_size;
+            if (!GetFileSizeEx(file, &file_size)) {
+                CloseHandle(file);
+                return false;
+            }
+            size_t size = static_cast<size_t>(file_size.QuadPart);
+            if (size > 0) {
+                HANDLE mapping =
+                    CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                if (mapping == NULL) {
+                    CloseHandle(file);
+                    return false;
+                }
+                data_ = static_cast<const char*>(
+                    MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                CloseHandle(mapping);  // The view keeps the mapping alive.
+                if (data_ == NULL) {
+                    CloseHandle(file);
+                    return false;
+                }
+            }
+            CloseHandle(file);
+            size_ = size;
+            return true;
+#else
+            int fd = ::open(filename, O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat sb;
+            if (fstat(fd, &sb) != 0) {
+                ::close(fd);
+                return false;
+            }
+            size_t size = static_cast<size_t>(sb.st_size);
+            if (size > 0) {
+                void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED) {
+                    ::close(fd);
+                    return false;
+                }
+                madvise(p, size, MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(p);
+            }
+            ::close(fd);  // The mapping keeps the file alive.
+            size_ = size;
+            return true;
+#endif
+        }
+
+        void close() {
+#if defined(TINYOBJLOADER_DISABLE_MMAP)
+            buffer_.clear();
+#elif defined(_WIN32)
+            if (data_) {
+                UnmapViewOfFile(data_);
+            }
+#else
+            if (data_) {
+                munmap(const_cast<char*>(data_), size_);
+            }
+#endif
+            data_ = NULL;
+            size_ = 0;
+        }
+
+        const char* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        mapped_file_t(const mapped_file_t&);
+        mapped_file_t& operator=(const mapped_file_t&);
+
+        const char* data_;
+        size_t size_;
+#if defined(TINYOBJLOADER_DISABLE_MMAP)
+        std::vector<char> buffer_;
+#endif
+    };
+
+    //
+    // Source of input lines for the parsers.
+    // `next` returns the line as [begin, end) without its line terminator.
+    // `*end` is always a '\0', '\r' or '\n', so the token parsers (which stop at
+    // any of those) never run past the end of the line.
+    //
+    class line_reader_t {
+    public:
+        virtual ~line_reader_t() {}
+        virtual bool next(const char** begin, const char** end) = 0;
+    };
+
+    class stream_line_reader_t : public line_reader_t {
+    public:
+        explicit stream_line_reader_t(std::istream& is) : is_(is) {}
+        virtual ~stream_line_reader_t() TINYOBJ_OVERRIDE {}
+
+        virtual bool next(const char** begin, const char** end) TINYOBJ_OVERRIDE {
+            if (is_.peek() == -1) {
+                return false;
+            }
+            safeGetline(is_, linebuf_);
+            (*begin) = linebuf_.c_str();
+            (*end) = (*begin) + linebuf_.size();
+            return true;
+        }
+
+    private:
+        std::istream& is_;
+        std::string linebuf_;  // Reused, so only grows on the longest line.
+    };
+
+    // Splits an in-memory buffer(e.g. a mapped file) into lines in place.
+    // Accepts '\n', '\r\n' and '\r' line endings like safeGetline().
+    class memory_line_reader_t : public line_reader_t {
+    public:
+        memory_line_reader_t(const char* data, size_t size)
+            : cur_(data), end_(data + size) {
+        }
+        virtual ~memory_line_reader_t() TINYOBJ_OVERRIDE {}
+
+        virtual bool next(const char** begin, const char** end) TINYOBJ_OVERRIDE {
+            if (cur_ == end_) {
+                return false;
+            }
+
+            const char* p = cur_;
+            while (p != end_ && (*p) != '\n' && (*p) != '\r') {
+                p++;
+            }
+
+            if (p == end_) {
+                // The last line has no terminator, and there is nothing readable
+                // after the end of the buffer. Copy it so it gets a '\0'.
+                tail_.assign(cur_, end_);
+                (*begin) = tail_.c_str();
+                (*end) = (*begin) + tail_.size();
+                cur_ = end_;
+                return true;
+            }
+
+            (*begin) = cur_;
+            (*end) = p;
+            if ((*p) == '\r' && (p + 1) != end_ && p[1] == '\n') {
+                p++;
+            }
+            cur_ = p + 1;
+            return true;
+        }
+
+    private:
+        const char* cur_;
+        const char* end_;
+        std::string tail_;
+    };
+
     struct warning_context {
         std::string* warn;
         size_t line_number;
@@ -870,7 +1250,7 @@ namespace tinyobj {
     static inline std::string parseString(const char** token) {
         std::string s;
         (*token) += strspn((*token), " \t");
-        size_t e = strcspn((*token), " \t\r");
+        size_t e = strcspn((*token), " \t\r\n");
         s = std::string((*token), &(*token)[e]);
         (*token) += e;
         return s;
@@ -879,7 +1259,7 @@ namespace tinyobj {
     static inline int parseInt(const char** token) {
         (*token) += strspn((*token), " \t");
         int i = atoi((*token));
-        (*token) += strcspn((*token), " \t\r");
+        (*token) += strcspn((*token), " \t\r\n");
         return i;
     }
 
@@ -1052,7 +1432,7 @@ namespace tinyobj {
 
     static inline real_t parseReal(const char** token, double default_value = 0.0) {
         (*token) += strspn((*token), " \t");
-        const char* end = (*token) + strcspn((*token), " \t\r");
+        const char* end = (*token) + strcspn((*token), " \t\r\n");
         double val = default_value;
         tryParseDouble((*token), end, &val);
         real_t f = static_cast<real_t>(val);
@@ -1062,7 +1442,7 @@ namespace tinyobj {
 
     static inline bool parseReal(const char** token, real_t* out) {
         (*token) += strspn((*token), " \t");
-        const char* end = (*token) + strcspn((*token), " \t\r");
+        const char* end = (*token) + strcspn((*token), " \t\r\n");
         double val;
         bool ret = tryParseDouble((*token), end, &val);
         if (ret) {
@@ -1143,7 +1523,7 @@ namespace tinyobj {
 
     static inline bool parseOnOff(const char** token, bool default_value = true) {
         (*token) += strspn((*token), " \t");
-        const char* end = (*token) + strcspn((*token), " \t\r");
+        const char* end = (*token) + strcspn((*token), " \t\r\n");
 
         bool ret = default_value;
         if ((0 == strncmp((*token), "on", 2))) {
@@ -1160,7 +1540,7 @@ namespace tinyobj {
     static inline texture_type_t parseTextureType(
         const char** token, texture_type_t default_value = TEXTURE_TYPE_NONE) {
         (*token) += strspn((*token), " \t");
-        const char* end = (*token) + strcspn((*token), " \t\r");
+        const char* end = (*token) + strcspn((*token), " \t\r\n");
         texture_type_t ty = default_value;
 
         if ((0 == strncmp((*token), "cube_top", strlen("cube_top")))) {
@@ -1194,7 +1574,7 @@ namespace tinyobj {
 
         (*token) += strspn((*token), " \t");
         ts.num_ints = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             return ts;
         }
@@ -1203,7 +1583,7 @@ namespace tinyobj {
 
         (*token) += strspn((*token), " \t");
         ts.num_reals = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             return ts;
         }
@@ -1227,7 +1607,7 @@ namespace tinyobj {
             return false;
         }
 
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             (*ret) = vi;
             return true;
@@ -1240,7 +1620,7 @@ namespace tinyobj {
             if (!fixIndex(atoi((*token)), vnsize, &vi.vn_idx, true, context)) {
                 return false;
             }
-            (*token) += strcspn((*token), "/ \t\r");
+            (*token) += strcspn((*token), "/ \t\r\n");
             (*ret) = vi;
             return true;
         }
@@ -1250,7 +1630,7 @@ namespace tinyobj {
             return false;
         }
 
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             (*ret) = vi;
             return true;
@@ -1261,7 +1641,7 @@ namespace tinyobj {
         if (!fixIndex(atoi((*token)), vnsize, &vi.vn_idx, true, context)) {
             return false;
         }
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
 
         (*ret) = vi;
 
@@ -1273,7 +1653,7 @@ namespace tinyobj {
         vertex_index_t vi(static_cast<int>(0));  // 0 is an invalid index in OBJ
 
         vi.v_idx = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             return vi;
         }
@@ -1283,13 +1663,13 @@ namespace tinyobj {
         if ((*token)[0] == '/') {
             (*token)++;
             vi.vn_idx = atoi((*token));
-            (*token) += strcspn((*token), "/ \t\r");
+            (*token) += strcspn((*token), "/ \t\r\n");
             return vi;
         }
 
         // i/j/k or i/j
         vi.vt_idx = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         if ((*token)[0] != '/') {
             return vi;
         }
@@ -1297,7 +1677,7 @@ namespace tinyobj {
         // i/j/k
         (*token)++;  // skip '/'
         vi.vn_idx = atoi((*token));
-        (*token) += strcspn((*token), "/ \t\r");
+        (*token) += strcspn((*token), "/ \t\r\n");
         return vi;
     }
 
@@ -1358,7 +1738,7 @@ namespace tinyobj {
             else if ((0 == strncmp(token, "-imfchan", 8)) && IS_SPACE((token[8]))) {
                 token += 9;
                 token += strspn(token, " \t");
-                const char* end = token + strcspn(token, " \t\r");
+                const char* end = token + strcspn(token, " \t\r\n");
                 if ((end - token) == 1) {  // Assume one char for -imfchan
                     texopt->imfchan = (*token);
                 }
@@ -1535,13 +1915,16 @@ namespace tinyobj {
 
         shape->name = name;
 
+        // Scratch polygon for ear clipping, reused across faces.
+        std::vector<vertex_index_t> remainingFace;
+
         // polygon
         if (!prim_group.faceGroup.empty()) {
             // Flatten vertices and indices
             for (size_t i = 0; i < prim_group.faceGroup.size(); i++) {
                 const face_t& face = prim_group.faceGroup[i];
 
-                size_t npolys = face.vertex_indices.size();
+                size_t npolys = face.num_vertices;
 
                 if (npolys < 3) {
                     // Face must have 3+ vertices.
@@ -1551,12 +1934,15 @@ namespace tinyobj {
                     continue;
                 }
 
+                const vertex_index_t* face_vertices =
+                    &prim_group.faceVertices[face.vertex_offset];
+
                 if (triangulate && npolys != 3) {
                     if (npolys == 4) {
-                        vertex_index_t i0 = face.vertex_indices[0];
-                        vertex_index_t i1 = face.vertex_indices[1];
-                        vertex_index_t i2 = face.vertex_indices[2];
-                        vertex_index_t i3 = face.vertex_indices[3];
+                        vertex_index_t i0 = face_vertices[0];
+                        vertex_index_t i1 = face_vertices[1];
+                        vertex_index_t i2 = face_vertices[2];
+                        vertex_index_t i3 = face_vertices[3];
 
                         size_t vi0 = size_t(i0.v_idx);
                         size_t vi1 = size_t(i1.v_idx);
@@ -1663,18 +2049,18 @@ namespace tinyobj {
                     }
                     else {
 #ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
-                        vertex_index_t i0 = face.vertex_indices[0];
+                        vertex_index_t i0 = face_vertices[0];
                         vertex_index_t i0_2 = i0;
 
                         // TMW change: Find the normal axis of the polygon using Newell's
                         // method
                         TinyObjPoint n;
                         for (size_t k = 0; k < npolys; ++k) {
-                            i0 = face.vertex_indices[k % npolys];
+                            i0 = face_vertices[k % npolys];
                             size_t vi0 = size_t(i0.v_idx);
 
                             size_t j = (k + 1) % npolys;
-                            i0_2 = face.vertex_indices[j];
+                            i0_2 = face_vertices[j];
                             size_t vi0_2 = size_t(i0_2.v_idx);
 
                             real_t v0x = v[vi0 * 3 + 0];
@@ -1733,7 +2119,7 @@ namespace tinyobj {
 
                         // Fill polygon data(facevarying vertices).
                         for (size_t k = 0; k < npolys; k++) {
-                            i0 = face.vertex_indices[k];
+                            i0 = face_vertices[k];
                             size_t vi0 = size_t(i0.v_idx);
 
                             assert(((3 * vi0 + 2) < v.size()));
@@ -1758,21 +2144,21 @@ namespace tinyobj {
                         for (size_t k = 0; k < indices.size() / 3; k++) {
                             {
                                 index_t idx0, idx1, idx2;
-                                idx0.vertex_index = face.vertex_indices[indices[3 * k + 0]].v_idx;
+                                idx0.vertex_index = face_vertices[indices[3 * k + 0]].v_idx;
                                 idx0.normal_index =
-                                    face.vertex_indices[indices[3 * k + 0]].vn_idx;
+                                    face_vertices[indices[3 * k + 0]].vn_idx;
                                 idx0.texcoord_index =
-                                    face.vertex_indices[indices[3 * k + 0]].vt_idx;
-                                idx1.vertex_index = face.vertex_indices[indices[3 * k + 1]].v_idx;
+                                    face_vertices[indices[3 * k + 0]].vt_idx;
+                                idx1.vertex_index = face_vertices[indices[3 * k + 1]].v_idx;
                                 idx1.normal_index =
-                                    face.vertex_indices[indices[3 * k + 1]].vn_idx;
+                                    face_vertices[indices[3 * k + 1]].vn_idx;
                                 idx1.texcoord_index =
-                                    face.vertex_indices[indices[3 * k + 1]].vt_idx;
-                                idx2.vertex_index = face.vertex_indices[indices[3 * k + 2]].v_idx;
+                                    face_vertices[indices[3 * k + 1]].vt_idx;
+                                idx2.vertex_index = face_vertices[indices[3 * k + 2]].v_idx;
                                 idx2.normal_index =
-                                    face.vertex_indices[indices[3 * k + 2]].vn_idx;
+                                    face_vertices[indices[3 * k + 2]].vn_idx;
                                 idx2.texcoord_index =
-                                    face.vertex_indices[indices[3 * k + 2]].vt_idx;
+                                    face_vertices[indices[3 * k + 2]].vt_idx;
 
                                 shape->mesh.indices.push_back(idx0);
                                 shape->mesh.indices.push_back(idx1);
@@ -1786,16 +2172,16 @@ namespace tinyobj {
                         }
 
 #else  // Built-in ear clipping triangulation
-                        vertex_index_t i0 = face.vertex_indices[0];
+                        vertex_index_t i0 = face_vertices[0];
                         vertex_index_t i1(-1);
-                        vertex_index_t i2 = face.vertex_indices[1];
+                        vertex_index_t i2 = face_vertices[1];
 
                         // find the two axes to work in
                         size_t axes[2] = { 1, 2 };
                         for (size_t k = 0; k < npolys; ++k) {
-                            i0 = face.vertex_indices[(k + 0) % npolys];
-                            i1 = face.vertex_indices[(k + 1) % npolys];
-                            i2 = face.vertex_indices[(k + 2) % npolys];
+                            i0 = face_vertices[(k + 0) % npolys];
+                            i1 = face_vertices[(k + 1) % npolys];
+                            i2 = face_vertices[(k + 2) % npolys];
                             size_t vi0 = size_t(i0.v_idx);
                             size_t vi1 = size_t(i1.v_idx);
                             size_t vi2 = size_t(i2.v_idx);
@@ -1845,7 +2231,7 @@ namespace tinyobj {
                             }
                         }
 
-                        face_t remainingFace = face;  // copy
+                        remainingFace.assign(face_vertices, face_vertices + npolys);
                         size_t guess_vert = 0;
                         vertex_index_t ind[3];
                         real_t vx[3];
@@ -1853,16 +2239,16 @@ namespace tinyobj {
 
                         // How many iterations can we do without decreasing the remaining
                         // vertices.
-                        size_t remainingIterations = face.vertex_indices.size();
+                        size_t remainingIterations = face.num_vertices;
                         size_t previousRemainingVertices =
-                            remainingFace.vertex_indices.size();
+                            remainingFace.size();
 
-                        while (remainingFace.vertex_indices.size() > 3 &&
+                        while (remainingFace.size() > 3 &&
                             remainingIterations > 0) {
                             // std::cout << "remainingIterations " << remainingIterations <<
                             // "\n";
 
-                            npolys = remainingFace.vertex_indices.size();
+                            npolys = remainingFace.size();
                             if (guess_vert >= npolys) {
                                 guess_vert -= npolys;
                             }
@@ -1879,7 +2265,7 @@ namespace tinyobj {
                             }
 
                             for (size_t k = 0; k < 3; k++) {
-                                ind[k] = remainingFace.vertex_indices[(guess_vert + k) % npolys];
+                                ind[k] = remainingFace[(guess_vert + k) % npolys];
                                 size_t vi = size_t(ind[k].v_idx);
                                 if (((vi * 3 + axes[0]) >= v.size()) ||
                                     ((vi * 3 + axes[1]) >= v.size())) {
@@ -1921,13 +2307,13 @@ namespace tinyobj {
                             for (size_t otherVert = 3; otherVert < npolys; ++otherVert) {
                                 size_t idx = (guess_vert + otherVert) % npolys;
 
-                                if (idx >= remainingFace.vertex_indices.size()) {
+                                if (idx >= remainingFace.size()) {
                                     // std::cout << "???0\n";
                                     // ???
                                     continue;
                                 }
 
-                                size_t ovi = size_t(remainingFace.vertex_indices[idx].v_idx);
+                                size_t ovi = size_t(remainingFace[idx].v_idx);
 
                                 if (((ovi * 3 + axes[0]) >= v.size()) ||
                                     ((ovi * 3 + axes[1]) >= v.size())) {
@@ -1976,19 +2362,19 @@ namespace tinyobj {
                             // remove v1 from the list
                             size_t removed_vert_index = (guess_vert + 1) % npolys;
                             while (removed_vert_index + 1 < npolys) {
-                                remainingFace.vertex_indices[removed_vert_index] =
-                                    remainingFace.vertex_indices[removed_vert_index + 1];
+                                remainingFace[removed_vert_index] =
+                                    remainingFace[removed_vert_index + 1];
                                 removed_vert_index += 1;
                             }
-                            remainingFace.vertex_indices.pop_back();
+                            remainingFace.pop_back();
                         }
 
                         // std::cout << "remainingFace.vi.size = " <<
-                        // remainingFace.vertex_indices.size() << "\n";
-                        if (remainingFace.vertex_indices.size() == 3) {
-                            i0 = remainingFace.vertex_indices[0];
-                            i1 = remainingFace.vertex_indices[1];
-                            i2 = remainingFace.vertex_indices[2];
+                        // remainingFace.size() << "\n";
+                        if (remainingFace.size() == 3) {
+                            i0 = remainingFace[0];
+                            i1 = remainingFace[1];
+                            i2 = remainingFace[2];
                             {
                                 index_t idx0, idx1, idx2;
                                 idx0.vertex_index = i0.v_idx;
@@ -2017,9 +2403,9 @@ namespace tinyobj {
                 else {
                     for (size_t k = 0; k < npolys; k++) {
                         index_t idx;
-                        idx.vertex_index = face.vertex_indices[k].v_idx;
-                        idx.normal_index = face.vertex_indices[k].vn_idx;
-                        idx.texcoord_index = face.vertex_indices[k].vt_idx;
+                        idx.vertex_index = face_vertices[k].v_idx;
+                        idx.normal_index = face_vertices[k].vn_idx;
+                        idx.texcoord_index = face_vertices[k].vt_idx;
                         shape->mesh.indices.push_back(idx);
                     }
 
@@ -2038,9 +2424,10 @@ namespace tinyobj {
         if (!prim_group.lineGroup.empty()) {
             // Flatten indices
             for (size_t i = 0; i < prim_group.lineGroup.size(); i++) {
-                for (size_t j = 0; j < prim_group.lineGroup[i].vertex_indices.size();
-                    j++) {
-                    const vertex_index_t& vi = prim_group.lineGroup[i].vertex_indices[j];
+                const __line_t& line = prim_group.lineGroup[i];
+                for (size_t j = 0; j < line.num_vertices; j++) {
+                    const vertex_index_t& vi =
+                        prim_group.lineVertices[line.vertex_offset + j];
 
                     index_t idx;
                     idx.vertex_index = vi.v_idx;
@@ -2050,8 +2437,7 @@ namespace tinyobj {
                     shape->lines.indices.push_back(idx);
                 }
 
-                shape->lines.num_line_vertices.push_back(
-                    int(prim_group.lineGroup[i].vertex_indices.size()));
+                shape->lines.num_line_vertices.push_back(int(line.num_vertices));
             }
         }
 
@@ -2059,9 +2445,10 @@ namespace tinyobj {
         if (!prim_group.pointsGroup.empty()) {
             // Flatten & convert indices
             for (size_t i = 0; i < prim_group.pointsGroup.size(); i++) {
-                for (size_t j = 0; j < prim_group.pointsGroup[i].vertex_indices.size();
-                    j++) {
-                    const vertex_index_t& vi = prim_group.pointsGroup[i].vertex_indices[j];
+                const __points_t& pts = prim_group.pointsGroup[i];
+                for (size_t j = 0; j < pts.num_vertices; j++) {
+                    const vertex_index_t& vi =
+                        prim_group.pointsVertices[pts.vertex_offset + j];
 
                     index_t idx;
                     idx.vertex_index = vi.v_idx;
@@ -2122,8 +2509,8 @@ namespace tinyobj {
         }
     }
 
-    void LoadMtl(std::map<std::string, int>* material_map,
-        std::vector<material_t>* materials, std::istream* inStream,
+    static void LoadMtlInternal(std::map<std::string, int>* material_map,
+        std::vector<material_t>* materials, line_reader_t& lines,
         std::string* warning, std::string* err) {
         (void)err;
 
@@ -2143,13 +2530,17 @@ namespace tinyobj {
 
         size_t line_no = 0;
         std::string linebuf;
-        while (inStream->peek() != -1) {
-            safeGetline(*inStream, linebuf);
+        const char* line_begin;
+        const char* line_end;
+        while (lines.next(&line_begin, &line_end)) {
+            // .mtl parsing reads texture names up to '\0', so copy the line.
+            // `linebuf` keeps its capacity, so this does not allocate per line.
+            linebuf.assign(line_begin, line_end);
             line_no++;
 
             // Trim trailing whitespace.
             if (linebuf.size() > 0) {
-                linebuf = linebuf.substr(0, linebuf.find_last_not_of(" \t") + 1);
+                linebuf.erase(linebuf.find_last_not_of(" \t") + 1);
             }
 
             // Trim newline '\r\n' or '\n'
@@ -2527,6 +2918,26 @@ namespace tinyobj {
         }
     }
 
+    void LoadMtl(std::map<std::string, int>* material_map,
+        std::vector<material_t>* materials, std::istream* inStream,
+        std::string* warning, std::string* err) {
+        stream_line_reader_t lines(*inStream);
+        LoadMtlInternal(material_map, materials, lines, warning, err);
+    }
+
+    static bool LoadMtlFromFile(const std::string& filepath,
+        std::map<std::string, int>* material_map,
+        std::vector<material_t>* materials,
+        std::string* warning, std::string* err) {
+        mapped_file_t file;
+        if (!file.open(filepath.c_str())) {
+            return false;
+        }
+        memory_line_reader_t lines(file.data(), file.size());
+        LoadMtlInternal(material_map, materials, lines, warning, err);
+        return true;
+    }
+
     bool MaterialFileReader::operator()(const std::string& matId,
         std::vector<material_t>* materials,
         std::map<std::string, int>* matMap,
@@ -2550,10 +2961,7 @@ namespace tinyobj {
             for (size_t i = 0; i < paths.size(); i++) {
                 std::string filepath = JoinPath(paths[i], matId);
 
-                std::ifstream matIStream(filepath.c_str());
-                if (matIStream) {
-                    LoadMtl(matMap, materials, &matIStream, warn, err);
-
+                if (LoadMtlFromFile(filepath, matMap, materials, warn, err)) {
                     return true;
                 }
             }
@@ -2569,10 +2977,7 @@ namespace tinyobj {
         }
         else {
             std::string filepath = matId;
-            std::ifstream matIStream(filepath.c_str());
-            if (matIStream) {
-                LoadMtl(matMap, materials, &matIStream, warn, err);
-
+            if (LoadMtlFromFile(filepath, matMap, materials, warn, err)) {
                 return true;
             }
 
@@ -2607,6 +3012,12 @@ namespace tinyobj {
         return true;
     }
 
+    static bool LoadObjInternal(attrib_t* attrib, std::vector<shape_t>* shapes,
+        std::vector<material_t>* materials, std::string* warn,
+        std::string* err, line_reader_t& lines,
+        MaterialReader* readMatFn, bool triangulate,
+        bool default_vcols_fallback);
+
     bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes,
         std::vector<material_t>* materials, std::string* warn,
         std::string* err, const char* filename, const char* mtl_basedir,
@@ -2619,8 +3030,8 @@ namespace tinyobj {
 
         std::stringstream errss;
 
-        std::ifstream ifs(filename);
-        if (!ifs) {
+        mapped_file_t file;
+        if (!file.open(filename)) {
             errss << "Cannot open file [" << filename << "]\n";
             if (err) {
                 (*err) = errss.str();
@@ -2639,8 +3050,9 @@ namespace tinyobj {
         }
         MaterialFileReader matFileReader(baseDir);
 
-        return LoadObj(attrib, shapes, materials, warn, err, &ifs, &matFileReader,
-            triangulate, default_vcols_fallback);
+        memory_line_reader_t lines(file.data(), file.size());
+        return LoadObjInternal(attrib, shapes, materials, warn, err, lines,
+            &matFileReader, triangulate, default_vcols_fallback);
     }
 
     bool LoadObj(attrib_t* attrib, std::vector<shape_t>* shapes,
@@ -2648,6 +3060,16 @@ namespace tinyobj {
         std::string* err, std::istream* inStream,
         MaterialReader* readMatFn /*= NULL*/, bool triangulate,
         bool default_vcols_fallback) {
+        stream_line_reader_t lines(*inStream);
+        return LoadObjInternal(attrib, shapes, materials, warn, err, lines,
+            readMatFn, triangulate, default_vcols_fallback);
+    }
+
+    static bool LoadObjInternal(attrib_t* attrib, std::vector<shape_t>* shapes,
+        std::vector<material_t>* materials, std::string* warn,
+        std::string* err, line_reader_t& lines,
+        MaterialReader* readMatFn, bool triangulate,
+        bool default_vcols_fallback) {
         std::stringstream errss;
 
         std::vector<real_t> v;
@@ -2657,7 +3079,8 @@ namespace tinyobj {
         std::vector<real_t> vc;
         std::vector<skin_weight_t> vw;  // tinyobj extension: vertex skin weights
         std::vector<tag_t> tags;
-        PrimGroup prim_group;
+        arena_t arena;  // Released when this function returns.
+        PrimGroup prim_group(&arena);
         std::string name;
 
         // material
@@ -2678,36 +3101,24 @@ namespace tinyobj {
         bool found_all_colors = true;  // check if all 'v' line has color info
 
         size_t line_num = 0;
-        std::string linebuf;
-        while (inStream->peek() != -1) {
-            safeGetline(*inStream, linebuf);
-
+        const char* token;
+        const char* line_end;
+        while (lines.next(&token, &line_end)) {
             line_num++;
 
-            // Trim newline '\r\n' or '\n'
-            if (linebuf.size() > 0) {
-                if (linebuf[linebuf.size() - 1] == '\n')
-                    linebuf.erase(linebuf.size() - 1);
-            }
-            if (linebuf.size() > 0) {
-                if (linebuf[linebuf.size() - 1] == '\r')
-                    linebuf.erase(linebuf.size() - 1);
-            }
-
             // Skip if empty line.
-            if (linebuf.empty()) {
+            if (token == line_end) {
                 continue;
             }
             if (line_num == 1) {
-                linebuf = removeUtf8Bom(linebuf);
+                skipUtf8Bom(&token, line_end);
             }
 
             // Skip leading space.
-            const char* token = linebuf.c_str();
             token += strspn(token, " \t");
 
             assert(token);
-            if (token[0] == '\0') continue;  // empty line
+            if (token >= line_end) continue;  // empty line
 
             if (token[0] == '#') continue;  // comment line
 
@@ -2773,7 +3184,7 @@ namespace tinyobj {
 
                 sw.vertex_id = vid;
 
-                while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+                while (token < line_end && !IS_NEW_LINE(token[0]) && token[0] != '#') {
                     real_t j, w;
                     // joint_id should not be negative, weight may be negative
                     // TODO(syoyo): # of elements check
@@ -2813,8 +3224,9 @@ namespace tinyobj {
                 token += 2;
 
                 __line_t line;
+                line.vertex_offset = prim_group.lineVertices.size();
 
-                while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+                while (token < line_end && !IS_NEW_LINE(token[0]) && token[0] != '#') {
                     vertex_index_t vi;
                     if (!parseTriple(&token, static_cast<int>(v.size() / 3),
                         static_cast<int>(vn.size() / 3),
@@ -2828,12 +3240,13 @@ namespace tinyobj {
                         return false;
                     }
 
-                    line.vertex_indices.push_back(vi);
+                    prim_group.lineVertices.push_back(vi);
 
                     size_t n = strspn(token, " \t\r");
                     token += n;
                 }
 
+                line.num_vertices = prim_group.lineVertices.size() - line.vertex_offset;
                 prim_group.lineGroup.push_back(line);
 
                 continue;
@@ -2844,8 +3257,9 @@ namespace tinyobj {
                 token += 2;
 
                 __points_t pts;
+                pts.vertex_offset = prim_group.pointsVertices.size();
 
-                while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+                while (token < line_end && !IS_NEW_LINE(token[0]) && token[0] != '#') {
                     vertex_index_t vi;
                     if (!parseTriple(&token, static_cast<int>(v.size() / 3),
                         static_cast<int>(vn.size() / 3),
@@ -2859,12 +3273,13 @@ namespace tinyobj {
                         return false;
                     }
 
-                    pts.vertex_indices.push_back(vi);
+                    prim_group.pointsVertices.push_back(vi);
 
                     size_t n = strspn(token, " \t\r");
                     token += n;
                 }
 
+                pts.num_vertices = prim_group.pointsVertices.size() - pts.vertex_offset;
                 prim_group.pointsGroup.push_back(pts);
 
                 continue;
@@ -2878,9 +3293,9 @@ namespace tinyobj {
                 face_t face;
 
                 face.smoothing_group_id = current_smoothing_id;
-                face.vertex_indices.reserve(3);
+                face.vertex_offset = prim_group.faceVertices.size();
 
-                while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+                while (token < line_end && !IS_NEW_LINE(token[0]) && token[0] != '#') {
                     vertex_index_t vi;
                     if (!parseTriple(&token, static_cast<int>(v.size() / 3),
                         static_cast<int>(vn.size() / 3),
@@ -2900,12 +3315,13 @@ namespace tinyobj {
                     greatest_vt_idx =
                         greatest_vt_idx > vi.vt_idx ? greatest_vt_idx : vi.vt_idx;
 
-                    face.vertex_indices.push_back(vi);
+                    prim_group.faceVertices.push_back(vi);
                     size_t n = strspn(token, " \t\r");
                     token += n;
                 }
 
-                // replace with emplace_back + std::move on C++11
+                face.num_vertices = static_cast<unsigned int>(
+                    prim_group.faceVertices.size() - face.vertex_offset);
                 prim_group.faceGroup.push_back(face);
 
                 continue;
@@ -2935,7 +3351,7 @@ namespace tinyobj {
                     // just clear `faceGroup` after `exportGroupsToShape()` call.
                     exportGroupsToShape(&shape, prim_group, tags, material, name,
                         triangulate, v, warn);
-                    prim_group.faceGroup.clear();
+                    prim_group.clearFaces();
                     material = newMaterialId;
                 }
 
@@ -2948,7 +3364,7 @@ namespace tinyobj {
                     token += 7;
 
                     std::vector<std::string> filenames;
-                    SplitString(std::string(token), ' ', '\\', filenames);
+                    SplitString(std::string(token, line_end), ' ', '\\', filenames);
 
                     if (filenames.empty()) {
                         if (warn) {
@@ -3018,7 +3434,7 @@ namespace tinyobj {
 
                 std::vector<std::string> names;
 
-                while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+                while (token < line_end && !IS_NEW_LINE(token[0]) && token[0] != '#') {
                     std::string str = parseString(&token);
                     names.push_back(str);
                     token += strspn(token, " \t\r");  // skip tag
@@ -3071,9 +3487,7 @@ namespace tinyobj {
 
                 // @todo { multiple object name? }
                 token += 2;
-                std::stringstream ss;
-                ss << token;
-                name = ss.str();
+                name = std::string(token, line_end);
 
                 continue;
             }
@@ -3137,7 +3551,7 @@ namespace tinyobj {
                 // skip space.
                 token += strspn(token, " \t");  // skip space
 
-                if (token[0] == '\0') {
+                if (token >= line_end) {
                     continue;
                 }
 
@@ -3145,7 +3559,7 @@ namespace tinyobj {
                     continue;
                 }
 
-                if (strlen(token) >= 3 && token[0] == 'o' && token[1] == 'f' &&
+                if ((line_end - token) >= 3 && token[0] == 'o' && token[1] == 'f' &&
                     token[2] == 'f') {
                     current_smoothing_id = 0;
                 }
@@ -3224,11 +3638,10 @@ namespace tinyobj {
         return true;
     }
 
-    bool LoadObjWithCallback(std::istream& inStream, const callback_t& callback,
-        void* user_data /*= NULL*/,
-        MaterialReader* readMatFn /*= NULL*/,
-        std::string* warn, /* = NULL*/
-        std::string* err /*= NULL*/) {
+    static bool LoadObjWithCallbackInternal(line_reader_t& lines,
+        const callback_t& callback, void* user_data,
+        MaterialReader* readMatFn, std::string* warn,
+        std::string* err) {
         std::stringstream errss;
 
         // material
@@ -3242,31 +3655,19 @@ namespace tinyobj {
         names.reserve(2);
         std::vector<const char*> names_out;
 
-        std::string linebuf;
-        while (inStream.peek() != -1) {
-            safeGetline(inStream, linebuf);
-
-            // Trim newline '\r\n' or '\n'
-            if (linebuf.size() > 0) {
-                if (linebuf[linebuf.size() - 1] == '\n')
-                    linebuf.erase(linebuf.size() - 1);
-            }
-            if (linebuf.size() > 0) {
-                if (linebuf[linebuf.size() - 1] == '\r')
-                    linebuf.erase(linebuf.size() - 1);
-            }
-
+        const char* token;
+        const char* line_end;
+        while (lines.next(&token, &line_end)) {
             // Skip if empty line.
-            if (linebuf.empty()) {
+            if (token == line_end) {
                 continue;
             }
 
             // Skip leading space.
-            const char* token = linebuf.c_str();
             token += strspn(token, " \t");
 
             assert(token);
-            if (token[0] == '\0') continue;  // empty line
+            if (token >= line_end) continue;  // empty line
 
             if (token[0] == '#') continue;  // comment line
 
@@ -3315,7 +3716,7 @@ namespace tinyobj {
                 token += strspn(token, " \t");
 
                 indices.clear();
-                while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+                while (token < line_end && !IS_NEW_LINE(token[0]) && token[0] != '#') {
                     vertex_index_t vi = parseRawTriple(&token);
 
                     index_t idx;
@@ -3339,9 +3740,7 @@ namespace tinyobj {
             // use mtl
             if ((0 == strncmp(token, "usemtl", 6)) && IS_SPACE((token[6]))) {
                 token += 7;
-                std::stringstream ss;
-                ss << token;
-                std::string namebuf = ss.str();
+                std::string namebuf(token, line_end);
 
                 int newMaterialId = -1;
                 std::map<std::string, int>::const_iterator it =
@@ -3373,7 +3772,7 @@ namespace tinyobj {
                     token += 7;
 
                     std::vector<std::string> filenames;
-                    SplitString(std::string(token), ' ', '\\', filenames);
+                    SplitString(std::string(token, line_end), ' ', '\\', filenames);
 
                     if (filenames.empty()) {
                         if (warn) {
@@ -3433,7 +3832,7 @@ namespace tinyobj {
             if (token[0] == 'g' && IS_SPACE((token[1]))) {
                 names.clear();
 
-                while (!IS_NEW_LINE(token[0]) && token[0] != '#') {
+                while (token < line_end && !IS_NEW_LINE(token[0]) && token[0] != '#') {
                     std::string str = parseString(&token);
                     names.push_back(str);
                     token += strspn(token, " \t\r");  // skip tag
@@ -3465,9 +3864,7 @@ namespace tinyobj {
                 // @todo { multiple object name? }
                 token += 2;
 
-                std::stringstream ss;
-                ss << token;
-                std::string object_name = ss.str();
+                std::string object_name(token, line_end);
 
                 if (callback.object_cb) {
                     callback.object_cb(user_data, object_name.c_str());
@@ -3524,6 +3921,43 @@ namespace tinyobj {
         return true;
     }
 
+    bool LoadObjWithCallback(std::istream& inStream, const callback_t& callback,
+        void* user_data /*= NULL*/,
+        MaterialReader* readMatFn /*= NULL*/,
+        std::string* warn, /* = NULL*/
+        std::string* err /*= NULL*/) {
+        stream_line_reader_t lines(inStream);
+        return LoadObjWithCallbackInternal(lines, callback, user_data, readMatFn,
+            warn, err);
+    }
+
+    bool LoadObjWithCallback(const char* filename, const callback_t& callback,
+        void* user_data /*= NULL*/,
+        MaterialReader* readMatFn /*= NULL*/,
+        std::string* warn, /* = NULL*/
+        std::string* err /*= NULL*/) {
+        mapped_file_t file;
+        if (!file.open(filename)) {
+            if (err) {
+                (*err) += "Cannot open file [" + std::string(filename) + "]\n";
+            }
+            return false;
+        }
+        memory_line_reader_t lines(file.data(), file.size());
+        return LoadObjWithCallbackInternal(lines, callback, user_data, readMatFn,
+            warn, err);
+    }
+
+    bool LoadObjWithCallback(const char* data, size_t size,
+        const callback_t& callback, void* user_data /*= NULL*/,
+        MaterialReader* readMatFn /*= NULL*/,
+        std::string* warn, /* = NULL*/
+        std::string* err /*= NULL*/) {
+        memory_line_reader_t lines(data, size);
+        return LoadObjWithCallbackInternal(lines, callback, user_data, readMatFn,
+            warn, err);
+    }
+
     bool ObjReader::ParseFromFile(const std::string& filename,
         const ObjReaderConfig& config) {
         std::string mtl_search_path;